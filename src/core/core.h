@@ -86,6 +86,16 @@ typedef enum
     CORE_RESUME             /*!< Core will resume from pause mode after this event. */
 } CoreEvent;
 
+/*! \brief Private structure for a CoreSnapshot. */
+typedef struct pv_CoreSnapshot pv_CoreSnapshot;
+
+/*!
+ * \brief Immutable version of a resource value.
+ *
+ * A snapshot stays valid until it is released, even if the resource is changed meanwhile.
+ */
+typedef pv_CoreSnapshot* CoreSnapshot;
+
 /*!
  * \brief Callback for core events.
  *
@@ -126,7 +136,10 @@ typedef void (*CorePrefsCallback) (Var prefs);
  * \brief Callback for a shared resource modification.
  * 
  * This function will be called when a resource is watched and has been changed.
- * This can be called by any thread; never use \ref temp_corevar in a callback.
+ * It is called by the thread of the watcher module (the first thread it owns or has a slot in,
+ * the main thread otherwise): immediately if the resource was changed in this thread, or at the
+ * beginning of its next step. Only the last version is sent if several changes were queued.
+ * Never use \ref temp_corevar in a callback.
  * \param id - Resource id.
  * \param value - Resource value, will not be valid anymore after the callback returned. \readonly
  */
@@ -292,7 +305,8 @@ CoreID coreGetResourceID(const char* name);
 /*!
  * \brief Set a resource value.
  *
- * This will call the callbacks of all watchers.
+ * A new version of the resource is published, readers holding a snapshot keep the previous one.
+ * This will queue the callbacks of all watchers.
  * \param module - Module that wants to set the resource, can be CORE_INVALID_ID if the resource is world writable.
  * \param resource - The resource to set.
  * \param value - New value (will be copied).
@@ -307,6 +321,39 @@ void coreSetResourceValue(CoreID module, CoreID resource, Var value);
  */
 void coreAskResourceSending(CoreID module, CoreID resource);
 
+/*!
+ * \brief Get the current version of a resource.
+ *
+ * This can be called from any thread. The snapshot must be released with coreReleaseSnapshot.
+ * \param resource - The resource to read.
+ * \return The current resource version, NULL if the resource doesn't exist.
+ */
+CoreSnapshot coreAcquireResource(CoreID resource);
+
+/*!
+ * \brief Get the value of a resource snapshot.
+ *
+ * \param snapshot - The snapshot.
+ * \return The value, valid until the snapshot is released. \readonly
+ */
+Var coreGetSnapshotValue(CoreSnapshot snapshot);
+
+/*!
+ * \brief Get the version number of a resource snapshot.
+ *
+ * The version is increased each time the resource is set.
+ * \param snapshot - The snapshot.
+ * \return The version number.
+ */
+Uint32 coreGetSnapshotVersion(CoreSnapshot snapshot);
+
+/*!
+ * \brief Release a resource snapshot.
+ *
+ * \param snapshot - The snapshot, can be NULL.
+ */
+void coreReleaseSnapshot(CoreSnapshot snapshot);
+
 /******************************************************************************
  *                              Completion list                               *
  ******************************************************************************/
@@ -388,13 +435,26 @@ void coreSetThreadTimer(CoreID module, CoreID thread, CoreTime time);
  *
  * The slot allows the module's thread callback to be called periodically (at the timer of the thread).
  * An owner already have a slot allocated at thread creation if the thread_cb was not NULL.
- * This can only be done for public threads.
+ * This can only be done for public threads. The slot is added by the thread itself, at its next step.
  * \param module - The module that requires the slot.
  * \param thread - A public thread.
  * \return The thread id (the one passed in parameter) or CORE_INVALID_ID if there was an error.
  */
 CoreID coreRequireThreadSlot(CoreID module, CoreID thread);
 
+/*!
+ * \brief Require a thread slot that can run concurrently with other independent slots.
+ *
+ * Same as coreRequireThreadSlot, but the callback may be called by a worker thread, at the same
+ * time as the other independent slots of the thread. It is never called at the same time as
+ * the dependent slots of the thread, so it must only share data with these ones.
+ * Resource callbacks raised by its changes are called after all the independent slots returned.
+ * \param module - The module that requires the slot.
+ * \param thread - A public thread.
+ * \return The thread id (the one passed in parameter) or CORE_INVALID_ID if there was an error.
+ */
+CoreID coreRequireIndependentThreadSlot(CoreID module, CoreID thread);
+
 /*!
  * \brief Retrieve a thread ID by its name.
  *
@@ -30,6 +30,9 @@
 #include "core/core.h"
 
 #include <SDL_thread.h>
+#ifdef HAVE_UNISTD_H
+    #include <unistd.h>
+#endif
 
 #include "tools/fonct.h"
 
@@ -56,11 +59,30 @@ typedef struct
     CorePrefsCallback prefs_cb;
     CoreResourceCallback res_cb;
     CoreThreadCallback thread_cb;
+    CoreID home;                        /* Thread where the resource callbacks are called. */
+    SDL_mutex* notify_lock;             /* To protect the notifications queue. */
+    Uint16 notify_nb;
+    struct CoreNotification* notify;    /* Resource changes waiting for the callback. */
 } CoreModule;
 
+struct pv_CoreSnapshot
+{
+    CoreID resource;
+    Uint32 version;
+    Uint32 refs;            /* Protected by _snapshots_lock. */
+    Var value;              /* Never modified once published. */
+};
+
+typedef struct CoreNotification
+{
+    CoreID resource;
+    CoreSnapshot snapshot;
+} CoreNotification;
+
 typedef struct
 {
-    Var resource;
+    Var resource;           /* Only holds the name and the type, the value is in current. */
+    CoreSnapshot current;
     CoreID id;
     CoreID owner;
     Uint16 watchers_nb;
@@ -90,6 +112,34 @@ typedef enum
 #define THREAD_MAIN 0
 #define THREAD_MAXNB 10
 
+#define WORKERS_MAXNB 8
+
+typedef struct
+{
+    CoreID module;
+    Bool independent;       /* Can be run concurrently with other independent slots. */
+    CoreTime lastcall;      /* Last time the callback was called. */
+} CoreThreadSlot;
+
+/* A slot callback waiting for a worker. */
+typedef struct
+{
+    CoreID module;
+    CoreID thread;
+    CoreTime duration;
+} CoreJob;
+
+typedef struct
+{
+    SDL_Thread* sdlthread;  /* NULL for the dispatching thread's queue. */
+    Uint32 sdlid;           /* SDL identifier of the running thread. */
+    CoreID thread;          /* Core thread whose jobs are run, CORE_INVALID_ID when idle. */
+    SDL_mutex* lock;        /* To protect first and last. */
+    Uint16 first;           /* Next job to be run by the worker itself. */
+    Uint16 last;            /* End of the queue, where other workers steal jobs. */
+    CoreJob** queue;
+} CoreWorker;
+
 typedef struct
 {
     CoreID id;
@@ -97,12 +147,17 @@ typedef struct
     String name;
     Bool public;
     SDL_Thread* sdlthread;
+    Uint32 sdlid;           /* SDL identifier of the running thread. */
     CoreTime lasthere;      /* Last time the thread was here. */
     CoreTime timer;         /* Minimum time between two 'frames'. */
     Uint16 slots_nb;
-    CoreID* slots;
+    CoreThreadSlot* slots;  /* Only changed by the thread itself, walked without locking. */
+    CoreJob* jobs;          /* Jobs of the independent slots, one per slot. */
+    Uint16 pending_nb;
+    CoreThreadSlot* pending;    /* Slots required since the last step, added by the thread itself. */
+    Bool dispatching;       /* Independent slots are running on the workers. */
     ThreadState state;
-    SDL_mutex* lock;        /* To protect state, times, and the slots. */
+    SDL_mutex* lock;        /* To protect state, times, and the pending slots. */
 } CoreThread;
 
 /******************************************************************************
@@ -134,6 +189,7 @@ static Var _modlist;
 static CoreID _resources_nb;
 static CoreResource* _resources;
 static PtrArray _resources_sorted;
+static SDL_mutex* _snapshots_lock;      /* To protect the snapshots references and the current versions. */
 
 /*completion list*/
 static CompletionList _complist;
@@ -142,6 +198,15 @@ static CompletionList _complist;
 static volatile CoreID _threads_nb;
 static volatile CoreThread* _threads;
 
+/*workers pool, the queue 0 is for the dispatching thread*/
+static Uint16 _workers_nb;
+static CoreWorker* _workers;
+static Uint16 _workers_queuesize;
+static SDL_mutex* _workers_lock;    /* Only one thread dispatches jobs at a time. */
+static SDL_sem* _workers_start;
+static SDL_sem* _workers_done;
+static volatile Bool _workers_quit;
+
 /*internal core things*/
 static CoreID MOD_ID = CORE_INVALID_ID;
 static CoreID FUNC_LSMOD = CORE_INVALID_ID;
@@ -163,6 +228,15 @@ CoreModule_free(CoreModule* module)
     
     String_del(module->name);
     PtrArray_del(module->shellfuncts_sorted);
+    for (i = 0; i < module->notify_nb; i++)
+    {
+        coreReleaseSnapshot(module->notify[i].snapshot);
+    }
+    if (module->notify_nb != 0)
+    {
+        FREE(module->notify);
+    }
+    SDL_DestroyMutex(module->notify_lock);
     if (module->shellfuncts_nb != 0)
     {
         for (i = 0; i < module->shellfuncts_nb; i++)
@@ -185,6 +259,7 @@ static void
 CoreResource_free(CoreResource* resource)
 {
     Var_del(resource->resource);
+    coreReleaseSnapshot(resource->current);
     if (resource->watchers_nb != 0)
     {
         FREE(resource->watchers);
@@ -368,6 +443,367 @@ bindPreferences(String prefsfile)
     }
 }
 
+/*----------------------------------------------------------------------------*/
+static CoreSnapshot
+CoreSnapshot_new(CoreID resource, Uint32 version)
+{
+    CoreSnapshot ret;
+    
+    ret = MALLOC(sizeof(pv_CoreSnapshot));
+    ret->resource = resource;
+    ret->version = version;
+    ret->refs = 1;
+    ret->value = Var_new();
+    
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Find the core thread running the caller, workers run on behalf of the thread that dispatched them.
+  CORE_INVALID_ID for other threads*/
+static CoreID
+currentThread(void)
+{
+    Uint32 sdlid;
+    CoreID i;
+    Uint16 w;
+    
+    sdlid = SDL_ThreadID();
+    for (i = 0; i < _threads_nb; i++)
+    {
+        if (_threads[i].sdlid == sdlid)
+        {
+            return i;
+        }
+    }
+    for (w = 0; w < _workers_nb; w++)
+    {
+        if ((_workers[w].thread != CORE_INVALID_ID) && (_workers[w].sdlid == sdlid))
+        {
+            return _workers[w].thread;
+        }
+    }
+    return CORE_INVALID_ID;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Give the thread whose notifications may be delivered right now to the caller.
+  Not while independent slots run: the dependent modules' callbacks would run concurrently with them.*/
+static CoreID
+deliveringThread(void)
+{
+    CoreID thread;
+    
+    thread = currentThread();
+    if ((thread != CORE_INVALID_ID) && _threads[thread].dispatching)
+    {
+        return CORE_INVALID_ID;
+    }
+    return thread;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Queue a resource version for a module callback, the reference is given to the queue*/
+static void
+notifyModule(CoreID module, CoreSnapshot snapshot)
+{
+    CoreModule* mod;
+    Uint16 i;
+    
+    mod = _modules + module;
+    SDL_mutexP(mod->notify_lock);
+    
+    /*only the last version of a resource is useful*/
+    for (i = 0; i < mod->notify_nb; i++)
+    {
+        if (mod->notify[i].resource == snapshot->resource)
+        {
+            break;
+        }
+    }
+    if (i < mod->notify_nb)
+    {
+        coreReleaseSnapshot(mod->notify[i].snapshot);
+    }
+    else
+    {
+        if (mod->notify_nb++ == 0)
+        {
+            mod->notify = MALLOC(sizeof(CoreNotification));
+        }
+        else
+        {
+            mod->notify = REALLOC(mod->notify, sizeof(CoreNotification) * mod->notify_nb);
+        }
+        mod->notify[i].resource = snapshot->resource;
+    }
+    mod->notify[i].snapshot = snapshot;
+    
+    SDL_mutexV(mod->notify_lock);
+}
+
+/*----------------------------------------------------------------------------*/
+/*Call the resource callbacks of modules living in a thread*/
+static void
+deliverNotifications(CoreID thread)
+{
+    CoreModule* mod;
+    CoreNotification* notify;
+    Uint16 nb, j;
+    CoreID i;
+    
+    for (i = 0; i < _modules_nb; i++)
+    {
+        mod = _modules + i;
+        if ((mod->home != thread) && ((mod->home != CORE_INVALID_ID) || (thread != THREAD_MAIN)))
+        {
+            continue;
+        }
+        
+        /*take the whole queue, callbacks may queue new changes*/
+        SDL_mutexP(mod->notify_lock);
+        nb = mod->notify_nb;
+        notify = mod->notify;
+        mod->notify_nb = 0;
+        mod->notify = NULL;
+        SDL_mutexV(mod->notify_lock);
+        
+        if (nb != 0)
+        {
+            for (j = 0; j < nb; j++)
+            {
+                mod->res_cb(notify[j].resource, notify[j].snapshot->value);
+                coreReleaseSnapshot(notify[j].snapshot);
+            }
+            FREE(notify);
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*Take a job in a worker queue, or steal one in another queue*/
+static CoreJob*
+workerNextJob(Uint16 worker)
+{
+    CoreJob* job;
+    Uint16 i, w;
+    
+    job = NULL;
+    for (i = 0; (i < _workers_nb) && (job == NULL); i++)
+    {
+        w = (worker + i) % _workers_nb;
+        SDL_mutexP(_workers[w].lock);
+        if (_workers[w].first != _workers[w].last)
+        {
+            if (w == worker)
+            {
+                job = _workers[w].queue[_workers[w].first++];
+            }
+            else
+            {
+                job = _workers[w].queue[--_workers[w].last];
+            }
+        }
+        SDL_mutexV(_workers[w].lock);
+    }
+    return job;
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+workerRun(Uint16 worker)
+{
+    CoreJob* job;
+    
+    while ((job = workerNextJob(worker)) != NULL)
+    {
+        _modules[job->module].thread_cb(job->thread, job->duration);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+static int
+workerProcessor(void* data)
+{
+    Uint16 worker;
+    
+    worker = (Uint16)((CoreWorker*)data - _workers);
+    _workers[worker].sdlid = SDL_ThreadID();
+    memRegisterThread();
+    
+    SDL_SemWait(_workers_start);
+    while (!_workers_quit)
+    {
+        workerRun(worker);
+        SDL_SemPost(_workers_done);
+        SDL_SemWait(_workers_start);
+    }
+    
+    memUnregisterThread();
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Run jobs of a core thread on the workers pool, return when all of them are done*/
+static void
+workersDispatch(CoreJob* jobs, Uint16 nb)
+{
+    Uint16 i, woken;
+    
+    if (nb == 0)
+    {
+        return;
+    }
+    
+    SDL_mutexP(_workers_lock);
+    
+    /*the first queue is run by the dispatching thread itself*/
+    _workers[0].sdlid = SDL_ThreadID();
+    
+    if (nb > _workers_queuesize)
+    {
+        for (i = 0; i < _workers_nb; i++)
+        {
+            _workers[i].queue = REALLOC(_workers[i].queue, sizeof(CoreJob*) * nb);
+        }
+        _workers_queuesize = nb;
+    }
+    
+    /*spread the jobs, idle workers will steal the remaining ones*/
+    woken = MIN(nb - 1, _workers_nb - 1);
+    for (i = 0; i <= woken; i++)
+    {
+        _workers[i].first = 0;
+        _workers[i].last = 0;
+    }
+    for (i = 0; i < nb; i++)
+    {
+        _workers[i % (woken + 1)].queue[_workers[i % (woken + 1)].last++] = jobs + i;
+    }
+    
+    /*idle workers may steal jobs too, all of them are on behalf of the dispatching thread*/
+    for (i = 0; i < _workers_nb; i++)
+    {
+        _workers[i].thread = jobs[0].thread;
+    }
+    for (i = 0; i < woken; i++)
+    {
+        SDL_SemPost(_workers_start);
+    }
+    workerRun(0);
+    
+    /*barrier*/
+    for (i = 0; i < woken; i++)
+    {
+        SDL_SemWait(_workers_done);
+    }
+    for (i = 0; i < _workers_nb; i++)
+    {
+        _workers[i].thread = CORE_INVALID_ID;
+    }
+    
+    SDL_mutexV(_workers_lock);
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+workersInit(void)
+{
+    long ncpu;
+    Uint16 i;
+    
+#ifdef _SC_NPROCESSORS_ONLN
+    ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+    ncpu = 2;
+#endif
+    ncpu = MAX(ncpu, 1);
+    ncpu = MIN(ncpu, WORKERS_MAXNB);
+    
+    _workers_nb = (Uint16)ncpu;
+    _workers = MALLOC(sizeof(CoreWorker) * _workers_nb);
+    _workers_queuesize = 1;
+    _workers_lock = SDL_CreateMutex();
+    _workers_start = SDL_CreateSemaphore(0);
+    _workers_done = SDL_CreateSemaphore(0);
+    _workers_quit = FALSE;
+    
+    for (i = 0; i < _workers_nb; i++)
+    {
+        _workers[i].lock = SDL_CreateMutex();
+        _workers[i].first = 0;
+        _workers[i].last = 0;
+        _workers[i].queue = MALLOC(sizeof(CoreJob*) * _workers_queuesize);
+        _workers[i].sdlid = 0;
+        _workers[i].thread = CORE_INVALID_ID;
+        if (i == 0)
+        {
+            _workers[i].sdlthread = NULL;
+        }
+        else
+        {
+            _workers[i].sdlthread = SDL_CreateThread(workerProcessor, (void*)(_workers + i));
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+workersUninit(void)
+{
+    Uint16 i;
+    
+    _workers_quit = TRUE;
+    for (i = 1; i < _workers_nb; i++)
+    {
+        SDL_SemPost(_workers_start);
+    }
+    for (i = 0; i < _workers_nb; i++)
+    {
+        if (_workers[i].sdlthread != NULL)
+        {
+            SDL_WaitThread(_workers[i].sdlthread, NULL);
+        }
+        SDL_DestroyMutex(_workers[i].lock);
+        FREE(_workers[i].queue);
+    }
+    FREE(_workers);
+    SDL_DestroySemaphore(_workers_start);
+    SDL_DestroySemaphore(_workers_done);
+    SDL_DestroyMutex(_workers_lock);
+}
+
+/*----------------------------------------------------------------------------*/
+/*Add the slots required since the last step, only done by the thread itself*/
+static void
+threadAddPendingSlots(CoreThread* thread)
+{
+    Uint16 i;
+    
+    SDL_mutexP(thread->lock);
+    if (thread->pending_nb != 0)
+    {
+        if (thread->slots_nb == 0)
+        {
+            thread->slots = MALLOC(sizeof(CoreThreadSlot) * thread->pending_nb);
+            thread->jobs = MALLOC(sizeof(CoreJob) * thread->pending_nb);
+        }
+        else
+        {
+            thread->slots = REALLOC(thread->slots, sizeof(CoreThreadSlot) * (thread->slots_nb + thread->pending_nb));
+            thread->jobs = REALLOC(thread->jobs, sizeof(CoreJob) * (thread->slots_nb + thread->pending_nb));
+        }
+        for (i = 0; i < thread->pending_nb; i++)
+        {
+            thread->slots[thread->slots_nb++] = thread->pending[i];
+        }
+        FREE(thread->pending);
+        thread->pending = NULL;
+        thread->pending_nb = 0;
+    }
+    SDL_mutexV(thread->lock);
+}
+
 /*----------------------------------------------------------------------------*/
 static int
 threadProcessor(void* data)
@@ -375,13 +811,18 @@ threadProcessor(void* data)
     CoreThread* thread;
     CoreTime curtime;
     CoreTime duration;
-    Uint16 i;
+    Uint16 i, nbjobs;
     
     thread = (CoreThread*)data;
+    thread->sdlid = SDL_ThreadID();
+    memRegisterThread();
     
-    /*TODO: thread-safe things*/
-    
+    threadAddPendingSlots(thread);
     curtime = getTicks();
+    for (i = 0; i < thread->slots_nb; i++)
+    {
+        thread->slots[i].lastcall = curtime;
+    }
     while (thread->state != THREAD_WILLTERM)
     {
         if (thread->state == THREAD_WILLPAUSE)
@@ -398,6 +839,12 @@ threadProcessor(void* data)
         }
         curtime = getTicks();
         
+        /*resources changed by other threads*/
+        deliverNotifications(thread->id);
+        
+        /*slots required by other threads*/
+        threadAddPendingSlots(thread);
+        
         /*call callbacks*/
         if (thread->id == THREAD_MAIN)
         {
@@ -434,13 +881,38 @@ threadProcessor(void* data)
         }
         if (thread->state != THREAD_PAUSED)
         {
+            /*dependent slots are called in order, independent ones are queued*/
+            nbjobs = 0;
             for (i = 0; i < thread->slots_nb; i++)
             {
-                /* FIXME: should compute the new duration for each slot */
-                _modules[thread->slots[i]].thread_cb(thread->id, duration);
+                duration = getTicks() - thread->slots[i].lastcall;
+                thread->slots[i].lastcall += duration;
+                if (thread->slots[i].independent)
+                {
+                    thread->jobs[nbjobs].module = thread->slots[i].module;
+                    thread->jobs[nbjobs].thread = thread->id;
+                    thread->jobs[nbjobs].duration = duration;
+                    nbjobs++;
+                }
+                else
+                {
+                    _modules[thread->slots[i].module].thread_cb(thread->id, duration);
+                }
+            }
+            
+            /*independent slots are all done before the next step of this thread*/
+            if (nbjobs != 0)
+            {
+                thread->dispatching = TRUE;
+                workersDispatch(thread->jobs, nbjobs);
+                thread->dispatching = FALSE;
+                
+                /*changes made by independent slots*/
+                deliverNotifications(thread->id);
             }
         }
     }
+    memUnregisterThread();
     thread->state = THREAD_DEAD;
     
     return 0;
@@ -551,7 +1023,11 @@ shellCallback(ShellFunction* func)
         }
         else
         {
-            shellPrintf(LEVEL_USER, "%s", Var_gets(_resources[i].resource));
+            CoreSnapshot snap;
+            
+            snap = coreAcquireResource(i);
+            shellPrintf(LEVEL_USER, "%s", Var_gets(snap->value));
+            coreReleaseSnapshot(snap);
         }
     }
     else if (func->id == FUNC_PAUSE)
@@ -642,6 +1118,7 @@ coreInit()
     _resources_nb = 0;
     _resources = NULL;
     _resources_sorted = PtrArray_newFull(20, 10, NULL, (PtrCmpFunc)CoreResource_cmp);
+    _snapshots_lock = SDL_CreateMutex();
     
     _complist = CompletionList_new();
     
@@ -673,14 +1150,21 @@ coreInit()
     _threads[THREAD_MAIN].name = String_new("main");
     _threads[THREAD_MAIN].public = TRUE;
     _threads[THREAD_MAIN].sdlthread = NULL;
+    _threads[THREAD_MAIN].sdlid = SDL_ThreadID();
     _threads[THREAD_MAIN].lasthere = getTicks();
     _threads[THREAD_MAIN].timer = 0;
     _threads[THREAD_MAIN].slots_nb = 0;
     _threads[THREAD_MAIN].slots = NULL;
+    _threads[THREAD_MAIN].jobs = NULL;
+    _threads[THREAD_MAIN].pending_nb = 0;
+    _threads[THREAD_MAIN].pending = NULL;
+    _threads[THREAD_MAIN].dispatching = FALSE;
     _threads[THREAD_MAIN].state = THREAD_HERE;
     _threads[THREAD_MAIN].lock = SDL_CreateMutex();
     _threads_nb = 1;
     
+    workersInit();
+    
     _state = STATE_RUNNING;
 }
 
@@ -691,6 +1175,7 @@ coreUninit()
     CoreID i;
     
     /*threads*/
+    workersUninit();
     for (i = 0; i < _threads_nb; i++)
     {
         /* threads should all be dead at this point */
@@ -698,6 +1183,11 @@ coreUninit()
         if (_threads[i].slots_nb != 0)
         {
             FREE(_threads[i].slots);
+            FREE(_threads[i].jobs);
+        }
+        if (_threads[i].pending_nb != 0)
+        {
+            FREE(_threads[i].pending);
         }
         SDL_DestroyMutex(_threads[i].lock);
         String_del(_threads[i].name);
@@ -743,6 +1233,7 @@ coreUninit()
         FREE(_resources);
     }
     PtrArray_del(_resources_sorted);
+    SDL_DestroyMutex(_snapshots_lock);
     
     /*datas*/
     Var_del(_modlist);
@@ -755,6 +1246,7 @@ coreUninit()
     
     /*internal modules*/
     i18nUninit();
+    Var_setCacheDirectory(NULL);
     shellUninit();
 }
 
@@ -766,6 +1258,7 @@ coreStart()
     Bool loop;
     char* prefpath;
     String prefpathstr;
+    String cachepathstr;
     
     ASSERT(_state == STATE_RUNNING, return);
     
@@ -797,6 +1290,12 @@ coreStart()
 #endif
     bindPreferences(prefpathstr);
     
+    /*compiled data files are cached next to the preferences*/
+    cachepathstr = String_newByCopy(prefpathstr);
+    String_append(cachepathstr, "_cache");
+    Var_setCacheDirectory(String_get(cachepathstr));
+    String_del(cachepathstr);
+    
     /*throw the CORE_READY event*/
     for (i = 0; i < _modules_nb; i++)
     {
@@ -962,6 +1461,9 @@ coreLoadData(String modname)
     Var_del(mod);
     String_del(_oldpath);
     shellPopErrorStack();
+    
+    /*the mod tree and replaced datas left a lot of free pooled objects*/
+    memTrim();
     return FALSE;
 }
 
@@ -1017,6 +1519,9 @@ coreDeclareModule(const char* name, CoreEventCallback event_cb, CoreDatasCallbac
     module->prefs_cb = prefs_cb;
     module->res_cb = res_cb;
     module->thread_cb = thread_cb;
+    module->home = CORE_INVALID_ID;
+    module->notify_lock = SDL_CreateMutex();
+    module->notify_nb = 0;
     
     /*build the sorted array again (we must rebuild it all because of the REALLOC)*/
     PtrArray_clear(_modules_sorted);
@@ -1116,6 +1621,7 @@ coreCreateResource(CoreID owner, const char* name, VarType type, Bool world_writ
         {
             res->owner = owner;
             Var_setType(res->resource, type);
+            Var_setType(res->current->value, type);
             res->world_writable = world_writable;
             return res->id;
         }
@@ -1145,6 +1651,9 @@ coreCreateResource(CoreID owner, const char* name, VarType type, Bool world_writ
     res->world_writable = world_writable;
     res->watchers_nb = 0;
     res->id = _resources_nb - 1;
+    res->current = CoreSnapshot_new(res->id, 0);
+    Var_setType(res->current->value, type);
+    Var_setName(res->current->value, name);
     
     /*build the sorted array again (we must rebuild it all because of the REALLOC)*/
     PtrArray_clear(_resources_sorted);
@@ -1204,6 +1713,8 @@ coreAddResourceWatcher(CoreID module, const char* name)
         res->watchers = MALLOC(sizeof(CoreID));
         res->watchers[0] = module;
         res->id = resid;
+        res->current = CoreSnapshot_new(resid, 0);
+        Var_setName(res->current->value, name);
         
         /*build the sorted array again (we must rebuild it all because of the REALLOC)*/
         PtrArray_clear(_resources_sorted);
@@ -1273,6 +1784,9 @@ void
 coreSetResourceValue(CoreID module, CoreID resource, Var value)
 {
     CoreResource* res;
+    CoreSnapshot snap;
+    CoreSnapshot old;
+    CoreID thread;
     int i;
     const char* modname;
     
@@ -1303,13 +1817,29 @@ coreSetResourceValue(CoreID module, CoreID resource, Var value)
         return;
     }
     
-    /*modifying*/
-    Var_setFromVar(res->resource, value);
+    /*the new version is built aside, readers keep the previous one*/
+    snap = CoreSnapshot_new(resource, 0);
+    Var_setName(snap->value, String_get(Var_getName(res->resource)));
+    Var_setFromVar(snap->value, value);
+    
+    /*publish it*/
+    SDL_mutexP(_snapshots_lock);
+    old = res->current;
+    snap->version = old->version + 1;
+    snap->refs += res->watchers_nb;
+    res->current = snap;
+    SDL_mutexV(_snapshots_lock);
+    coreReleaseSnapshot(old);
     
-    /*raising callbacks*/
+    /*queue callbacks, those of the current thread are raised now*/
     for (i = 0; i < res->watchers_nb; i++)
     {
-        _modules[res->watchers[i]].res_cb(resource, value);
+        notifyModule(res->watchers[i], snap);
+    }
+    thread = deliveringThread();
+    if (thread != CORE_INVALID_ID)
+    {
+        deliverNotifications(thread);
     }
 }
 
@@ -1318,7 +1848,7 @@ void
 coreAskResourceSending(CoreID module, CoreID resource)
 {
     CoreResource* res;
-    Var v;
+    CoreID thread;
     
     /*checks*/
     if ((resource < 0) || (resource >= _resources_nb))
@@ -1335,13 +1865,72 @@ coreAskResourceSending(CoreID module, CoreID resource)
     if (_modules[module].res_cb == NULL)
     {
         shellPrintf(LEVEL_ERROR, "Module '%s' tried to ask the resource '%s' without a callback set.", String_get(_modules[module].name), String_get(Var_getName(res->resource)));
+        return;
     }
     
     /*send the value through the callback*/
-    v = Var_new();
-    Var_setFromVar(v, res->resource);
-    _modules[module].res_cb(resource, v);
-    Var_del(v);
+    notifyModule(module, coreAcquireResource(resource));
+    thread = deliveringThread();
+    if (thread != CORE_INVALID_ID)
+    {
+        deliverNotifications(thread);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+CoreSnapshot
+coreAcquireResource(CoreID resource)
+{
+    CoreSnapshot ret;
+    
+    if ((resource < 0) || (resource >= _resources_nb))
+    {
+        shellPrintf(LEVEL_ERROR, "Trying to read the not declared resource %d.", resource);
+        return NULL;
+    }
+    
+    SDL_mutexP(_snapshots_lock);
+    ret = _resources[resource].current;
+    ret->refs++;
+    SDL_mutexV(_snapshots_lock);
+    
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+Var
+coreGetSnapshotValue(CoreSnapshot snapshot)
+{
+    return snapshot->value;
+}
+
+/*----------------------------------------------------------------------------*/
+Uint32
+coreGetSnapshotVersion(CoreSnapshot snapshot)
+{
+    return snapshot->version;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+coreReleaseSnapshot(CoreSnapshot snapshot)
+{
+    Uint32 refs;
+    
+    if (snapshot == NULL)
+    {
+        return;
+    }
+    
+    SDL_mutexP(_snapshots_lock);
+    refs = --snapshot->refs;
+    SDL_mutexV(_snapshots_lock);
+    
+    if (refs == 0)
+    {
+        Var_del(snapshot->value);
+        FREE(snapshot);
+    }
 }
 
 /*----------------------------------------------------------------------------*/
@@ -1398,9 +1987,20 @@ coreCreateThread(CoreID owner, const char* name, Bool public, volatile CoreID* i
     _threads[_threads_nb].lasthere = getTicks();
     _threads[_threads_nb].timer = 0;
     _threads[_threads_nb].slots_nb = 0;
+    _threads[_threads_nb].sdlid = 0;
+    _threads[_threads_nb].slots = NULL;
+    _threads[_threads_nb].jobs = NULL;
+    _threads[_threads_nb].pending_nb = 0;
+    _threads[_threads_nb].pending = NULL;
+    _threads[_threads_nb].dispatching = FALSE;
     _threads[_threads_nb].state = THREAD_HERE;
     _threads[_threads_nb].lock = SDL_CreateMutex();
     
+    if (_modules[owner].home == CORE_INVALID_ID)
+    {
+        _modules[owner].home = _threads_nb;
+    }
+    
     SDL_mutexP(_threads[_threads_nb].lock);
     *id = _threads_nb;
     _threads_nb++;
@@ -1535,9 +2135,11 @@ coreSetThreadTimer(CoreID module, CoreID thread, CoreTime time)
 }
 
 /*----------------------------------------------------------------------------*/
-CoreID
-coreRequireThreadSlot(CoreID module, CoreID thread)
+static CoreID
+requireSlot(CoreID module, CoreID thread, Bool independent)
 {
+    CoreThreadSlot* slot;
+    
     if ((module < 0) | (module > _modules_nb))
     {
         shellPrintf(LEVEL_ERROR, "The unknown module '%d' tried to require a slot in thread '%d'.", module, thread);
@@ -1562,22 +2164,45 @@ coreRequireThreadSlot(CoreID module, CoreID thread)
     {
         /*TODO: maybe check that this module doesn't already have a slot in this thread*/
         
+        /*the thread may be walking its slots, it will add this one at its next step*/
         SDL_mutexP(_threads[thread].lock);
-        if (_threads[thread].slots_nb == 0)
+        if (_threads[thread].pending_nb == 0)
         {
-            _threads[thread].slots = MALLOC(sizeof(CoreID));
+            _threads[thread].pending = MALLOC(sizeof(CoreThreadSlot));
         }
         else
         {
-            _threads[thread].slots = REALLOC(_threads[thread].slots, sizeof(CoreID) * (_threads[thread].slots_nb + 1));
+            _threads[thread].pending = REALLOC(_threads[thread].pending, sizeof(CoreThreadSlot) * (_threads[thread].pending_nb + 1));
         }
-        _threads[thread].slots[_threads[thread].slots_nb++] = module;
+        slot = _threads[thread].pending + _threads[thread].pending_nb++;
+        slot->module = module;
+        slot->independent = independent;
+        slot->lastcall = getTicks();
         SDL_mutexV(_threads[thread].lock);
         
+        if (_modules[module].home == CORE_INVALID_ID)
+        {
+            _modules[module].home = thread;
+        }
+        
         return thread;
     }
 }
 
+/*----------------------------------------------------------------------------*/
+CoreID
+coreRequireThreadSlot(CoreID module, CoreID thread)
+{
+    return requireSlot(module, thread, FALSE);
+}
+
+/*----------------------------------------------------------------------------*/
+CoreID
+coreRequireIndependentThreadSlot(CoreID module, CoreID thread)
+{
+    return requireSlot(module, thread, TRUE);
+}
+
 /*----------------------------------------------------------------------------*/
 CoreID
 coreGetThreadID(const char* name)
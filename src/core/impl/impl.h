@@ -72,6 +72,15 @@ Bool shellExecFromReader(Var ret, Reader reader);
  */
 void Var_setFromReader(Var var, Reader reader);
 
+/*!
+ * \brief Set the directory where parsed data files are cached in binary form.
+ *
+ * The directory is created if needed. Files read by Var_readFromFile will then
+ * be loaded from their cached version while their source is unchanged.
+ * \param path - The directory, NULL to disable the cache.
+ */
+void Var_setCacheDirectory(const char* path);
+
 void shellInit(void);
 void shellUninit(void);
 void i18nInit(void);
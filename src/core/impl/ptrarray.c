@@ -42,6 +42,46 @@ defaultCmp(Ptr* p1, Ptr* p2)
     return ((int)(*p1)) - ((int)(*p2));
 }
 
+/*----------------------------------------------------------------------------*/
+/*get the allocated size needed to hold more pointers, growing geometrically*/
+static PtrArrayPos
+grownSize(PtrArray array, PtrArrayPos needed)
+{
+    PtrArrayPos ret;
+    
+    ret = array->alloclen + MAX(array->allocrange, array->alloclen / 2);
+    return MAX(ret, needed);
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+grow(PtrArray array, PtrArrayPos needed)
+{
+    if (needed > array->alloclen)
+    {
+        array->alloclen = grownSize(array, needed);
+        array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*give back memory when the array is less than a quarter full*/
+static void
+shrink(PtrArray array)
+{
+    PtrArrayPos size;
+    
+    if ((array->len < array->alloclen / 4) && (array->alloclen > array->allocrange))
+    {
+        size = MAX(array->alloclen / 2, array->allocrange);
+        if (size != array->alloclen)
+        {
+            array->alloclen = size;
+            array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
+        }
+    }
+}
+
 /*----------------------------------------------------------------------------*/
 static void
 searchSorted(PtrArray array, Ptr ptr, Bool* found, PtrArrayPos* pos)
@@ -179,6 +219,28 @@ PtrArray_clear(PtrArray array)
     array->len = 0;
 }
 
+/*----------------------------------------------------------------------------*/
+void
+PtrArray_reserve(PtrArray array, PtrArrayPos size)
+{
+    if (size > array->alloclen)
+    {
+        array->alloclen = size;
+        array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void
+PtrArray_shrinkToFit(PtrArray array)
+{
+    if (array->alloclen != MAX(array->len, 1))
+    {
+        array->alloclen = MAX(array->len, 1);
+        array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
+    }
+}
+
 /*----------------------------------------------------------------------------*/
 void
 PtrArray_append(PtrArray array, Ptr ptr)
@@ -186,8 +248,7 @@ PtrArray_append(PtrArray array, Ptr ptr)
     if (array->len == array->alloclen)
     {
         /*need growing*/
-        array->alloclen += array->allocrange;
-        array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
+        grow(array, array->len + 1);
     }
     /*add the pointer*/
     array->array[array->len++] = ptr;
@@ -203,7 +264,7 @@ PtrArray_prepend(PtrArray array, Ptr ptr)
     if (array->len == array->alloclen)
     {
         /*need growing*/
-        array->alloclen += array->allocrange;
+        array->alloclen = grownSize(array, array->len + 1);
         newarray = MALLOC(array->alloclen * sizeof(Ptr));
         for (i = array->len; i > 0; i--)
         {
@@ -233,8 +294,7 @@ PtrArray_prependFast(PtrArray array, Ptr ptr)
     {
         /*need growing*/
         /*TODO: reallocation copies array->array[0] although it will be moved again later*/
-        array->alloclen += array->allocrange;
-        array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
+        grow(array, array->len + 1);
     }
     array->array[array->len++] = array->array[0];
     array->array[0] = ptr;
@@ -260,7 +320,7 @@ PtrArray_insert(PtrArray array, Ptr ptr, PtrArrayPos pos)
         if (array->len == array->alloclen)
         {
             /*need growing*/
-            array->alloclen += array->allocrange;
+            array->alloclen = grownSize(array, array->len + 1);
             newarray = MALLOC(array->alloclen * sizeof(Ptr));
             for (i = 0; i < pos; i++)
             {
@@ -305,8 +365,7 @@ PtrArray_insertFast(PtrArray array, Ptr ptr, PtrArrayPos pos)
         {
             /*need growing*/
             /*TODO: reallocation copies array->array[pos] although it will be moved again later*/
-            array->alloclen += array->allocrange;
-            array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
+            grow(array, array->len + 1);
         }
         array->array[array->len++] = array->array[pos];
         array->array[pos] = ptr;
@@ -361,12 +420,7 @@ PtrArray_remove(PtrArray array, Ptr ptr)
         array->array[i - 1] = array->array[i];
     }
     array->len--;
-    if ((array->alloclen - array->len == array->allocrange) && (array->len != 0))
-    {
-        /*need shrinking*/
-        array->alloclen -= array->allocrange;
-        array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
-    }
+    shrink(array);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -394,12 +448,7 @@ PtrArray_removeFast(PtrArray array, Ptr ptr)
     }
     p = array->array[pos];
     array->array[pos] = array->array[--array->len];
-    if ((array->alloclen - array->len == array->allocrange) && (array->len != 0))
-    {
-        /*need shrinking*/
-        array->alloclen -= array->allocrange;
-        array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
-    }
+    shrink(array);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -428,12 +477,7 @@ PtrArray_removeIt(PtrArray array, PtrArrayIterator it)
         array->array[i - 1] = array->array[i];
     }
     array->len--;
-    if ((array->alloclen - array->len == array->allocrange) && (array->len != 0))
-    {
-        /*need shrinking*/
-        array->alloclen -= array->allocrange;
-        array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
-    }
+    shrink(array);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -453,12 +497,7 @@ PtrArray_removeItFast(PtrArray array, PtrArrayIterator it)
     }
     p = array->array[pos];
     array->array[pos] = array->array[--array->len];
-    if ((array->alloclen - array->len == array->allocrange) && (array->len != 0))
-    {
-        /*need shrinking*/
-        array->alloclen -= array->allocrange;
-        array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
-    }
+    shrink(array);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -498,18 +537,7 @@ PtrArray_removeRange(PtrArray array, PtrArrayPos start, PtrArrayPos end)
     
     array->len -= (end - start + 1);
     
-    if (array->alloclen - array->len >= array->allocrange)
-    {
-        if (array->len < array->allocrange)
-        {
-            array->alloclen = array->allocrange;
-        }
-        else
-        {
-            array->alloclen = array->len;
-        }
-        array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
-    }
+    shrink(array);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -542,18 +570,7 @@ PtrArray_removeRangeFast(PtrArray array, PtrArrayPos start, PtrArrayPos end)
     }
     array->len -= (end - start + 1);
     
-    if (array->alloclen - array->len >= array->allocrange)
-    {
-        if (array->len < array->alloclen)
-        {
-            array->alloclen = array->allocrange;
-        }
-        else
-        {
-            array->alloclen = array->len;
-        }
-        array->array = REALLOC(array->array, array->alloclen * sizeof(Ptr));
-    }
+    shrink(array);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -577,6 +594,145 @@ PtrArray_sortRange(PtrArray array, PtrArrayPos start, PtrArrayPos end)
     qsort(array->array + start, end - start + 1, sizeof(Ptr), (int(*)(const void*,const void*))array->cmpfunc);
 }
 
+/*----------------------------------------------------------------------------*/
+void
+PtrArray_sortOne(PtrArray array, PtrArrayPos pos)
+{
+    Ptr ptr;
+    
+    ASSERT(array->cmpfunc != NULL, return);
+    ASSERT(pos < array->len, return);
+    
+    ptr = array->array[pos];
+    
+    /*move down*/
+    while ((pos > 0) && (array->cmpfunc(&ptr, array->array + pos - 1) < 0))
+    {
+        array->array[pos] = array->array[pos - 1];
+        pos--;
+    }
+    
+    /*or up*/
+    while ((pos + 1 < array->len) && (array->cmpfunc(&ptr, array->array + pos + 1) > 0))
+    {
+        array->array[pos] = array->array[pos + 1];
+        pos++;
+    }
+    
+    array->array[pos] = ptr;
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+PtrArray_sortNearly(PtrArray array, Uint32 maxmoves)
+{
+    PtrArrayPos i, j;
+    Ptr ptr;
+    
+    ASSERT(array->cmpfunc != NULL, return TRUE);
+    
+    for (i = 1; i < array->len; i++)
+    {
+        ptr = array->array[i];
+        j = i;
+        while ((j > 0) && (array->cmpfunc(&ptr, array->array + j - 1) < 0))
+        {
+            if (maxmoves == 0)
+            {
+                array->array[j] = ptr;
+                return TRUE;
+            }
+            maxmoves--;
+            array->array[j] = array->array[j - 1];
+            j--;
+        }
+        array->array[j] = ptr;
+    }
+    return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+PtrArray_sortByKey(PtrArray array, PtrKeyFunc keyfunc)
+{
+    Uint32* keys;
+    Uint32* tmpkeys;
+    Ptr* src;
+    Ptr* tmp;
+    Ptr* swapp;
+    Uint32* swapk;
+    PtrArrayPos count[256];
+    PtrArrayPos i, sum, c;
+    Uint32 diff;
+    int shift;
+    
+    if (array->len < 2)
+    {
+        return;
+    }
+    
+    keys = MALLOC(sizeof(Uint32) * array->len);
+    tmpkeys = MALLOC(sizeof(Uint32) * array->len);
+    tmp = MALLOC(sizeof(Ptr) * array->len);
+    src = array->array;
+    
+    /*bits that differ among keys, other digits need no pass*/
+    diff = 0;
+    for (i = 0; i < array->len; i++)
+    {
+        keys[i] = keyfunc(src[i]);
+        diff |= keys[i] ^ keys[0];
+    }
+    
+    /*least significant digit first, 8 bits at a time*/
+    for (shift = 0; shift < 32; shift += 8)
+    {
+        if (((diff >> shift) & 0xFF) == 0)
+        {
+            continue;
+        }
+        
+        for (i = 0; i < 256; i++)
+        {
+            count[i] = 0;
+        }
+        for (i = 0; i < array->len; i++)
+        {
+            count[(keys[i] >> shift) & 0xFF]++;
+        }
+        sum = 0;
+        for (i = 0; i < 256; i++)
+        {
+            c = count[i];
+            count[i] = sum;
+            sum += c;
+        }
+        for (i = 0; i < array->len; i++)
+        {
+            c = count[(keys[i] >> shift) & 0xFF]++;
+            tmp[c] = src[i];
+            tmpkeys[c] = keys[i];
+        }
+        
+        swapp = src;
+        src = tmp;
+        tmp = swapp;
+        swapk = keys;
+        keys = tmpkeys;
+        tmpkeys = swapk;
+    }
+    
+    /*the result may be in the temporary buffer*/
+    if (src != array->array)
+    {
+        memCOPY(array->array, src, sizeof(Ptr) * array->len);
+        tmp = src;
+    }
+    FREE(tmp);
+    FREE(keys);
+    FREE(tmpkeys);
+}
+
 /*----------------------------------------------------------------------------*/
 PtrArrayIterator
 PtrArray_find(PtrArray array, Ptr base)
@@ -32,6 +32,7 @@
 #include "core/string.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <ctype.h>
 
 /******************************************************************************
@@ -42,6 +43,8 @@ struct pv_Reader
     char* source;
     char* readpos;
     ReaderToken current;
+    Bool error;         /*a malformed input was encountered*/
+    Bool uncacheable;   /*a parsed value came from a shell function call*/
 };
 
 /******************************************************************************
@@ -49,109 +52,66 @@ struct pv_Reader
  *#                            Private functions                             #*
  *############################################################################*
  ******************************************************************************/
-static String
-readSource(Bool file, const char* s)
+/*Pre-parse a source in a single pass: whitespaces outside quotes are stripped
+  and unterminated strings are closed. dest may be equal to src because the
+  result is never longer than the source, except for the closing quote that is
+  appended at the end, so dest must have room for len + 2 characters.
+  Return TRUE if the source was malformed.*/
+static Bool
+readSource(char* dest, const char* src, const char* origin)
 {
-    String ret;
-    FILE* f = NULL;
     char c;
-    Bool protected = FALSE;
-    Bool escape = FALSE;
-
-    /*This function is used to store the source in a string after having pre-parsed it.*/
-    
-    ret = String_new("");
-    if (file)
-    {
-        f = fopen(s, "rb");
-        if (f == NULL)
-        {
-            return ret;
-        }
-    }
     
-    do
+    while (1)
     {
-        /*read one character*/
-        if (file)
+        /*outside of a string*/
+        c = *(src++);
+        while ((c != '\"') && (c != '\0'))
         {
-            int i;
-            i = fgetc(f);
-            if (i == EOF)
+            if (!isspace((int)(unsigned char)c))
             {
-                c = '\0';
-            }
-            else
-            {
-                c = (int)i;
+                *(dest++) = c;
             }
+            c = *(src++);
         }
-        else
+        if (c == '\0')
         {
-            c = *(s++);
+            *dest = '\0';
+            return FALSE;
         }
+        *(dest++) = c;
         
-        /*cases*/
-        if (protected)
+        /*inside a string*/
+        c = *(src++);
+        while (c != '\"')
         {
-            if (escape)
+            if (c == '\0')
             {
-                if (c == '\0')
-                {
-                    shellPrint(LEVEL_ERROR, "Escaping character at end of stream in :");
-                    shellPrintf(LEVEL_ERROR, "%s", s);
-                    String_appendChar(ret, '\"');
-                }
-                else
-                {
-                    String_appendChar(ret, c);
-                }
-                escape = FALSE;
+                shellPrint(LEVEL_ERROR, "End of stream encountered while expecting a '\"' in :");
+                shellPrintf(LEVEL_ERROR, "%s", origin);
+                *(dest++) = '\"';
+                *dest = '\0';
+                return TRUE;
             }
-            else
+            *(dest++) = c;
+            if (c == '\\')
             {
-                if (c == '\\')
-                {
-                    escape = TRUE;
-                    String_appendChar(ret, c);
-                }
-                else if (c == '\"')
-                {
-                    protected = FALSE;
-                    String_appendChar(ret, c);
-                }
-                else if (c == '\0')
-                {
-                    shellPrint(LEVEL_ERROR, "End of stream encountered while expecting a '\"' in :");
-                    shellPrintf(LEVEL_ERROR, "%s", s);
-                    String_appendChar(ret, '\"');
-                }
-                else
+                c = *(src++);
+                if (c == '\0')
                 {
-                    String_appendChar(ret, c);
+                    shellPrint(LEVEL_ERROR, "Escaping character at end of stream in :");
+                    shellPrintf(LEVEL_ERROR, "%s", origin);
+                    /*the dangling escaping character becomes the closing quote*/
+                    dest[-1] = '\"';
+                    *dest = '\0';
+                    return TRUE;
                 }
+                *(dest++) = c;
             }
+            c = *(src++);
         }
-        else
-        {
-            if (c == '\"')
-            {
-                String_appendChar(ret, c);
-                protected = TRUE;
-            }
-            else if ((!isspace((int)c)) && (c != '\0'))
-            {
-                String_appendChar(ret, c);
-            }
-        }
-    } while (c != '\0');
-    
-    if (file)
-    {
-        fclose(f);
+        *(dest++) = c;
     }
-    
-    return ret;
 }
 
 /******************************************************************************
@@ -163,13 +123,33 @@ Reader
 Reader_newFromFile(const char* path)
 {
     Reader ret;
-    String source;
+    FILE* f;
+    long size;
     
     ret = MALLOC(sizeof(pv_Reader));
-    source = readSource(TRUE, path);
-    ret->source = MALLOC(sizeof(char) * (String_getLength(source) + 1));
-    memCOPY(ret->source, String_get(source), sizeof(char) * (String_getLength(source) + 1));
-    String_del(source);
+    
+    /*the whole file is read at once and pre-parsed in place*/
+    size = 0;
+    f = fopen(path, "rb");
+    if (f != NULL)
+    {
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        if (size < 0)
+        {
+            size = 0;
+        }
+    }
+    ret->source = MALLOC(sizeof(char) * (size + 2));
+    if (f != NULL)
+    {
+        size = fread(ret->source, sizeof(char), size, f);
+        fclose(f);
+    }
+    ret->source[size] = '\0';
+    ret->error = readSource(ret->source, ret->source, path);
+    ret->uncacheable = FALSE;
     
     ret->readpos = ret->source;
     ret->current.type = READER_CHAR;
@@ -184,13 +164,11 @@ Reader
 Reader_newFromString(const char* s)
 {
     Reader ret;
-    String source;
     
     ret = MALLOC(sizeof(pv_Reader));
-    source = readSource(FALSE, s);
-    ret->source = MALLOC(sizeof(char) * (String_getLength(source) + 1));
-    memCOPY(ret->source, String_get(source), sizeof(char) * (String_getLength(source) + 1));
-    String_del(source);
+    ret->source = MALLOC(sizeof(char) * (strlen(s) + 2));
+    ret->error = readSource(ret->source, s, s);
+    ret->uncacheable = FALSE;
     
     ret->readpos = ret->source;
     ret->current.type = READER_CHAR;
@@ -212,6 +190,34 @@ Reader_del(Reader reader)
     FREE(reader);
 }
 
+/*----------------------------------------------------------------------------*/
+void
+Reader_setError(Reader reader)
+{
+    reader->error = TRUE;
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+Reader_hasError(Reader reader)
+{
+    return reader->error;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+Reader_setUncacheable(Reader reader)
+{
+    reader->uncacheable = TRUE;
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+Reader_isCacheable(Reader reader)
+{
+    return (!reader->error) && (!reader->uncacheable);
+}
+
 /*----------------------------------------------------------------------------*/
 ReaderToken*
 Reader_getCurrent(Reader reader)
@@ -248,8 +254,17 @@ Reader_forward(Reader reader)
     else if (c == '\"')
     {
         /*seems to have a double-quoted string*/
+        const char* end;
+        
         ret->type = READER_STRING;
-        ret->value.s = String_new("");
+        
+        /*strings without escaping characters are copied at once*/
+        for (end = reader->readpos; (*end != '\"') && (*end != '\\'); end++)
+        {
+            ASSERT_CRITICAL(*end != '\0');
+        }
+        ret->value.s = String_newBySizedCopy(reader->readpos, end - reader->readpos);
+        reader->readpos = (char*)end;
         c = *(reader->readpos++);
         while (c != '\"')   /*should always exit of this, because of the pre-parsing*/
         {
@@ -312,15 +327,16 @@ Reader_forward(Reader reader)
     else if (isalpha(c))
     {
         /*seems to have a name*/
+        const char* begin;
+        
         ret->type = READER_NAME;
-        ret->value.s = String_new("");
-        String_appendChar(ret->value.s, c);
+        begin = reader->readpos - 1;
         c = *(reader->readpos);
         while (isalnum(c) | (c == '_'))
         {
-            String_appendChar(ret->value.s, c);
             c = *(++reader->readpos);
         }
+        ret->value.s = String_newBySizedCopy(begin, reader->readpos - begin);
     }
     else
     {
@@ -69,7 +69,7 @@ String_new(const char* st)
     }
     
     /*alloc*/
-    ret = MALLOC(sizeof(pv_String));
+    ret = POOL_ALLOC(MEMPOOL_STRING, sizeof(pv_String));
     ret->len = i;
     ret->alloclen = i + 6;
     ret->str = MALLOC(sizeof(char) * ret->alloclen);
@@ -87,7 +87,7 @@ String_newBySizedCopy(const char* st, unsigned int nbc)
     String ret;
     
     /*alloc*/
-    ret = MALLOC(sizeof(pv_String));
+    ret = POOL_ALLOC(MEMPOOL_STRING, sizeof(pv_String));
     ret->len = nbc;
     ret->alloclen = nbc + 6;
     ret->str = MALLOC(sizeof(char) * ret->alloclen);
@@ -106,7 +106,7 @@ String_newByCopy(String string)
     String ret;
     
     /*alloc*/
-    ret = MALLOC(sizeof(pv_String));
+    ret = POOL_ALLOC(MEMPOOL_STRING, sizeof(pv_String));
     ret->len = string->len;
     ret->alloclen = string->alloclen;
     ret->str = MALLOC(sizeof(char) * ret->alloclen);
@@ -122,7 +122,7 @@ void
 String_del(String s)
 {
     FREE(s->str);
-    FREE(s);
+    POOL_FREE(MEMPOOL_STRING, s);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -155,7 +155,7 @@ String_replace(String string, const char* cstring)
     FREE(string->str);
     fake = String_new(cstring);
     *string = *fake;
-    FREE(fake);
+    POOL_FREE(MEMPOOL_STRING, fake);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -350,7 +350,7 @@ String_vprintf(String s, const char* format, va_list list)
         fake = String_newBySizedCopy(buf, size);
         FREE(s->str);
         *s = *fake;
-        FREE(fake);
+        POOL_FREE(MEMPOOL_STRING, fake);
     }
 #endif
 }
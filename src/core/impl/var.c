@@ -40,15 +40,38 @@
 
 #include <ctype.h>
 #include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_STAT_H
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #ifdef __W32
+        #include <direct.h>
+        #define makeDir(_path_) mkdir(_path_)
+    #else
+        #define makeDir(_path_) mkdir(_path_, 0755)
+    #endif
+    #define VAR_CACHE 1
+#endif
 
 /******************************************************************************
  *                                  Typedefs                                  *
  ******************************************************************************/
+/*Lookup table of the named elements of an array*/
+typedef struct
+{
+    Uint32 size;            /*number of slots, power of 2*/
+    Uint32 nb;              /*number of indexed elements*/
+    Var* slots;             /*elements by name hash, open addressing*/
+} VarIndex;
+
 struct pv_Var
 {
     String name;            /*!< Variable's name */
     VarType type;           /*!< Variable's type */
     String image;           /*!< String representation */
+    Uint32 hash;            /*!< Hash of the name */
+    VarIndex* index;        /*!< Named lookup table of an array, NULL if it has no named element */
     union
     {
         Int      vint;          /*!< Integer value */
@@ -59,11 +82,39 @@ struct pv_Var
     } value;                /*!< Variable's value */
 };
 
+/*Binary cache writing context*/
+typedef struct
+{
+    FILE* file;
+    Uint32 nbstrings;       /*interned strings*/
+    Uint32 tablesize;       /*size of the hash table, power of 2*/
+    String* table;          /*interned strings, by hash*/
+    Uint32* indexes;        /*index of each string in the table*/
+} VarCacheWriter;
+
+/*Binary cache reading context*/
+typedef struct
+{
+    const Uint8* cur;
+    const Uint8* end;
+    Uint32 nbstrings;
+    const char** strings;   /*strings, pointing in the file buffer*/
+} VarCacheReader;
+
 /******************************************************************************
  *                                   Macros                                   *
  ******************************************************************************/
 #define Var_CLEARIMAGE(_var_) if ((_var_)->image != NULL) {String_del((_var_)->image); (_var_)->image = NULL;}
 
+/*Magic number and format version of the binary cache files*/
+#define VARCACHE_MAGIC "SWVC"
+#define VARCACHE_VERSION 2
+
+/******************************************************************************
+ *                             Static variables                               *
+ ******************************************************************************/
+static String _cachedir = NULL;
+
 /******************************************************************************
  *############################################################################*
  *#                           Internal functions                             #*
@@ -83,6 +134,7 @@ Var_setFromReader(Var var, Reader reader)
         {
             /*TODO: better error message*/
             shellPrint(LEVEL_ERROR, "Didn't find a variable name after '#' given.");
+            Reader_setError(reader);
             Var_setName(var, NULL);
             Var_setVoid(var);
             return;
@@ -98,6 +150,7 @@ Var_setFromReader(Var var, Reader reader)
             /*TODO: collect the value from shell variables*/
             /*TODO: better error message*/
             shellPrintf(LEVEL_ERROR, "Don't have a '=' symbol for '%s' variable.", String_get(Var_getName(var)));
+            Reader_setError(reader);
             Var_setVoid(var);
             return;
         }
@@ -164,6 +217,7 @@ Var_setFromReader(Var var, Reader reader)
             {
                 /*TODO: better error message*/
                 shellPrintf(LEVEL_ERROR, "End of stream encountered while expecting ']' for variable '%s'.", String_get(Var_getName(var)));
+                Reader_setError(reader);
                 Var_setVoid(var);
                 return;
             }
@@ -171,6 +225,7 @@ Var_setFromReader(Var var, Reader reader)
             {
                 /*TODO: better error message*/
                 shellPrintf(LEVEL_ERROR, "Unexpected token encountered while expecting ']' for variable '%s'.", String_get(Var_getName(var)));
+                Reader_setError(reader);
                 Var_setVoid(var);
                 return;
             }
@@ -185,6 +240,7 @@ Var_setFromReader(Var var, Reader reader)
         {
             /*TODO: better error message*/
             shellPrintf(LEVEL_ERROR, "Wrong link format for variable '%s'.", String_get(Var_getName(var)));
+            Reader_setError(reader);
             Var_setVoid(var);
             return;
         }
@@ -195,19 +251,565 @@ Var_setFromReader(Var var, Reader reader)
     }
     else if (cur->type == READER_NAME)
     {
-        /*seems to have a shell call*/
-        shellExecFromReader(var, reader);
+        /*seems to have a shell call, its side effects and result are not in the cache*/
+        Reader_setUncacheable(reader);
+        if (shellExecFromReader(var, reader))
+        {
+            Reader_setError(reader);
+        }
     }
     else
     {
         /*we're running short of options*/
         /*TODO: better error message*/
         shellPrintf(LEVEL_ERROR, "Wrong value format for variable '%s'.", String_get(Var_getName(var)));
+        Reader_setError(reader);
         Var_setVoid(var);
         return;
     }
 }
 
+/*----------------------------------------------------------------------------*/
+void
+Var_setCacheDirectory(const char* path)
+{
+    if (_cachedir != NULL)
+    {
+        String_del(_cachedir);
+        _cachedir = NULL;
+    }
+#ifdef VAR_CACHE
+    if (path != NULL)
+    {
+        _cachedir = String_new(path);
+        makeDir(path);
+        String_appendChar(_cachedir, '/');
+    }
+#endif
+}
+
+/******************************************************************************
+ *############################################################################*
+ *#                              Named lookup                                #*
+ *############################################################################*
+ ******************************************************************************/
+static Uint32
+hashString(const char* st)
+{
+    Uint32 h;
+    
+    /*FNV-1a, 0 is kept for unhashed keys*/
+    h = 2166136261u;
+    while (*st != '\0')
+    {
+        h = (h ^ (Uint8)*st++) * 16777619u;
+    }
+    return (h == 0) ? 1 : h;
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+clearIndex(Var var)
+{
+    if (var->index != NULL)
+    {
+        FREE(var->index->slots);
+        FREE(var->index);
+        var->index = NULL;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+indexAdd(VarIndex* index, Var v)
+{
+    Uint32 h;
+    
+    h = v->hash & (index->size - 1);
+    while (index->slots[h] != NULL)
+    {
+        h = (h + 1) & (index->size - 1);
+    }
+    index->slots[h] = v;
+    index->nb++;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Build the lookup table of an array from scratch.
+  Arrays are indexed as soon as they are modified, lookups never write in them
+  so that published trees can be read by several threads.*/
+static void
+buildIndex(Var var)
+{
+    VarIndex* index;
+    PtrArrayIterator i;
+    Uint32 nb, h;
+    
+    clearIndex(var);
+    
+    nb = 0;
+    for (i = PtrArray_START(var->value.varray); i != PtrArray_STOP(var->value.varray); i++)
+    {
+        if (!String_isEmpty(((Var)*i)->name))
+        {
+            nb++;
+        }
+    }
+    if (nb == 0)
+    {
+        return;
+    }
+    
+    /*keep the load under one half*/
+    index = MALLOC(sizeof(VarIndex));
+    index->size = 8;
+    while (index->size < nb * 2)
+    {
+        index->size *= 2;
+    }
+    index->nb = 0;
+    index->slots = MALLOC(sizeof(Var) * index->size);
+    for (h = 0; h < index->size; h++)
+    {
+        index->slots[h] = NULL;
+    }
+    
+    for (i = PtrArray_START(var->value.varray); i != PtrArray_STOP(var->value.varray); i++)
+    {
+        if (!String_isEmpty(((Var)*i)->name))
+        {
+            indexAdd(index, (Var)*i);
+        }
+    }
+    
+    var->index = index;
+}
+
+/*----------------------------------------------------------------------------*/
+static Var
+findByHash(Var var, const char* name, Uint32 hash)
+{
+    Uint32 h;
+    Var v;
+    
+    ASSERT(var->type == VAR_ARRAY, return NULL);
+    
+    if (var->index == NULL)
+    {
+        return NULL;
+    }
+    
+    h = hash & (var->index->size - 1);
+    while ((v = var->index->slots[h]) != NULL)
+    {
+        if ((v->hash == hash) && (strcmp(String_get(v->name), name) == 0))
+        {
+            return v;
+        }
+        h = (h + 1) & (var->index->size - 1);
+    }
+    return NULL;
+}
+
+/******************************************************************************
+ *############################################################################*
+ *#                            Binary cache                                  #*
+ *############################################################################*
+ ******************************************************************************/
+#ifdef VAR_CACHE
+static void
+writeUint32(FILE* f, Uint32 v)
+{
+    fputc(v & 0xFF, f);
+    fputc((v >> 8) & 0xFF, f);
+    fputc((v >> 16) & 0xFF, f);
+    fputc((v >> 24) & 0xFF, f);
+}
+
+/*----------------------------------------------------------------------------*/
+/*Give the index of a string in the strings table, adding it if needed*/
+static Uint32
+internString(VarCacheWriter* writer, String string)
+{
+    Uint32 h;
+    
+    h = hashString(String_get(string)) & (writer->tablesize - 1);
+    while (writer->table[h] != NULL)
+    {
+        if (String_equal(writer->table[h], string))
+        {
+            return writer->indexes[h];
+        }
+        h = (h + 1) & (writer->tablesize - 1);
+    }
+    writer->table[h] = string;
+    writer->indexes[h] = writer->nbstrings;
+    return writer->nbstrings++;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Count the strings of a tree (with duplicates) to size the hash table*/
+static Uint32
+countStrings(Var var)
+{
+    Uint32 ret;
+    VarArrayPos i;
+    
+    ret = 1;
+    if ((var->type == VAR_STRING) || (var->type == VAR_LINK))
+    {
+        ret++;
+    }
+    else if (var->type == VAR_ARRAY)
+    {
+        for (i = 0; i < Var_getArraySize(var); i++)
+        {
+            ret += countStrings(Var_getArrayElemByPos(var, i));
+        }
+    }
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+internTree(VarCacheWriter* writer, Var var)
+{
+    VarArrayPos i;
+    
+    internString(writer, var->name);
+    if (var->type == VAR_STRING)
+    {
+        internString(writer, var->value.vstring);
+    }
+    else if (var->type == VAR_LINK)
+    {
+        internString(writer, var->value.link);
+    }
+    else if (var->type == VAR_ARRAY)
+    {
+        for (i = 0; i < Var_getArraySize(var); i++)
+        {
+            internTree(writer, Var_getArrayElemByPos(var, i));
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+writeTree(VarCacheWriter* writer, Var var)
+{
+    VarArrayPos i;
+    Uint32 v;
+    
+    fputc((int)var->type, writer->file);
+    writeUint32(writer->file, internString(writer, var->name));
+    switch (var->type)
+    {
+        case VAR_VOID:
+            break;
+        case VAR_INT:
+            writeUint32(writer->file, (Uint32)var->value.vint);
+            break;
+        case VAR_FLOAT:
+            memcpy(&v, &var->value.vfloat, sizeof(Uint32));
+            writeUint32(writer->file, v);
+            break;
+        case VAR_STRING:
+            writeUint32(writer->file, internString(writer, var->value.vstring));
+            break;
+        case VAR_LINK:
+            writeUint32(writer->file, internString(writer, var->value.link));
+            break;
+        case VAR_ARRAY:
+            writeUint32(writer->file, Var_getArraySize(var));
+            for (i = 0; i < Var_getArraySize(var); i++)
+            {
+                writeTree(writer, Var_getArrayElemByPos(var, i));
+            }
+            break;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*Build the cache file name of a source file*/
+static String
+cacheFile(const char* source)
+{
+    String ret;
+    
+    ret = String_new("");
+    String_printf(ret, "%s%08lx.bin", String_get(_cachedir), (unsigned long)hashString(source));
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Save a variable tree in the cache*/
+static void
+writeCache(Var var, const char* source, struct stat* info)
+{
+    VarCacheWriter writer;
+    String file;
+    String* strings;
+    Uint32 i;
+    
+    file = cacheFile(source);
+    writer.file = fopen(String_get(file), "wb");
+    if (writer.file == NULL)
+    {
+        String_del(file);
+        return;
+    }
+    
+    /*intern all strings*/
+    writer.nbstrings = 0;
+    writer.tablesize = 16;
+    i = countStrings(var) * 2;
+    while (writer.tablesize < i)
+    {
+        writer.tablesize *= 2;
+    }
+    writer.table = MALLOC(sizeof(String) * writer.tablesize);
+    writer.indexes = MALLOC(sizeof(Uint32) * writer.tablesize);
+    for (i = 0; i < writer.tablesize; i++)
+    {
+        writer.table[i] = NULL;
+    }
+    internTree(&writer, var);
+    
+    /*header, the source path and date are checked at loading*/
+    fwrite(VARCACHE_MAGIC, 1, 4, writer.file);
+    writeUint32(writer.file, VARCACHE_VERSION);
+    writeUint32(writer.file, (Uint32)info->st_mtime);
+    writeUint32(writer.file, (Uint32)info->st_size);
+    writeUint32(writer.file, strlen(source));
+    fwrite(source, 1, strlen(source) + 1, writer.file);
+    
+    /*strings table*/
+    strings = MALLOC(sizeof(String) * (writer.nbstrings + 1));
+    for (i = 0; i < writer.tablesize; i++)
+    {
+        if (writer.table[i] != NULL)
+        {
+            strings[writer.indexes[i]] = writer.table[i];
+        }
+    }
+    writeUint32(writer.file, writer.nbstrings);
+    for (i = 0; i < writer.nbstrings; i++)
+    {
+        writeUint32(writer.file, String_getLength(strings[i]));
+        fwrite(String_get(strings[i]), 1, String_getLength(strings[i]) + 1, writer.file);
+    }
+    FREE(strings);
+    
+    /*tree*/
+    writeTree(&writer, var);
+    
+    FREE(writer.table);
+    FREE(writer.indexes);
+    if (fclose(writer.file) != 0)
+    {
+        remove(String_get(file));
+    }
+    String_del(file);
+}
+
+/*----------------------------------------------------------------------------*/
+static Bool
+readUint32(VarCacheReader* reader, Uint32* v)
+{
+    if (reader->end - reader->cur < 4)
+    {
+        return TRUE;
+    }
+    *v = (Uint32)reader->cur[0] | ((Uint32)reader->cur[1] << 8) | ((Uint32)reader->cur[2] << 16) | ((Uint32)reader->cur[3] << 24);
+    reader->cur += 4;
+    return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Read a null terminated string of known length*/
+static const char*
+readString(VarCacheReader* reader)
+{
+    Uint32 len;
+    const char* ret;
+    
+    if (readUint32(reader, &len) || ((Uint32)(reader->end - reader->cur) <= len) || (reader->cur[len] != '\0'))
+    {
+        return NULL;
+    }
+    ret = (const char*)reader->cur;
+    reader->cur += len + 1;
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+static const char*
+readStringRef(VarCacheReader* reader)
+{
+    Uint32 i;
+    
+    if (readUint32(reader, &i) || (i >= reader->nbstrings))
+    {
+        return NULL;
+    }
+    return reader->strings[i];
+}
+
+/*----------------------------------------------------------------------------*/
+static Bool
+readTree(VarCacheReader* reader, Var var)
+{
+    const char* st;
+    Uint32 v, i;
+    Float f;
+    Var elem;
+    
+    if (reader->cur == reader->end)
+    {
+        return TRUE;
+    }
+    v = *reader->cur++;
+    st = readStringRef(reader);
+    if (st == NULL)
+    {
+        return TRUE;
+    }
+    Var_setName(var, st);
+    
+    switch (v)
+    {
+        case VAR_VOID:
+            break;
+        case VAR_INT:
+            if (readUint32(reader, &v))
+            {
+                return TRUE;
+            }
+            Var_setInt(var, (Int)v);
+            break;
+        case VAR_FLOAT:
+            if (readUint32(reader, &v))
+            {
+                return TRUE;
+            }
+            memcpy(&f, &v, sizeof(Uint32));
+            Var_setFloat(var, f);
+            break;
+        case VAR_STRING:
+        case VAR_LINK:
+            st = readStringRef(reader);
+            if (st == NULL)
+            {
+                return TRUE;
+            }
+            Var_setType(var, (VarType)v);
+            String_replace((v == VAR_STRING) ? var->value.vstring : var->value.link, st);
+            break;
+        case VAR_ARRAY:
+            if (readUint32(reader, &v))
+            {
+                return TRUE;
+            }
+            Var_setArray(var);
+            /*elements were saved in the array order, which is kept as is*/
+            for (i = 0; i < v; i++)
+            {
+                elem = Var_new();
+                PtrArray_append(var->value.varray, elem);
+                if (readTree(reader, elem))
+                {
+                    return TRUE;
+                }
+            }
+            buildIndex(var);
+            break;
+        default:
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Load a variable tree from the cache, return TRUE if the cache is missing or outdated*/
+static Bool
+readCache(Var var, const char* source, struct stat* info)
+{
+    VarCacheReader reader;
+    String file;
+    FILE* f;
+    Uint8* buf;
+    long size;
+    Uint32 v, i;
+    const char* st;
+    Bool err;
+    
+    file = cacheFile(source);
+    f = fopen(String_get(file), "rb");
+    String_del(file);
+    if (f == NULL)
+    {
+        return TRUE;
+    }
+    
+    /*load the whole file at once*/
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 4)
+    {
+        fclose(f);
+        return TRUE;
+    }
+    buf = MALLOC(size);
+    err = (fread(buf, 1, size, f) != (size_t)size);
+    fclose(f);
+    
+    reader.cur = buf;
+    reader.end = buf + size;
+    reader.nbstrings = 0;
+    reader.strings = NULL;
+    
+    /*header*/
+    err = err || (memcmp(reader.cur, VARCACHE_MAGIC, 4) != 0);
+    reader.cur += 4;
+    err = err || readUint32(&reader, &v) || (v != VARCACHE_VERSION);
+    err = err || readUint32(&reader, &v) || (v != (Uint32)info->st_mtime);
+    err = err || readUint32(&reader, &v) || (v != (Uint32)info->st_size);
+    err = err || ((st = readString(&reader)) == NULL) || (strcmp(st, source) != 0);
+    
+    /*strings table*/
+    err = err || readUint32(&reader, &reader.nbstrings) || (reader.nbstrings > (Uint32)size);
+    if (!err)
+    {
+        reader.strings = MALLOC(sizeof(const char*) * (reader.nbstrings + 1));
+        for (i = 0; (i < reader.nbstrings) && (!err); i++)
+        {
+            reader.strings[i] = readString(&reader);
+            err = (reader.strings[i] == NULL);
+        }
+    }
+    
+    /*tree*/
+    if (!err)
+    {
+        Var_setVoid(var);
+        err = readTree(&reader, var);
+        if (err)
+        {
+            Var_setVoid(var);
+        }
+    }
+    
+    if (reader.strings != NULL)
+    {
+        FREE(reader.strings);
+    }
+    FREE(buf);
+    return err;
+}
+#endif
+
 /******************************************************************************
  *############################################################################*
  *#                             Public functions                             #*
@@ -218,10 +820,12 @@ Var_new()
 {
     Var ret;
     
-    ret = (Var)MALLOC(sizeof(pv_Var));
+    ret = (Var)POOL_ALLOC(MEMPOOL_VAR, sizeof(pv_Var));
     ret->name = String_new("");
+    ret->hash = hashString("");
     ret->type = VAR_VOID;
     ret->image = NULL;
+    ret->index = NULL;
     return ret;
 }
 
@@ -231,10 +835,12 @@ Var_newByCopy(Var v)
 {
     Var ret;
     
-    ret = (Var)MALLOC(sizeof(pv_Var));
+    ret = (Var)POOL_ALLOC(MEMPOOL_VAR, sizeof(pv_Var));
     ret->type = VAR_VOID;
     ret->name = String_newByCopy(v->name);
+    ret->hash = v->hash;
     ret->image = NULL;
+    ret->index = NULL;
     Var_setFromVar(ret, v);
     
     return ret;
@@ -247,7 +853,7 @@ Var_del(Var var)
     Var_CLEARIMAGE(var);
     Var_setVoid(var);
     String_del(var->name);
-    FREE(var);
+    POOL_FREE(MEMPOOL_VAR, var);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -265,6 +871,7 @@ void
 Var_setName(Var var, const char* name)
 {
     String_replace(var->name, (name == NULL) ? "" : name);
+    var->hash = hashString(String_get(var->name));
     Var_CLEARIMAGE(var);
 }
 
@@ -307,6 +914,7 @@ Var_setVoid(Var var)
     }
     else if (var->type == VAR_ARRAY)
     {
+        clearIndex(var);
         PtrArray_del(var->value.varray);
     }
     else if (var->type == VAR_LINK)
@@ -380,6 +988,14 @@ Var_insertIntoArray(Var var, Var elem)
     else
     {
         PtrArray_insertSorted(var->value.varray, (Ptr)elem);
+        if ((var->index == NULL) || ((var->index->nb + 1) * 2 > var->index->size))
+        {
+            buildIndex(var);
+        }
+        else
+        {
+            indexAdd(var->index, elem);
+        }
     }
     Var_CLEARIMAGE(var);
 }
@@ -415,6 +1031,7 @@ Var_setFromVar(Var dest, Var src)
                 Var_setFromVar(v, (Var)*i);
                 PtrArray_append(dest->value.varray, v);
             }
+            buildIndex(dest);
             break;
         case VAR_LINK:
             Var_setVoid(dest);
@@ -448,6 +1065,10 @@ Var_readFromFile(Var var, String file)
 {
     Reader reader;
     String name;
+#ifdef VAR_CACHE
+    struct stat info;
+    Bool recache;
+#endif
     
     if (String_cmp(&file, &STRING_NULL) == 0)
     {
@@ -458,6 +1079,25 @@ Var_readFromFile(Var var, String file)
     name = String_newByCopy(Var_getName(var));
     
     coreFindData(file);
+    
+#ifdef VAR_CACHE
+    /*use the compiled version if it is up to date*/
+    recache = FALSE;
+    if ((_cachedir != NULL) && (stat(String_get(file), &info) == 0))
+    {
+        if (readCache(var, String_get(file), &info))
+        {
+            recache = TRUE;
+        }
+        else
+        {
+            Var_setName(var, String_get(name));
+            String_del(name);
+            return FALSE;
+        }
+    }
+#endif
+    
     reader = Reader_newFromFile(String_get(file));
     /*if (reader == NULL)
     {
@@ -467,6 +1107,15 @@ Var_readFromFile(Var var, String file)
     
     Var_setFromReader(var, reader);
     
+#ifdef VAR_CACHE
+    /*a broken tree is not cached, its errors must show up again on next run,
+    neither is a tree calling shell functions, they must run again*/
+    if (recache && Reader_isCacheable(reader))
+    {
+        writeCache(var, String_get(file), &info);
+    }
+#endif
+    
     Reader_del(reader);
     
     Var_setName(var, String_get(name));
@@ -556,7 +1205,7 @@ Var_gets(Var var)
                 for (i = 0; i < Var_getArraySize(var); i++)
                 {
                     String_append(var->image, Var_gets(Var_getArrayElemByPos(var, i)));
-                    if ((int)i < PtrArray_SIZE(var->value.varray) - 1)
+                    if (i + 1 < PtrArray_SIZE(var->value.varray))
                     {
                         String_appendChar(var->image, ',');
                     }
@@ -625,7 +1274,7 @@ Var_resolveLink(Var var)
 void
 Var_removeUnnamedFields(Var var)
 {
-    int i;
+    PtrArrayPos i;
     
     ASSERT(var->type == VAR_ARRAY, return);
     
@@ -648,38 +1297,25 @@ Var_removeUnnamedFields(Var var)
 Var
 Var_getArrayElemByName(Var var, String name)
 {
-    PtrArrayIterator i;
-    Var v;
-    
-    ASSERT(var->type == VAR_ARRAY, return NULL);
-    
-    v = Var_new();
-    Var_setName(v, String_get(name));
-    i = PtrArray_findSorted(var->value.varray, v);
-    Var_del(v);
-    
-    if (i == NULL)
-    {
-        return NULL;
-    }
-    else
-    {
-        return (Var)*i;
-    }
+    return findByHash(var, String_get(name), hashString(String_get(name)));
 }
 
 /*----------------------------------------------------------------------------*/
 Var
 Var_getArrayElemByCName(Var var, char* name)
 {
-    String s;
-    Var ret;
-    
-    s = String_new(name);
-    ret = Var_getArrayElemByName(var, s);
-    String_del(s);
-    
-    return ret;
+    return findByHash(var, name, hashString(name));
+}
+
+/*----------------------------------------------------------------------------*/
+Var
+Var_getArrayElemByKey(Var var, VarKey* key)
+{
+    if (key->hash == 0)
+    {
+        key->hash = hashString(key->name);
+    }
+    return findByHash(var, key->name, key->hash);
 }
 
 /*----------------------------------------------------------------------------*/
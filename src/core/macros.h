@@ -53,4 +53,34 @@
 #define CHECK_ARGS_PRINTF(format_idx, arg_idx)
 #endif
 
+/*!
+ * \brief Compile a function for the SSE2 instruction set.
+ *
+ * Put it before the return type of a function using SSE2 intrinsics, it is then built
+ * whatever the target of the rest of the program. Such a function must only be called
+ * when SDL_HasSSE2() is true.<br>
+ * HAVE_TARGET_SSE2 is defined when the compiler supports it (x86 processors only).
+ */
+#if (defined(__i386__) || defined(__x86_64__)) \
+ && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define HAVE_TARGET_SSE2 1
+#define TARGET_SSE2 __attribute__((__target__("sse2")))
+#else
+#define TARGET_SSE2
+#endif
+
+/*!
+ * \brief Storage class of a static variable that has one instance per thread.
+ *
+ * HAVE_THREAD_LOCAL is defined when the compiler supports it, code using it must
+ * have a fallback otherwise.
+ */
+#if defined(__clang__) \
+ || ((__GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 3)) && !defined(__APPLE__))
+#define HAVE_THREAD_LOCAL 1
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
 #endif
@@ -105,8 +105,17 @@ typedef void (*PtrFuncWithData)(Ptr ptr, void* data);
  */
 typedef int (*PtrCmpFunc)(Ptr* ptr1, Ptr* ptr2);
 
-/*! \brief Type for array's index and size. */
-typedef Uint16 PtrArrayPos;
+/*!
+ * \brief Sorting key of a pointer.
+ *
+ * Pointers are sorted by increasing keys.
+ */
+typedef Uint32 (*PtrKeyFunc)(Ptr ptr);
+
+/*!
+ * \brief Type for array's index and size.
+ */
+typedef Uint32 PtrArrayPos;
 
 /*!
  * \brief Type for an array iterator.
@@ -121,7 +130,7 @@ typedef struct
     Ptr* array;             /*!< The array. */
     PtrArrayPos len;        /*!< Current length (number of pointers in the array). */
     PtrArrayPos alloclen;   /*!< Really allocated size (in number of pointers). */
-    PtrArrayPos allocrange; /*!< Number of allocations to do at the same time (in anticipation). */
+    PtrArrayPos allocrange; /*!< Minimal number of allocations to do at the same time (in anticipation). */
     PtrFunc delfunc;        /*!< Delete function for the pointers of this array. */
     PtrCmpFunc cmpfunc;     /*!< Compare function for the pointers of this array. */
 } pv_PtrArray;
@@ -159,7 +168,7 @@ PtrArray PtrArray_newFakeCopy(PtrArray base);
  * \brief Create a fully controlled pointer array.
  *
  * \param startsize - Initial size of the array (allocated size, number of pointers remains 0).
- * \param sizebloc - Number of elements to pre-allocate at the same time when needed (this avoid frequent reallocations).
+ * \param sizebloc - Minimal number of elements to pre-allocate at the same time when needed. Big arrays grow by half their size.
  * \param delfunc - Function called when a pointer is removed from the array, can be NULL.
  * \param cmpfunc - Function used to compare two pointers (used for sorting). If NULL, a default pointer comparison will be used.
  * \return The newly allocated array.
@@ -229,6 +238,22 @@ void PtrArray_del(PtrArray array);
  */
 void PtrArray_clear(PtrArray array);
 
+/*!
+ * \brief Allocate room for a number of pointers.
+ *
+ * This avoids reallocations when the final size of an array is known.
+ * \param array - The array.
+ * \param size - Number of pointers the array must be able to hold.
+ */
+void PtrArray_reserve(PtrArray array, PtrArrayPos size);
+
+/*!
+ * \brief Give back the memory allocated in anticipation.
+ *
+ * \param array - The array.
+ */
+void PtrArray_shrinkToFit(PtrArray array);
+
 /*!
  * \brief Add a pointer to the end of an array.
  *
@@ -373,6 +398,37 @@ void PtrArray_sort(PtrArray array);
  */
 void PtrArray_sortRange(PtrArray array, PtrArrayPos start, PtrArrayPos end);
 
+/*!
+ * \brief Move one element to its place in an otherwise sorted array.
+ *
+ * This will use the cmpfunc provided (or the default one).
+ * \param array - The array.
+ * \param pos - Position of the element that is not sorted.
+ */
+void PtrArray_sortOne(PtrArray array, PtrArrayPos pos);
+
+/*!
+ * \brief Sort an almost sorted array.
+ *
+ * This is an insertion sort that gives up after a given number of moves, in
+ * which case the array is left partially sorted.
+ * This will use the cmpfunc provided (or the default one).
+ * \param array - The array.
+ * \param maxmoves - Maximal number of moves for the whole sort, all positions
+ *                   together.
+ * \return TRUE if the array could not be sorted within \a maxmoves moves.
+ */
+Bool PtrArray_sortNearly(PtrArray array, Uint32 maxmoves);
+
+/*!
+ * \brief Sort an array by keys.
+ *
+ * This is a stable radix sort, in linear time. The cmpfunc is not used.
+ * \param array - The array.
+ * \param keyfunc - Function giving the key of a pointer.
+ */
+void PtrArray_sortByKey(PtrArray array, PtrKeyFunc keyfunc);
+
 /*!
  * \brief Find an element equal to the given one in an array.
  *
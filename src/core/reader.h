@@ -104,6 +104,34 @@ Reader Reader_newFromString(const char* s);
  */
 void Reader_del(Reader reader);
 
+/*!
+ * \brief Mark the input as malformed.
+ * Called by the parsers using the reader when they report a syntax error.
+ * \param reader - The reader.
+ */
+void Reader_setError(Reader reader);
+
+/*!
+ * \brief Tell if the input was malformed.
+ * \param reader - The reader.
+ * \return TRUE if the reader or a parser using it encountered an error.
+ */
+Bool Reader_hasError(Reader reader);
+
+/*!
+ * \brief Mark the parsed result as not reproducible from the input alone.
+ * Called by the parsers when a value comes from a shell function call.
+ * \param reader - The reader.
+ */
+void Reader_setUncacheable(Reader reader);
+
+/*!
+ * \brief Tell if the parsed result may be cached in place of the input.
+ * \param reader - The reader.
+ * \return FALSE if the input was malformed or if a value came from a shell function call.
+ */
+Bool Reader_isCacheable(Reader reader);
+
 /*!
  * \brief Get the current token.
  *
@@ -94,7 +94,24 @@ typedef enum
 } VarType;
 
 /*! \brief Position in an array. */
-typedef Uint16 VarArrayPos;
+typedef Uint32 VarArrayPos;
+
+/*!
+ * \brief Pre-hashed name of an array element.
+ *
+ * Initialize it with VAR_KEY, its hash is computed on first use.
+ */
+typedef struct
+{
+    const char* name;       /*!< Element name */
+    Uint32 hash;            /*!< Name hash, 0 if not computed yet */
+} VarKey;
+
+/******************************************************************************
+ *                                   Macros                                   *
+ ******************************************************************************/
+/*! \brief Static initializer of a VarKey. */
+#define VAR_KEY(_name_) {_name_, 0}
 
 /******************************************************************************
  *############################################################################*
@@ -320,6 +337,8 @@ void Var_removeUnnamedFields(Var var);
 /*!
  * \brief Get an array's element, given its name.
  *
+ * Named lookups use a hash table kept up to date when the array is modified,
+ * a lookup never writes in the array, so it can be shared between threads.
  * No type check is performed.
  * \param var - The array variable.
  * \param name - Name to search for.
@@ -337,6 +356,16 @@ Var Var_getArrayElemByName(Var var, String name);
  */
 Var Var_getArrayElemByCName(Var var, char* name);
 
+/*!
+ * \brief Get an array's element, given a pre-hashed name.
+ *
+ * No type check is performed.
+ * \param var - The array variable.
+ * \param key - Name to search for, its hash is stored on first use.
+ * \return Found array element, NULL if not found.
+ */
+Var Var_getArrayElemByKey(Var var, VarKey* key);
+
 /*!
  * \brief Get an array's size.
  *
@@ -36,6 +36,7 @@
 #include "game/internal/player.h"
 #include "game/internal/piece.h"
 #include "game/internal/register.h"
+#include "game/internal/droprules.h"
 
 #include "gui/guitexture.h"
 
@@ -66,7 +67,8 @@ static PtrArray _players;
 static PtrArray _pieces;
 static Piece _piece_sel;
 #define RANGE_PART_NB 10
-static Particle _piece_range_part[RANGE_PART_NB];
+static ParticleSystem _piece_range_part;
+static ParticleID _piece_range_ids[RANGE_PART_NB];
 static float _piece_range_progr;
 static float _piece_range_effect;
 
@@ -112,14 +114,14 @@ selectPiece(Piece piece)
         GlRect_MAKE(_selection_framerect, -1, -1, 1, 1);
     }
 
-    for (i = 0; i < RANGE_PART_NB; i++)
+    ParticleSystem_show(_piece_range_part, (piece != NULL) && (Piece_getEntity(piece)->rangedist > 0.0f));
+    if (piece != NULL)
     {
-        Particle_show(_piece_range_part[i], (piece != NULL) && (Piece_getEntity(piece)->rangedist > 0.0f));
-        if (piece != NULL)
+        ent = Piece_getEntity(piece);
+        Piece_getPos(piece, &x, &y, &z);
+        for (i = 0; i < RANGE_PART_NB; i++)
         {
-            ent = Piece_getEntity(piece);
-            Piece_getPos(piece, &x, &y, &z);
-            Particle_setPos(_piece_range_part[i], x + (Gl3DCoord)ent->width / 2.0, y + 0.5, z + (Gl3DCoord)ent->height / 2.0);
+            ParticleSystem_setPos(_piece_range_part, _piece_range_ids[i], x + (Gl3DCoord)ent->width / 2.0, y + 0.5, z + (Gl3DCoord)ent->height / 2.0);
         }
     }
     _piece_range_effect = 0.0f;
@@ -201,21 +203,19 @@ gleventCallback(GlExtID data, GlEvent* event)
             {
                 if (!registerIsOutbound(event->event.selectionevent.groundx, event->event.selectionevent.groundy))
                 {
-                    RegisterResult* res;
+                    RegisterIterator it;
                     RegisterResult* i;
                     
                     /*TODO: cycling selection*/                
-                    i = res = registerQuery(event->event.selectionevent.groundx, event->event.selectionevent.groundy, NULL, NULL, REGISTER_PRESENCE);
-                    while (i->piece != NULL)
+                    registerQueryBegin(&it, event->event.selectionevent.groundx, event->event.selectionevent.groundy, NULL, NULL, REGISTER_PRESENCE);
+                    while ((i = registerQueryNext(&it)) != NULL)
                     {
                         if (Piece_getEntity(i->piece)->selectable)
                         {
                             break;
                         }
-                        i++;
                     }
-                    selectPiece(i->piece);  /*either NULL for deselect or the piece to select*/
-                    FREE(res);
+                    selectPiece((i == NULL) ? NULL : i->piece);  /*either NULL for deselect or the piece to select*/
                 }
             }
         }
@@ -300,12 +300,9 @@ datasCallback(Var datas)
     }
     
     GuiTexture_set(_selection_frametex, Var_getArrayElemByCName(datas, "particle_select_tex"));
-    for (i = 0; i < RANGE_PART_NB; i++)
-    {
-        Particle_setTex(_piece_range_part[i], Var_getValueString(Var_getArrayElemByCName(datas, "particle_range_tex")));
-        Particle_setSize(_piece_range_part[i], 1.0, 1.0);
-        Particle_show(_piece_range_part[i], FALSE);
-    }
+    ParticleSystem_setTex(_piece_range_part, Var_getValueString(Var_getArrayElemByCName(datas, "particle_range_tex")));
+    ParticleSystem_setSize(_piece_range_part, 1.0, 1.0);
+    ParticleSystem_show(_piece_range_part, FALSE);
 
     _sound_entity_select = soundGetSample(Var_getValueString(Var_getArrayElemByCName(datas, "sound_entity_select")));
     _sound_entity_drop = soundGetSample(Var_getValueString(Var_getArrayElemByCName(datas, "sound_entity_drop")));
@@ -342,9 +339,9 @@ threadCallback(CoreID thread, CoreTime duration)
             Piece_getPos(_piece_sel, &x, &y, &z);
             for (i = 0; i < RANGE_PART_NB; i++)
             {
-                Particle_setPos(_piece_range_part[i], x + ((Gl3DCoord)e->width / 2.0) + e->rangedist * _piece_range_effect * cos(e->rangeangle * (_piece_range_progr + (float)i / RANGE_PART_NB))
-                                                    , y + 0.5
-                                                    , z + ((Gl3DCoord)e->height / 2.0) + e->rangedist * _piece_range_effect * sin(e->rangeangle * (_piece_range_progr + (float)i / RANGE_PART_NB)));
+                ParticleSystem_setPos(_piece_range_part, _piece_range_ids[i], x + ((Gl3DCoord)e->width / 2.0) + e->rangedist * _piece_range_effect * cos(e->rangeangle * (_piece_range_progr + (float)i / RANGE_PART_NB))
+                                                          , y + 0.5
+                                                          , z + ((Gl3DCoord)e->height / 2.0) + e->rangedist * _piece_range_effect * sin(e->rangeangle * (_piece_range_progr + (float)i / RANGE_PART_NB)));
             }
         }
     }
@@ -413,6 +410,7 @@ gameInit()
     int i;
     
     registerInit();
+    dropRulesInit();
     gameCameraInit();
     
     /*entities*/
@@ -426,9 +424,10 @@ gameInit()
     /*pieces*/
     _pieces = PtrArray_newFull(50, 50, (PtrFunc)Piece_del, NULL);
     _piece_sel = NULL;
+    _piece_range_part = ParticleSystem_new(RANGE_PART_NB);
     for (i = 0; i < RANGE_PART_NB; i++)
     {
-        _piece_range_part[i] = Particle_new();
+        _piece_range_ids[i] = ParticleSystem_emit(_piece_range_part, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0);
     }
     _piece_range_progr = 0.0f;
     _piece_range_effect = 0.0;
@@ -450,7 +449,7 @@ gameInit()
     RES_ENTITIES_AVAILABLE = coreCreateResource(MOD_ID, "entities_available", VAR_ARRAY, FALSE);
     RES_ENTITY_SELECTED = coreCreateResource(MOD_ID, "entity_selected", VAR_INT, TRUE);
     coreAddResourceWatcher(MOD_ID, "entity_selected");
-    coreRequireThreadSlot(MOD_ID, coreGetThreadID(NULL));
+    coreRequireIndependentThreadSlot(MOD_ID, coreGetThreadID(NULL));
 }
 
 /*----------------------------------------------------------------------------*/
@@ -464,10 +463,7 @@ gameUninit()
     Gl2DObject_del(_selection_frame);
     GuiTexture_del(_selection_frametex);
     GlSurface_del(_selection_framesurf);
-    for (i = 0; i < RANGE_PART_NB; i++)
-    {
-        Particle_del(_piece_range_part[i]);
-    }
+    ParticleSystem_del(_piece_range_part);
     
     /*delete players*/
     PtrArray_del(_players);
@@ -483,6 +479,7 @@ gameUninit()
     }
     
     gameCameraUninit();
+    dropRulesUninit();
     registerUninit();
     
     shellPrint(LEVEL_INFO, "Game engine destroyed.");
@@ -498,6 +495,7 @@ gameNew()
     selectPiece(NULL);
     PtrArray_clear(_players);
     registerClear();
+    memTrim();
     
     shellPrint(LEVEL_INFO, "New game initialized. Waiting for players.");
 }
@@ -35,6 +35,7 @@
 #include "core/string.h"
 #include "tools/varvalidator.h"
 #include "world/ground.h"
+#include "tools/fonct.h"
 
 /******************************************************************************
  *                                  Typedefs                                  *
@@ -46,8 +47,28 @@ struct pv_DropRules
     Bool groundconnexity;       /* Ground connexity required. */
     Entity** ground_entities;   /* Entities that can play the role of ground. */
     Entity** allowed_entities;  /* Entities explicitly allowed at the same location. */
+    
+    DropRules next;             /* Next rules in the list of all rules. */
+    WorldCoord mapw;            /* Width of the validity map. */
+    WorldCoord maph;            /* Height of the validity map. */
+    Uint32* known;              /* Tiles whose validity is known, one bit per tile. */
+    Uint32* valid;              /* Tiles where dropping is allowed, one bit per tile. */
 };
 
+/******************************************************************************
+ *                                   Macros                                   *
+ ******************************************************************************/
+/*Bit operations on validity maps*/
+#define MAP_WORDS(_w_, _h_) (((Uint32)(_w_) * (_h_) + 31) / 32)
+#define MAP_GET(_map_, _i_) (((_map_)[(_i_) >> 5] >> ((_i_) & 31)) & 1)
+#define MAP_SET(_map_, _i_) ((_map_)[(_i_) >> 5] |= (1u << ((_i_) & 31)))
+#define MAP_UNSET(_map_, _i_) ((_map_)[(_i_) >> 5] &= ~(1u << ((_i_) & 31)))
+
+/******************************************************************************
+ *                              Static variables                              *
+ ******************************************************************************/
+static DropRules _rules = NULL;
+
 /******************************************************************************
  *############################################################################*
  *#                            Private functions                             #*
@@ -59,7 +80,7 @@ struct pv_DropRules
 static Entity**
 createEntityList(Var vlist)
 {
-    int i, j;
+    VarArrayPos i, j;
     Entity** ret;
     Var vent;
     Entity* ent;
@@ -109,76 +130,30 @@ searchEntityList(Entity** list, Entity* entity)
 /*----------------------------------------------------------------------------*/
 /*check if at least on entity of the list if in the register results*/
 static Bool
-matchOne(Entity** list, RegisterResult* res)
+matchOne(Entity** list, WorldCoord x, WorldCoord y)
 {
-    while (res->piece != NULL)
+    RegisterIterator it;
+    RegisterResult* res;
+    
+    registerQueryBegin(&it, x, y, NULL, NULL, REGISTER_PRESENCE);
+    while ((res = registerQueryNext(&it)) != NULL)
     {
         if (searchEntityList(list, Piece_getEntity(res->piece)))
         {
             /*one match found*/
             return TRUE;
         }
-        res++;
     }
     return FALSE;
 }
 
-/******************************************************************************
- *############################################################################*
- *#                             Public functions                             #*
- *############################################################################*
- ******************************************************************************/
-DropRules
-DropRules_new(Var v)
-{
-    DropRules ret;
-    VarValidator valid;
-    
-    shellPrint(LEVEL_ERRORSTACK, "For drop rules.");
-    
-    ret = MALLOC(sizeof(pv_DropRules));
-    
-    valid = VarValidator_new();
-    VarValidator_declareIntVar(valid, "needground", 0);
-    VarValidator_declareIntVar(valid, "denyground", 0);
-    VarValidator_declareIntVar(valid, "groundconnex", 0);
-    VarValidator_declareArrayVar(valid, "ground_entities");
-    VarValidator_declareArrayVar(valid, "allowed_entities");
-    VarValidator_validate(valid, v);
-    VarValidator_del(valid);
-    
-    ret->needground = ((Var_getValueInt(Var_getArrayElemByCName(v, "needground")) == 0) ? FALSE : TRUE);
-    ret->denyground = ((Var_getValueInt(Var_getArrayElemByCName(v, "denyground")) == 0) ? FALSE : TRUE);
-    ret->groundconnexity = ((Var_getValueInt(Var_getArrayElemByCName(v, "groundconnex")) == 0) ? FALSE : TRUE);
-    ret->ground_entities = createEntityList(Var_getArrayElemByCName(v, "ground_entities"));
-    ret->allowed_entities = createEntityList(Var_getArrayElemByCName(v, "allowed_entities"));
-    
-    shellPopErrorStack();
-    
-    return ret;
-}
-
 /*----------------------------------------------------------------------------*/
-void
-DropRules_del(DropRules rules)
-{
-    FREE(rules->allowed_entities);
-    FREE(rules->ground_entities);
-    FREE(rules);
-}
-
-/*----------------------------------------------------------------------------*/
-Bool
-DropRules_check(DropRules rules, WorldCoord posx, WorldCoord posy)
+/*apply the rules on a tile, without cache*/
+static Bool
+checkTile(DropRules rules, WorldCoord posx, WorldCoord posy)
 {
+    RegisterIterator it;
     RegisterResult* regi;
-    RegisterResult* reg_pres;
-    
-    /*check if it can be registered*/
-    if (registerIsOutbound(posx, posy))
-    {
-        return FALSE;
-    }
     
     /*check denyground*/
     if (rules->denyground)
@@ -189,8 +164,6 @@ DropRules_check(DropRules rules, WorldCoord posx, WorldCoord posy)
         }
     }
     
-    reg_pres = registerQuery(posx, posy, NULL, NULL, REGISTER_PRESENCE);
-    
     /*check needground*/
     if (rules->needground)
     {
@@ -198,25 +171,22 @@ DropRules_check(DropRules rules, WorldCoord posx, WorldCoord posy)
         {
             /*there is no ground under*/
             /*check if there is an entity that can play the role of ground*/
-            if (!matchOne(rules->ground_entities, reg_pres))
+            if (!matchOne(rules->ground_entities, posx, posy))
             {
-                FREE(reg_pres);
                 return FALSE;
             }
         }
     }
     
     /*check allowed entities*/
-    regi = reg_pres;
-    while (regi->piece != NULL)
+    registerQueryBegin(&it, posx, posy, NULL, NULL, REGISTER_PRESENCE);
+    while ((regi = registerQueryNext(&it)) != NULL)
     {
         if (!searchEntityList(rules->allowed_entities, Piece_getEntity(regi->piece)))
         {
             /*an unallowed entity was found*/
-            FREE(reg_pres);
             return FALSE;
         }
-        regi++;
     }
     
     /*check ground connexity*/
@@ -230,16 +200,9 @@ DropRules_check(DropRules rules, WorldCoord posx, WorldCoord posy)
             {
                 pass = TRUE;
             }
-            else
+            else if (matchOne(rules->ground_entities, posx - 1, posy))
             {
-                RegisterResult* r;
-                
-                r = registerQuery(posx - 1, posy, NULL, NULL, REGISTER_PRESENCE);
-                if (matchOne(rules->ground_entities, r))
-                {
-                    pass = TRUE;
-                }
-                FREE(r);
+                pass = TRUE;
             }
         }
         if ((!pass) && (!registerIsOutbound(posx + 1, posy)))
@@ -248,16 +211,9 @@ DropRules_check(DropRules rules, WorldCoord posx, WorldCoord posy)
             {
                 pass = TRUE;
             }
-            else
+            else if (matchOne(rules->ground_entities, posx + 1, posy))
             {
-                RegisterResult* r;
-                
-                r = registerQuery(posx + 1, posy, NULL, NULL, REGISTER_PRESENCE);
-                if (matchOne(rules->ground_entities, r))
-                {
-                    pass = TRUE;
-                }
-                FREE(r);
+                pass = TRUE;
             }
         }
         if ((!pass) && (!registerIsOutbound(posx, posy - 1)))
@@ -266,16 +222,9 @@ DropRules_check(DropRules rules, WorldCoord posx, WorldCoord posy)
             {
                 pass = TRUE;
             }
-            else
+            else if (matchOne(rules->ground_entities, posx, posy - 1))
             {
-                RegisterResult* r;
-                
-                r = registerQuery(posx, posy - 1, NULL, NULL, REGISTER_PRESENCE);
-                if (matchOne(rules->ground_entities, r))
-                {
-                    pass = TRUE;
-                }
-                FREE(r);
+                pass = TRUE;
             }
         }
         if ((!pass) && (!registerIsOutbound(posx, posy + 1)))
@@ -284,27 +233,214 @@ DropRules_check(DropRules rules, WorldCoord posx, WorldCoord posy)
             {
                 pass = TRUE;
             }
-            else
+            else if (matchOne(rules->ground_entities, posx, posy + 1))
             {
-                RegisterResult* r;
-                
-                r = registerQuery(posx, posy + 1, NULL, NULL, REGISTER_PRESENCE);
-                if (matchOne(rules->ground_entities, r))
-                {
-                    pass = TRUE;
-                }
-                FREE(r);
+                pass = TRUE;
             }
         }
         
         if (!pass)
         {
-            FREE(reg_pres);
             return FALSE;
         }
     }
     
     /*all checks passed*/
-    FREE(reg_pres);
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------------*/
+/*adjust the validity map to the register size*/
+static void
+adjustMap(DropRules rules)
+{
+    WorldCoord w, h;
+    Uint32 i;
+    
+    registerGetSize(&w, &h);
+    if ((rules->known != NULL) && (rules->mapw == w) && (rules->maph == h))
+    {
+        return;
+    }
+    
+    if (rules->known != NULL)
+    {
+        FREE(rules->known);
+        FREE(rules->valid);
+    }
+    rules->mapw = w;
+    rules->maph = h;
+    rules->known = MALLOC(sizeof(Uint32) * MAP_WORDS(w, h));
+    rules->valid = MALLOC(sizeof(Uint32) * MAP_WORDS(w, h));
+    for (i = 0; i < MAP_WORDS(w, h); i++)
+    {
+        rules->known[i] = 0;
+        rules->valid[i] = 0;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+groundWatcher(GroundCoord x, GroundCoord y, GroundCoord w, GroundCoord h)
+{
+    dropRulesInvalidate(x, y, w, h);
+}
+
+/******************************************************************************
+ *############################################################################*
+ *#                             Public functions                             #*
+ *############################################################################*
+ ******************************************************************************/
+void
+dropRulesInit()
+{
+    _rules = NULL;
+    groundSetWatcher(groundWatcher);
+}
+
+/*----------------------------------------------------------------------------*/
+void
+dropRulesUninit()
+{
+    groundSetWatcher(NULL);
+}
+
+/*----------------------------------------------------------------------------*/
+void
+dropRulesInvalidate(WorldCoord x, WorldCoord y, WorldCoord w, WorldCoord h)
+{
+    DropRules rules;
+    int x1, y1, x2, y2, i, j;
+    
+    for (rules = _rules; rules != NULL; rules = rules->next)
+    {
+        if (rules->known == NULL)
+        {
+            continue;
+        }
+        
+        /*the neighbours are affected by ground connexity*/
+        x1 = MAX((int)x - 1, 0);
+        y1 = MAX((int)y - 1, 0);
+        x2 = MIN((int)x + w, (int)rules->mapw - 1);
+        y2 = MIN((int)y + h, (int)rules->maph - 1);
+        for (j = y1; j <= y2; j++)
+        {
+            for (i = x1; i <= x2; i++)
+            {
+                MAP_UNSET(rules->known, (Uint32)j * rules->mapw + i);
+            }
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+DropRules
+DropRules_new(Var v)
+{
+    DropRules ret;
+    VarValidator valid;
+    
+    shellPrint(LEVEL_ERRORSTACK, "For drop rules.");
+    
+    ret = MALLOC(sizeof(pv_DropRules));
+    
+    valid = VarValidator_new();
+    VarValidator_declareIntVar(valid, "needground", 0);
+    VarValidator_declareIntVar(valid, "denyground", 0);
+    VarValidator_declareIntVar(valid, "groundconnex", 0);
+    VarValidator_declareArrayVar(valid, "ground_entities");
+    VarValidator_declareArrayVar(valid, "allowed_entities");
+    VarValidator_validate(valid, v);
+    VarValidator_del(valid);
+    
+    ret->needground = ((Var_getValueInt(Var_getArrayElemByCName(v, "needground")) == 0) ? FALSE : TRUE);
+    ret->denyground = ((Var_getValueInt(Var_getArrayElemByCName(v, "denyground")) == 0) ? FALSE : TRUE);
+    ret->groundconnexity = ((Var_getValueInt(Var_getArrayElemByCName(v, "groundconnex")) == 0) ? FALSE : TRUE);
+    ret->ground_entities = createEntityList(Var_getArrayElemByCName(v, "ground_entities"));
+    ret->allowed_entities = createEntityList(Var_getArrayElemByCName(v, "allowed_entities"));
+    
+    ret->mapw = 0;
+    ret->maph = 0;
+    ret->known = NULL;
+    ret->valid = NULL;
+    ret->next = _rules;
+    _rules = ret;
+    
+    shellPopErrorStack();
+    
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+DropRules_del(DropRules rules)
+{
+    DropRules* prev;
+    
+    for (prev = &_rules; *prev != rules; prev = &(*prev)->next)
+    {
+        ASSERT(*prev != NULL, break);
+    }
+    if (*prev == rules)
+    {
+        *prev = rules->next;
+    }
+    
+    if (rules->known != NULL)
+    {
+        FREE(rules->known);
+        FREE(rules->valid);
+    }
+    FREE(rules->allowed_entities);
+    FREE(rules->ground_entities);
+    FREE(rules);
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+DropRules_check(DropRules rules, WorldCoord posx, WorldCoord posy)
+{
+    Uint32 i;
+    
+    /*check if it can be registered*/
+    if (registerIsOutbound(posx, posy))
+    {
+        return FALSE;
+    }
+    
+    adjustMap(rules);
+    i = (Uint32)posy * rules->mapw + posx;
+    if (!MAP_GET(rules->known, i))
+    {
+        if (checkTile(rules, posx, posy))
+        {
+            MAP_SET(rules->valid, i);
+        }
+        else
+        {
+            MAP_UNSET(rules->valid, i);
+        }
+        MAP_SET(rules->known, i);
+    }
+    return MAP_GET(rules->valid, i);
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+DropRules_checkArea(DropRules rules, WorldCoord posx, WorldCoord posy, WorldCoord w, WorldCoord h)
+{
+    WorldCoord x, y;
+    
+    for (y = 0; y < MAX(h, 1); y++)
+    {
+        for (x = 0; x < MAX(w, 1); x++)
+        {
+            if (!DropRules_check(rules, posx + x, posy + y))
+            {
+                return FALSE;
+            }
+        }
+    }
     return TRUE;
 }
@@ -52,6 +52,33 @@ typedef struct pv_DropRules pv_DropRules;
  */
 typedef pv_DropRules* DropRules;
 
+/******************************************************************************
+ *############################################################################*
+ *#                             Module functions                             #*
+ *############################################################################*
+ ******************************************************************************/
+/*!
+ * \brief Initialize the drop rules module.
+ */
+void        dropRulesInit(void);
+
+/*!
+ * \brief Destroy the drop rules module.
+ */
+void        dropRulesUninit(void);
+
+/*!
+ * \brief Forget the cached drop validity around an area.
+ *
+ * This must be called when something the rules depend on changes in the area.
+ * The area borders are also invalidated because of ground connexity.
+ * \param x - X position of the area.
+ * \param y - Y position of the area.
+ * \param w - Width of the area.
+ * \param h - Height of the area.
+ */
+void        dropRulesInvalidate(WorldCoord x, WorldCoord y, WorldCoord w, WorldCoord h);
+
 /******************************************************************************
  *############################################################################*
  *#                            DropRules functions                           #*
@@ -75,6 +102,7 @@ void        DropRules_del(DropRules rules);
 /*!
  * \brief Check drop rules to know if a dropping is allowed, given certain conditions.
  *
+ * Results are cached per tile until \ref dropRulesInvalidate is called.
  * \param rules - The rules to apply.
  * \param posx - X dropping position.
  * \param posy - Y dropping position.
@@ -82,4 +110,16 @@ void        DropRules_del(DropRules rules);
  */
 Bool        DropRules_check(DropRules rules, WorldCoord posx, WorldCoord posy);
 
+/*!
+ * \brief Check drop rules on all tiles covered by a piece.
+ *
+ * \param rules - The rules to apply.
+ * \param posx - X dropping position.
+ * \param posy - Y dropping position.
+ * \param w - Width of the piece, in tiles.
+ * \param h - Height of the piece, in tiles.
+ * \return TRUE if the dropping is allowed on every tile, FALSE if it is denied.
+ */
+Bool        DropRules_checkArea(DropRules rules, WorldCoord posx, WorldCoord posy, WorldCoord w, WorldCoord h);
+
 #endif
@@ -94,6 +94,17 @@ adjustEntities(Player player)
     gameUpdateEntitiesAvailable(player->entities_nb, player->entities);
 }
 
+/*----------------------------------------------------------------------------*/
+/*check the drop rules of the selected entity on all the tiles it covers*/
+static Bool
+checkDrop(Player player, WorldCoord x, WorldCoord y)
+{
+    Entity* entity;
+    
+    entity = player->entities[player->p.local.creation_entity_nb];
+    return DropRules_checkArea(entity->droprules, x, y, entity->width, entity->height);
+}
+
 /******************************************************************************
  *############################################################################*
  *#                             Public functions                             #*
@@ -162,7 +173,7 @@ Player_processSelectionEvent(Player player, GlEvent* event)
         /*check against dropping rules for ghost mode*/
         if (player->p.local.creation_entity_nb >= 0)
         {
-            if (DropRules_check(player->entities[player->p.local.creation_entity_nb]->droprules, event->event.selectionevent.groundx, event->event.selectionevent.groundy))
+            if (checkDrop(player, event->event.selectionevent.groundx, event->event.selectionevent.groundy))
             {
                 /*TODO: read this color from mod files*/
                 GlColorRGBA_MAKE(col, 0x00, 0xFF, 0x00, 0xA0);
@@ -186,7 +197,7 @@ Player_processSelectionEvent(Player player, GlEvent* event)
      && (player->p.local.creation_entity_nb >= 0))
     {
         /*check against dropping rules*/
-        if (DropRules_check(player->entities[player->p.local.creation_entity_nb]->droprules, event->event.selectionevent.groundx, event->event.selectionevent.groundy))
+        if (checkDrop(player, event->event.selectionevent.groundx, event->event.selectionevent.groundy))
         {
             /*we assume another object can't be dropped in the same place*/
             GlColorRGBA_MAKE(col, 0xFF, 0x60, 0x60, 0xA0);
@@ -30,14 +30,37 @@
 #include "game/internal/register.h"
 
 #include "core/core.h"
+#include "game/internal/droprules.h"
+
+/******************************************************************************
+ *                                   Macros                                   *
+ ******************************************************************************/
+/*Number of results in a block*/
+#define REGISTER_BLOCKSIZE 4
+
+/*Number of blocks allocated at once in the pool*/
+#define REGISTER_SLABSIZE 256
 
 /******************************************************************************
  *                                  Typedefs                                  *
  ******************************************************************************/
+struct pv_RegisterBlock
+{
+    RegisterResult results[REGISTER_BLOCKSIZE];
+    pv_RegisterBlock* next;     /*Overflow block, or next free block in the pool*/
+};
+
+typedef struct pv_RegisterSlab pv_RegisterSlab;
+struct pv_RegisterSlab
+{
+    pv_RegisterBlock blocks[REGISTER_SLABSIZE];
+    pv_RegisterSlab* next;
+};
+
 typedef struct
 {
-    Uint16 size;            /*Number of flags registered*/
-    RegisterResult* data;   /*Registered flags*/
+    Uint16 size;                /*Number of flags registered*/
+    pv_RegisterBlock* first;    /*Registered flags, densely packed in chained blocks*/
 } RegisterArea;
 
 /******************************************************************************
@@ -47,6 +70,10 @@ static WorldCoord _world_w;
 static WorldCoord _world_h;
 static RegisterArea* _register;
 
+/*Blocks pool*/
+static pv_RegisterSlab* _slabs;
+static pv_RegisterBlock* _free_blocks;
+
 static CoreID MOD_ID = CORE_INVALID_ID;
 static CoreID RES_WORLD_WIDTH = CORE_INVALID_ID;
 static CoreID RES_WORLD_HEIGHT = CORE_INVALID_ID;
@@ -56,33 +83,106 @@ static CoreID RES_WORLD_HEIGHT = CORE_INVALID_ID;
  *#                            Private functions                             #*
  *############################################################################*
  ******************************************************************************/
-static void
-registerSetSize(WorldCoord w, WorldCoord h)
+static pv_RegisterBlock*
+allocBlock()
 {
-    Uint16 x, y;
+    pv_RegisterSlab* slab;
+    pv_RegisterBlock* ret;
+    int i;
     
-    for (x = 0; x < _world_w; x++)
+    if (_free_blocks == NULL)
     {
-        for (y = 0; y < _world_h; y++)
+        /*grow the pool by a whole slab*/
+        slab = MALLOC(sizeof(pv_RegisterSlab));
+        slab->next = _slabs;
+        _slabs = slab;
+        for (i = 0; i < REGISTER_SLABSIZE; i++)
         {
-            FREE(_register[y * _world_w + x].data);
+            slab->blocks[i].next = _free_blocks;
+            _free_blocks = slab->blocks + i;
         }
     }
-    FREE(_register);
-    _world_w = w;
-    _world_h = h;
-    _register = MALLOC(sizeof(RegisterArea) * w * h);
-    for (x = 0; x < _world_w; x++)
+    
+    ret = _free_blocks;
+    _free_blocks = ret->next;
+    ret->next = NULL;
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+freeBlock(pv_RegisterBlock* block)
+{
+    block->next = _free_blocks;
+    _free_blocks = block;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Give back all blocks to the pool, slabs are released if asked*/
+static void
+resetPool(Bool release)
+{
+    pv_RegisterSlab* slab;
+    pv_RegisterSlab* next;
+    int i;
+    
+    _free_blocks = NULL;
+    for (slab = _slabs; slab != NULL; slab = next)
     {
-        for (y = 0; y < _world_h; y++)
+        next = slab->next;
+        if (release)
         {
-            _register[y * _world_w + x].size = 0;
-            _register[y * _world_w + x].data = MALLOC(sizeof(RegisterResult));
-            _register[y * _world_w + x].data[0].piece = NULL;
+            FREE(slab);
         }
+        else
+        {
+            for (i = 0; i < REGISTER_SLABSIZE; i++)
+            {
+                slab->blocks[i].next = _free_blocks;
+                _free_blocks = slab->blocks + i;
+            }
+        }
+    }
+    if (release)
+    {
+        _slabs = NULL;
     }
 }
 
+/*----------------------------------------------------------------------------*/
+static void
+registerSetSize(WorldCoord w, WorldCoord h)
+{
+    Uint32 i;
+    
+    if ((w != _world_w) || (h != _world_h))
+    {
+        FREE(_register);
+        _world_w = w;
+        _world_h = h;
+        _register = MALLOC(sizeof(RegisterArea) * w * h);
+    }
+    
+    /*all blocks are given back to the pool at once*/
+    for (i = 0; i < (Uint32)_world_w * _world_h; i++)
+    {
+        _register[i].size = 0;
+        _register[i].first = NULL;
+    }
+    resetPool(FALSE);
+    
+    dropRulesInvalidate(0, 0, _world_w, _world_h);
+}
+
+/*----------------------------------------------------------------------------*/
+static Bool
+matchQuery(RegisterResult* res, Piece piece, Entity* entity, RegisterFlag flag)
+{
+    return (((piece == NULL) || (res->piece == piece))
+         && ((entity == NULL) || (Piece_getEntity(res->piece) == entity))
+         && ((flag == REGISTER_NONE) || (res->flag == flag)));
+}
+
 /*----------------------------------------------------------------------------*/
 static void
 resourceCallback(CoreID id, Var value)
@@ -111,9 +211,10 @@ registerInit()
 {
     _world_w = _world_h = 1;
     _register = MALLOC(sizeof(RegisterArea));
-    _register[0].data = MALLOC(sizeof(RegisterResult));
     _register[0].size = 0;
-    _register[0].data[0].piece = NULL;
+    _register[0].first = NULL;
+    _slabs = NULL;
+    _free_blocks = NULL;
     
     MOD_ID = coreDeclareModule("register", NULL, NULL, NULL, NULL, resourceCallback, NULL);
     RES_WORLD_WIDTH = coreAddResourceWatcher(MOD_ID, "world_width");
@@ -124,9 +225,8 @@ registerInit()
 void
 registerUninit()
 {
-    registerSetSize(1, 1);
-    FREE(_register[0].data);
     FREE(_register);
+    resetPool(TRUE);
     
     shellPrint(LEVEL_INFO, "Game register unloaded.");
 }
@@ -150,12 +250,27 @@ registerSetFlag(WorldCoord x, WorldCoord y, Piece piece, RegisterFlag flag)
     {
         /*TODO: maybe check that this flag isn't already set.*/
         RegisterArea* reg;
+        pv_RegisterBlock** block;
+        Uint16 i;
         
         reg = _register + y * _world_w + x;
-        reg->data = REALLOC(reg->data, sizeof(RegisterResult) * (reg->size + 2));
-        reg->data[reg->size].piece = piece;
-        reg->data[reg->size].flag = flag;
-        reg->data[++reg->size].piece = NULL;
+        
+        /*find the last block, chaining a new one if it is full*/
+        block = &reg->first;
+        for (i = reg->size; i >= REGISTER_BLOCKSIZE; i -= REGISTER_BLOCKSIZE)
+        {
+            block = &(*block)->next;
+        }
+        if (i == 0)
+        {
+            *block = allocBlock();
+        }
+        
+        (*block)->results[i].piece = piece;
+        (*block)->results[i].flag = flag;
+        reg->size++;
+        
+        dropRulesInvalidate(x, y, 1, 1);
     }
 }
 
@@ -170,27 +285,42 @@ registerUnsetFlag(WorldCoord x, WorldCoord y, Piece piece, RegisterFlag flag)
     else
     {
         RegisterArea* reg;
-        RegisterResult* res;
+        pv_RegisterBlock** block;
+        RegisterResult* found;
+        Uint16 i;
         
         reg = _register + y * _world_w + x;
-        res = reg->data;
-        while (res->piece != NULL)
+        found = NULL;
+        block = &reg->first;
+        for (i = 0; i < reg->size; i++)
         {
-            if ((res->piece == piece) && (res->flag == flag))
+            if ((i > 0) && (i % REGISTER_BLOCKSIZE == 0))
+            {
+                block = &(*block)->next;
+            }
+            if ((found == NULL)
+             && ((*block)->results[i % REGISTER_BLOCKSIZE].piece == piece)
+             && ((*block)->results[i % REGISTER_BLOCKSIZE].flag == flag))
             {
-                /*Unset this flag*/
-                res->piece = reg->data[reg->size].piece;
-                res->flag = reg->data[reg->size].flag;
-                reg->data[reg->size--].piece = NULL;
-                
-                /*Don't need to realloc the data stack because we only use its
-                  NULL-terminated feature. Though realloc will happen on next registerSetFlag call*/
-                
-                return;
+                found = (*block)->results + (i % REGISTER_BLOCKSIZE);
             }
-            
-            res++;
         }
+        if (found == NULL)
+        {
+            return;
+        }
+        
+        /*Unset this flag by moving the last one in its place*/
+        reg->size--;
+        *found = (*block)->results[reg->size % REGISTER_BLOCKSIZE];
+        if (reg->size % REGISTER_BLOCKSIZE == 0)
+        {
+            /*the last block is now empty*/
+            freeBlock(*block);
+            *block = NULL;
+        }
+        
+        dropRulesInvalidate(x, y, 1, 1);
     }        
 }
 
@@ -202,100 +332,93 @@ registerIsOutbound(WorldCoord x, WorldCoord y)
 }
 
 /*----------------------------------------------------------------------------*/
-RegisterResult*
-registerQuery(WorldCoord x, WorldCoord y, Piece piece, Entity* entity, RegisterFlag flag)
+void
+registerGetSize(WorldCoord* w, WorldCoord* h)
 {
-    RegisterResult* ret;
-    
+    *w = _world_w;
+    *h = _world_h;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+registerQueryBegin(RegisterIterator* it, WorldCoord x, WorldCoord y, Piece piece, Entity* entity, RegisterFlag flag)
+{
+    it->pos = 0;
+    it->piece = piece;
+    it->entity = entity;
+    it->flag = flag;
     if ((x >= _world_w) | (y >= _world_h))
     {
-        /*return a void list*/
-        ret = MALLOC(sizeof(RegisterResult));
-        ret[0].piece = NULL;
+        /*empty results*/
+        it->block = NULL;
+        it->left = 0;
     }
-    else if ((piece == NULL) & (entity == NULL) & (flag == REGISTER_NONE))
+    else
     {
-        RegisterArea* reg;
-        
-        /*return a copy of the whole data stack*/
-        reg = _register + y * _world_w + x;
-        ret = MALLOC(sizeof(RegisterResult) * (reg->size + 1));
-        memCOPY(ret, reg->data, sizeof(RegisterResult) * (reg->size + 1));
+        it->block = _register[y * _world_w + x].first;
+        it->left = _register[y * _world_w + x].size;
     }
-    else
+}
+
+/*----------------------------------------------------------------------------*/
+RegisterResult*
+registerQueryNext(RegisterIterator* it)
+{
+    RegisterResult* res;
+    
+    while (it->left > 0)
     {
-        int size, asize;    /*results number and allocated size*/
-        RegisterArea* reg;
-        RegisterResult* res;
-        
-        /*return the results of a search*/
-        size = 0;
-        asize = 5;
-        ret = MALLOC(sizeof(RegisterResult) * asize);
-        ret->piece = NULL;
-        reg = _register + y * _world_w + x;
-        res = reg->data;
-        while (res->piece != NULL)
+        if (it->pos == REGISTER_BLOCKSIZE)
         {
-            if (((piece == NULL) || (res->piece == piece))
-             && ((entity == NULL) || (Piece_getEntity(res->piece) == entity))
-             && ((flag == REGISTER_NONE) || (res->flag == flag)))
-            {
-                /*matching criteria, adding result*/
-                if ((size + 1) == asize)
-                {
-                    /*need more room*/
-                    asize += 5;
-                    ret = REALLOC(ret, sizeof(RegisterResult) * asize);
-                }
-                ret[size + 1].piece = NULL;
-                ret[size++] = *res;
-            }
-            res++;
+            it->block = it->block->next;
+            it->pos = 0;
         }
-    }
-    
-    /***DEBUG***/
-    /*{
-        RegisterResult* i;
-        printf("***\n");
-        i = ret;
-        while (i->piece != NULL)
+        res = it->block->results + it->pos;
+        it->pos++;
+        it->left--;
+        if (matchQuery(res, it->piece, it->entity, it->flag))
         {
-            printf("%s\n", String_get(Piece_getEntity(i->piece)->name));
-            i++;
+            return res;
         }
-    }*/
-    /***DEBUG***/
-
-    return ret;
+    }
+    return NULL;
 }
 
 /*----------------------------------------------------------------------------*/
-Bool
-registerCheck(WorldCoord x, WorldCoord y, Piece piece, Entity* entity, RegisterFlag flag)
+RegisterResult*
+registerQuery(WorldCoord x, WorldCoord y, Piece piece, Entity* entity, RegisterFlag flag)
 {
-    if ((x >= _world_w) | (y >= _world_h))
+    RegisterIterator it;
+    RegisterResult* ret;
+    RegisterResult* res;
+    int size;
+    
+    /*count the results to allocate the list once*/
+    size = 0;
+    registerQueryBegin(&it, x, y, piece, entity, flag);
+    while (registerQueryNext(&it) != NULL)
     {
-        return FALSE;
+        size++;
     }
-    else
+    
+    ret = MALLOC(sizeof(RegisterResult) * (size + 1));
+    size = 0;
+    registerQueryBegin(&it, x, y, piece, entity, flag);
+    while ((res = registerQueryNext(&it)) != NULL)
     {
-        RegisterArea* reg;
-        RegisterResult* res;
-
-        reg = _register + y * _world_w + x;
-        res = reg->data;
-        while (res->piece != NULL)
-        {
-            if (((piece == NULL) || (res->piece == piece))
-             && ((entity == NULL) || (Piece_getEntity(res->piece) == entity))
-             && ((flag == REGISTER_NONE) || (res->flag == flag)))
-            {
-                return TRUE;
-            }
-            res++;
-        }
-        return FALSE;
+        ret[size++] = *res;
     }
+    ret[size].piece = NULL;
+    
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+registerCheck(WorldCoord x, WorldCoord y, Piece piece, Entity* entity, RegisterFlag flag)
+{
+    RegisterIterator it;
+    
+    registerQueryBegin(&it, x, y, piece, entity, flag);
+    return (registerQueryNext(&it) != NULL);
 }
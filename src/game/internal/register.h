@@ -64,6 +64,24 @@ typedef struct
     RegisterFlag flag;      /*!< The flag. */
 } RegisterResult;
 
+/*! \brief Block of results stored in the register (private). */
+typedef struct pv_RegisterBlock pv_RegisterBlock;
+
+/*!
+ * \brief Iterator over the results of a query.
+ *
+ * It is meant to be allocated on the stack, see \ref registerQueryBegin.
+ */
+typedef struct
+{
+    pv_RegisterBlock* block;    /*!< Current block. */
+    Uint16 pos;                 /*!< Position in the current block. */
+    Uint16 left;                /*!< Number of results left to look at. */
+    Piece piece;                /*!< Piece criterion. */
+    Entity* entity;             /*!< Entity criterion. */
+    RegisterFlag flag;          /*!< Flag criterion. */
+} RegisterIterator;
+
 /******************************************************************************
  *############################################################################*
  *#                            Register functions                            #*
@@ -116,6 +134,14 @@ void registerUnsetFlag(WorldCoord x, WorldCoord y, Piece piece, RegisterFlag fla
  */
 Bool registerIsOutbound(WorldCoord x, WorldCoord y);
 
+/*!
+ * \brief Get the size of the register.
+ *
+ * \param w - Returned width.
+ * \param h - Returned height.
+ */
+void registerGetSize(WorldCoord* w, WorldCoord* h);
+
 /*!
  * \brief Perform a query in the game register.
  *
@@ -129,6 +155,28 @@ Bool registerIsOutbound(WorldCoord x, WorldCoord y);
  */
 RegisterResult* registerQuery(WorldCoord x, WorldCoord y, Piece piece, Entity* entity, RegisterFlag flag);
 
+/*!
+ * \brief Start a query in the game register, without allocation.
+ *
+ * Results are then given by \ref registerQueryNext. The register must not be
+ * modified while iterating.
+ * \param it - The iterator to initialize.
+ * \param x - X coordinate to query.
+ * \param y - Y coordinate to query.
+ * \param piece - Piece criterion, NULL if not.
+ * \param entity - Entity criterion, NULL if not.
+ * \param flag - Flag criterion, REGISTER_NONE if not.
+ */
+void registerQueryBegin(RegisterIterator* it, WorldCoord x, WorldCoord y, Piece piece, Entity* entity, RegisterFlag flag);
+
+/*!
+ * \brief Get the next result of a query.
+ *
+ * \param it - The iterator initialized by \ref registerQueryBegin.
+ * \return The next result that matches the query, NULL if there is no more.
+ */
+RegisterResult* registerQueryNext(RegisterIterator* it);
+
 /*!
  * \brief Perform a check in the game register.
  *
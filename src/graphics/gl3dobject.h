@@ -146,6 +146,22 @@ void Gl3DObject_setPos(Gl3DObject obj, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z, Co
  */
 void Gl3DObject_setAngle(Gl3DObject obj, Gl3DCoord angh, Gl3DCoord angv, CoreTime duration);
 
+/*!
+ * \brief Immediately place a set of objects.
+ *
+ * This is equivalent to calling Gl3DObject_setPos and Gl3DObject_setAngle without duration
+ * for each object, but is meant for systems moving many objects at each step.
+ * Coordinates are given as separate vectors of \a nb values.
+ * \param objs - Vector of objects.
+ * \param nb - Number of objects.
+ * \param x - X positions.
+ * \param y - Y positions.
+ * \param z - Z positions.
+ * \param angh - Horizontal angles.
+ * \param angv - Vertical angles.
+ */
+void Gl3DObject_placeArray(Gl3DObject* objs, Uint32 nb, Gl3DCoord* x, Gl3DCoord* y, Gl3DCoord* z, Gl3DCoord* angh, Gl3DCoord* angv);
+
 /*!
  * \brief Tell if an object is visible or hidden.
  *
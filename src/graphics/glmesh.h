@@ -42,6 +42,21 @@
 #include "graphics/types.h"
 #include "core/types.h"
 
+/******************************************************************************
+ *                                  Typedefs                                  *
+ ******************************************************************************/
+/*!
+ * \brief Placement of a mesh, used to merge several meshes in one.
+ */
+typedef struct
+{
+    GlMesh mesh;        /*!< Placed mesh. */
+    Gl3DCoord x;        /*!< X position. */
+    Gl3DCoord y;        /*!< Y position. */
+    Gl3DCoord z;        /*!< Z position. */
+    Gl3DCoord angh;     /*!< Horizontal angle. */
+} GlMeshInstance;
+
 /******************************************************************************
  *############################################################################*
  *#                              GlMesh functions                            #*
@@ -55,6 +70,20 @@
  */
 GlMesh GlMesh_new(Var v);
 
+/*!
+ * \brief Create a new static mesh by merging placed meshes.
+ *
+ * Parts sharing the same rendering properties (texture, shading, blending...)
+ * are merged in a single part, so the result can be drawn with few calls.
+ * Animations are not kept, parts are taken at their rest position.
+ * Control points of the result are the corners of the bounding box of all
+ * placed control points.
+ * \param instances - Array of placed meshes.
+ * \param nb - Number of placed meshes.
+ * \return The newly allocated mesh.
+ */
+GlMesh GlMesh_newMerged(GlMeshInstance* instances, Uint32 nb);
+
 /*!
  * \brief Destroy a mesh.
  *
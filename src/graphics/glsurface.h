@@ -42,6 +42,14 @@
 #include "graphics/types.h"
 #include "core/types.h"
 
+/******************************************************************************
+ *                                  Constants                                 *
+ ******************************************************************************/
+/*!
+ * \brief Maximal number of changed areas tracked by a surface.
+ */
+#define GLSURFACE_DIRTY_NB 4
+
 /******************************************************************************
  *                                  Typedefs                                  *
  ******************************************************************************/
@@ -145,6 +153,37 @@ void GlSurface_getRect(GlSurface surface, GlRect* rect);
  */
 GlColor* GlSurface_getPixels(GlSurface surface);
 
+/*!
+ * \brief Mark an area of a surface as changed.
+ *
+ * Drawing functions do it by themselves, this is only needed after writing
+ * pixels by other means (like a GlIterator). Linked textures only upload the
+ * changed areas.
+ * \param surf - The surface.
+ * \param rect - Changed area, NULL for the whole surface.
+ */
+void GlSurface_setDirty(GlSurface surf, GlRect* rect);
+
+/*!
+ * \brief Get the changed areas of a surface.
+ *
+ * \param surf - The surface.
+ * \param rects - Array of at least \ref GLSURFACE_DIRTY_NB rectangles to fill.
+ * \return The number of changed areas.
+ */
+Uint16 GlSurface_getDirty(GlSurface surf, GlRect* rects);
+
+/*!
+ * \brief Get the changed areas of a surface and forget them.
+ *
+ * A surface linked to a Gl2DObject is already watched by the object,
+ * use GlSurface_getDirty on it instead.
+ * \param surf - The surface.
+ * \param rects - Array of at least \ref GLSURFACE_DIRTY_NB rectangles to fill.
+ * \return The number of changed areas.
+ */
+Uint16 GlSurface_takeDirty(GlSurface surf, GlRect* rects);
+
 /*!
  * \brief Get a pixel color inside a surface.
  *
@@ -321,4 +360,13 @@ void GlSurface_copyRectTiled(GlSurface src, GlSurface dest, GlRect* srcrect, GlR
  */
 void GlSurface_movePart(GlSurface surf, GlRect rct, Gl2DCoord dx, Gl2DCoord dy);
 
+/*!
+ * \brief Check the active pixel kernels against the scalar reference ones.
+ *
+ * Fills, recolors, alpha blending and tiled copies are run on random spans of all
+ * lengths and alignments up to 67 pixels, with both versions.
+ * \return The number of pixels that differ, 0 if the kernels are pixel-exact.
+ */
+Uint32 glsurfaceCheckKernels(void);
+
 #endif
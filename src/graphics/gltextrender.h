@@ -34,6 +34,10 @@
  * There is also a security system to be sure not to draw offlimits (which could happen
  * if a font is modified or deleted during a rendering).
  *
+ * Each font keeps a few copies of its surface filled with the last used colors, so renderers
+ * alternating between some colors don't refill the font at each call. Sizes given by
+ * GlTextRender_guessSize are cached too, by text content and rendering options.
+ *
  * The renderer renders the text until a breaking event :
  * \li A new line character.
  * \li A carriage return character.
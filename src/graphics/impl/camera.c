@@ -36,6 +36,12 @@
 #include "tools/fonct.h"
 #include <math.h>
 
+/******************************************************************************
+ *                                 Constants                                  *
+ ******************************************************************************/
+/*Maximal depth of pushed objects (an object and its mesh parts)*/
+#define MATRIX_STACK_SIZE 8
+
 /******************************************************************************
  *                                  Typedefs                                  *
  ******************************************************************************/
@@ -67,6 +73,12 @@ static Gl3DCoord worldwidth, worldheight, worldfactor;
 static GlEvent event;
 static Bool eventneeded;
 
+/*CPU side copy of the OpenGL matrices, used for culling and projection*/
+static GLfloat projmatrix[16];
+static GLfloat modelstack[MATRIX_STACK_SIZE][16];
+static Uint16 modeldepth;
+static GLint viewport[4];
+
 static CoreID MOD_ID = CORE_INVALID_ID;
 static CoreID RES_WORLD_WIDTH = CORE_INVALID_ID;
 static CoreID RES_WORLD_HEIGHT = CORE_INVALID_ID;
@@ -126,6 +138,133 @@ calcLook()
     eventneeded = TRUE;
 }
 
+/*----------------------------------------------------------------------------*/
+/*res = a * b (column-major 4x4 matrices, res must not be a or b)*/
+static void
+matMult(GLfloat* res, const GLfloat* a, const GLfloat* b)
+{
+    int i, j;
+
+    for (i = 0; i < 4; i++)
+    {
+        for (j = 0; j < 4; j++)
+        {
+            res[j * 4 + i] = a[i] * b[j * 4] + a[4 + i] * b[j * 4 + 1] + a[8 + i] * b[j * 4 + 2] + a[12 + i] * b[j * 4 + 3];
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*Same matrix as glFrustum*/
+static void
+matFrustum(GLfloat* m, GLfloat l, GLfloat r, GLfloat b, GLfloat t, GLfloat n, GLfloat f)
+{
+    int i;
+
+    for (i = 0; i < 16; i++)
+    {
+        m[i] = 0.0f;
+    }
+    m[0] = 2.0f * n / (r - l);
+    m[5] = 2.0f * n / (t - b);
+    m[8] = (r + l) / (r - l);
+    m[9] = (t + b) / (t - b);
+    m[10] = -(f + n) / (f - n);
+    m[11] = -1.0f;
+    m[14] = -2.0f * f * n / (f - n);
+}
+
+/*----------------------------------------------------------------------------*/
+/*Same matrix as gluLookAt*/
+static void
+matLookAt(GLfloat* m, CameraPos* eye, CameraPos* look, CameraPos* up)
+{
+    GLfloat f[3], s[3], u[3];
+    GLfloat n;
+
+    f[0] = look->x - eye->x;
+    f[1] = look->y - eye->y;
+    f[2] = look->z - eye->z;
+    n = sqrt(f[0] * f[0] + f[1] * f[1] + f[2] * f[2]);
+    f[0] /= n;
+    f[1] /= n;
+    f[2] /= n;
+
+    s[0] = f[1] * up->z - f[2] * up->y;
+    s[1] = f[2] * up->x - f[0] * up->z;
+    s[2] = f[0] * up->y - f[1] * up->x;
+    n = sqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2]);
+    s[0] /= n;
+    s[1] /= n;
+    s[2] /= n;
+
+    u[0] = s[1] * f[2] - s[2] * f[1];
+    u[1] = s[2] * f[0] - s[0] * f[2];
+    u[2] = s[0] * f[1] - s[1] * f[0];
+
+    m[0] = s[0];
+    m[4] = s[1];
+    m[8] = s[2];
+    m[1] = u[0];
+    m[5] = u[1];
+    m[9] = u[2];
+    m[2] = -f[0];
+    m[6] = -f[1];
+    m[10] = -f[2];
+    m[3] = m[7] = m[11] = 0.0f;
+    m[12] = -(m[0] * eye->x + m[4] * eye->y + m[8] * eye->z);
+    m[13] = -(m[1] * eye->x + m[5] * eye->y + m[9] * eye->z);
+    m[14] = -(m[2] * eye->x + m[6] * eye->y + m[10] * eye->z);
+    m[15] = 1.0f;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Local transformation of an object*/
+static void
+objectMatrix(GLfloat* m, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z, Gl3DCoord angh, Gl3DCoord angv)
+{
+    GLfloat ca, sa, cb, sb;
+
+    /*object transformations, same as:
+        glTranslatef(x, y, z);
+        glRotatef(-RAD2DEG(angh), 0.0, 1.0, 0.0);
+        glRotatef(-RAD2DEG(angv), 0.0, 0.0, -1.0);*/
+    ca = cos(-angh);
+    sa = sin(-angh);
+    cb = cos(angv);
+    sb = sin(angv);
+    m[0] = ca * cb;
+    m[1] = sb;
+    m[2] = -sa * cb;
+    m[3] = 0.0f;
+    m[4] = -ca * sb;
+    m[5] = cb;
+    m[6] = sa * sb;
+    m[7] = 0.0f;
+    m[8] = sa;
+    m[9] = 0.0f;
+    m[10] = ca;
+    m[11] = 0.0f;
+    m[12] = x;
+    m[13] = y;
+    m[14] = z;
+    m[15] = 1.0f;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Load the CPU matrices into OpenGL, the modelview stack is reset*/
+static void
+loadScene(void)
+{
+    modeldepth = 0;
+    openglGet3DViewport(viewport);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(projmatrix);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixf(modelstack[0]);
+}
+
 /*----------------------------------------------------------------------------*/
 static void
 resCallback(CoreID id, Var value)
@@ -237,50 +376,112 @@ void
 cameraSetSceneNormal()
 {
     /*projection*/
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    /*glFrustum(-0.1 * camcurrent.dist, 0.1 * camcurrent.dist, -0.1 * camcurrent.dist * global_screenratio, 0.1 * camcurrent.dist * global_screenratio, 0.2 * camcurrent.dist, 20.0 * camcurrent.dist);*/
-    glFrustum(-0.05, 0.05, -0.05 * global_screenratio, 0.05 * global_screenratio, 0.1, 1000.0);
+    /*matFrustum(projmatrix, -0.1 * camcurrent.dist, 0.1 * camcurrent.dist, -0.1 * camcurrent.dist * global_screenratio, 0.1 * camcurrent.dist * global_screenratio, 0.2 * camcurrent.dist, 20.0 * camcurrent.dist);*/
+    matFrustum(projmatrix, -0.05, 0.05, -0.05 * global_screenratio, 0.05 * global_screenratio, 0.1, 1000.0);
     
     /*viewpoint*/
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    gluLookAt(camcurrent.eye.x, camcurrent.eye.y, camcurrent.eye.z, camcurrent.look.x, camcurrent.look.y, camcurrent.look.z, camcurrent.up.x, camcurrent.up.y, camcurrent.up.z);
+    matLookAt(modelstack[0], &camcurrent.eye, &camcurrent.look, &camcurrent.up);
+
+    loadScene();
 }
 
 /*----------------------------------------------------------------------------*/
 void
 cameraSetSceneBackground()
 {
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glFrustum(-0.05, 0.05, -0.05 * global_screenratio, 0.05 * global_screenratio, 0.07, 50.0);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    gluLookAt(camcurrent.eyebg.x, camcurrent.eyebg.y, camcurrent.eyebg.z, camcurrent.lookbg.x, camcurrent.lookbg.y, camcurrent.lookbg.z, camcurrent.up.x, camcurrent.up.y, camcurrent.up.z);
+    matFrustum(projmatrix, -0.05, 0.05, -0.05 * global_screenratio, 0.05 * global_screenratio, 0.07, 50.0);
+    matLookAt(modelstack[0], &camcurrent.eyebg, &camcurrent.lookbg, &camcurrent.up);
+
+    loadScene();
 }
 
 /*----------------------------------------------------------------------------*/
 void
 cameraPushObject(Gl3DCoord x, Gl3DCoord y, Gl3DCoord z, Gl3DCoord angh, Gl3DCoord angv)
 {
+    GLfloat m[16];
+
+    ASSERT_CRITICAL(modeldepth < MATRIX_STACK_SIZE - 1);
+
+    objectMatrix(m, x, y, z, angh, angv);
+    matMult(modelstack[modeldepth + 1], modelstack[modeldepth], m);
+    modeldepth++;
+
     glMatrixMode(GL_MODELVIEW);
     glPushMatrix();
-    
-    /*object transformations*/
-    glTranslatef(x, y, z);
-    glRotatef(-RAD2DEG(angh), 0.0, 1.0, 0.0);
-    glRotatef(-RAD2DEG(angv), 0.0, 0.0, -1.0);
+    glLoadMatrixf(modelstack[modeldepth]);
 }
 
 /*----------------------------------------------------------------------------*/
 void
 cameraPopObject(void)
 {
+    ASSERT(modeldepth > 0, return);
+    modeldepth--;
+
     glMatrixMode(GL_MODELVIEW);
     glPopMatrix();
 }
 
+/*----------------------------------------------------------------------------*/
+void
+cameraGetObjectMatrix(GLfloat* res, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z, Gl3DCoord angh, Gl3DCoord angv)
+{
+    GLfloat m[16];
+
+    objectMatrix(m, x, y, z, angh, angv);
+    matMult(res, modelstack[modeldepth], m);
+}
+
+/*----------------------------------------------------------------------------*/
+Uint16
+cameraProjectPoints(Gl3DCoord* sphere, Gl3DCoord* points, Uint16 nb, Gl3DCoord* out)
+{
+    GLfloat mvp[16];
+    GLfloat p[4];
+    GLfloat d;
+    Uint16 i, n;
+
+    matMult(mvp, projmatrix, modelstack[modeldepth]);
+
+    /*bounding sphere against the frustum planes (left, right, bottom, top, near, far),
+      the object transformations have no scaling so the radius is kept in local space*/
+    for (i = 0; i < 3; i++)
+    {
+        for (n = 0; n < 2; n++)
+        {
+            p[0] = mvp[3] + (n ? -mvp[i] : mvp[i]);
+            p[1] = mvp[7] + (n ? -mvp[4 + i] : mvp[4 + i]);
+            p[2] = mvp[11] + (n ? -mvp[8 + i] : mvp[8 + i]);
+            p[3] = mvp[15] + (n ? -mvp[12 + i] : mvp[12 + i]);
+            d = p[0] * sphere[0] + p[1] * sphere[1] + p[2] * sphere[2] + p[3];
+            if (d < -sphere[3] * sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]))
+            {
+                return 0;
+            }
+        }
+    }
+
+    /*project points that are inside the clipping volume (like the feedback mode would do)*/
+    n = 0;
+    for (i = 0; i < nb; i++, points += 3)
+    {
+        p[3] = mvp[3] * points[0] + mvp[7] * points[1] + mvp[11] * points[2] + mvp[15];
+        p[0] = mvp[0] * points[0] + mvp[4] * points[1] + mvp[8] * points[2] + mvp[12];
+        p[1] = mvp[1] * points[0] + mvp[5] * points[1] + mvp[9] * points[2] + mvp[13];
+        p[2] = mvp[2] * points[0] + mvp[6] * points[1] + mvp[10] * points[2] + mvp[14];
+        if ((p[0] >= -p[3]) && (p[0] <= p[3]) && (p[1] >= -p[3]) && (p[1] <= p[3]) && (p[2] >= -p[3]) && (p[2] <= p[3]) && (p[3] > 0.0f))
+        {
+            out[n * 3] = (GLfloat)viewport[0] + (p[0] / p[3] + 1.0f) * (GLfloat)viewport[2] * 0.5f;
+            out[n * 3 + 1] = (GLfloat)viewport[1] + (p[1] / p[3] + 1.0f) * (GLfloat)viewport[3] * 0.5f;
+            out[n * 3 + 2] = (p[2] / p[3] + 1.0f) * 0.5f;
+            n++;
+        }
+    }
+
+    return n;
+}
+
 /*----------------------------------------------------------------------------*/
 void
 cameraSetPos(Gl3DCoord x, Gl3DCoord y, Gl3DCoord z)
@@ -46,6 +46,14 @@ Uint32 GlColor_Bshift;
 Uint32 GlColor_Amask;
 Uint32 GlColor_Ashift;
 
+/******************************************************************************
+ *                             Static variables                               *
+ ******************************************************************************/
+static VarKey _key_r = VAR_KEY("r");
+static VarKey _key_g = VAR_KEY("g");
+static VarKey _key_b = VAR_KEY("b");
+static VarKey _key_a = VAR_KEY("a");
+
 /******************************************************************************
  *############################################################################*
  *#                            ColorRGBA functions                           #*
@@ -84,10 +92,10 @@ GlColorRGBA_makeFromVar(GlColorRGBA* col, Var vcol)
     VarValidator_validate(valid, vcol);
     VarValidator_del(valid);
     
-    col->r = Var_getValueInt(Var_getArrayElemByCName(vcol, "r"));
-    col->g = Var_getValueInt(Var_getArrayElemByCName(vcol, "g"));
-    col->b = Var_getValueInt(Var_getArrayElemByCName(vcol, "b"));
-    col->a = Var_getValueInt(Var_getArrayElemByCName(vcol, "a"));
+    col->r = Var_getValueInt(Var_getArrayElemByKey(vcol, &_key_r));
+    col->g = Var_getValueInt(Var_getArrayElemByKey(vcol, &_key_g));
+    col->b = Var_getValueInt(Var_getArrayElemByKey(vcol, &_key_b));
+    col->a = Var_getValueInt(Var_getArrayElemByKey(vcol, &_key_a));
 }
 
 /*----------------------------------------------------------------------------*/
@@ -103,7 +111,7 @@ GlColorRGB_makeFromVar(GlColorRGB* col, Var vcol)
     VarValidator_validate(valid, vcol);
     VarValidator_del(valid);
     
-    col->r = Var_getValueInt(Var_getArrayElemByCName(vcol, "r"));
-    col->g = Var_getValueInt(Var_getArrayElemByCName(vcol, "g"));
-    col->b = Var_getValueInt(Var_getArrayElemByCName(vcol, "b"));
+    col->r = Var_getValueInt(Var_getArrayElemByKey(vcol, &_key_r));
+    col->g = Var_getValueInt(Var_getArrayElemByKey(vcol, &_key_g));
+    col->b = Var_getValueInt(Var_getArrayElemByKey(vcol, &_key_b));
 }
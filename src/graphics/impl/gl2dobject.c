@@ -67,17 +67,10 @@ struct pv_Gl2DObject
     Gl2DSize z;                 /*!< Current Z position (altitude). */
     Bool zmoved;                /*!< Object has been moved along z axis (need z-sorting again). */
     
-    Anim animpos;               /*!< Animation for position. */
-    AnimControl animposcontrol; /*!< Animation controller for position. */
-    CoreTime animpostotaltime;  /*!< Pos animation total time. */
-    CoreTime animpostime;       /*!< Pos animation current time. */
+    Tween tweenpos;             /*!< Transition of position. */
     
     Float col[4];               /*!< Global color. */
-
-    Anim animcol;               /*!< Animation for color. */
-    AnimControl animcolcontrol; /*!< Animation controller for color. */
-    CoreTime animcoltotaltime;  /*!< Color animation total time. */
-    CoreTime animcoltime;       /*!< Color animation current time. */
+    Tween tweencol;             /*!< Transition of color. */
     
     GlEventCallback eventcb;    /*!< Callback function to execute for catched events. */
     GlExtID extid;              /*!< Additional data to pass to the callback. */
@@ -86,12 +79,6 @@ struct pv_Gl2DObject
     GlLinkedTexture tex;        /*!< Linked texture. */
 };
 
-/******************************************************************************
- *                                  Statics                                   *
- ******************************************************************************/
-/*values used for anim*/
-static Int _v0, _v1;
-
 /******************************************************************************
  *############################################################################*
  *#                            Private functions                             #*
@@ -113,16 +100,6 @@ Gl2DObject_processEvent(Gl2DObject obj, GlEvent* event)
             
             /*free memory*/
             GlLinkedTexture_del(obj->tex);
-            AnimControl_del(obj->animposcontrol);
-            if (obj->animpos != NULL)
-            {
-                Anim_del(obj->animpos);
-            }
-            AnimControl_del(obj->animcolcontrol);
-            if (obj->animcol != NULL)
-            {
-                Anim_del(obj->animcol);
-            }
             FREE(obj);
             return TRUE;
         
@@ -162,28 +139,18 @@ Gl2DObject_processEvent(Gl2DObject obj, GlEvent* event)
             }
             
             /*do animations*/
-            if (obj->animpos != NULL)
+            if (Tween_isRunning(&obj->tweenpos))
             {
-                obj->animpostime += event->event.frameduration;
-                AnimControl_update(obj->animposcontrol, obj->animpostime);
-                obj->x = (Gl2DCoord)_v0;
-                obj->y = (Gl2DCoord)_v1;
-                if (obj->animpostime >= obj->animpostotaltime)
-                {
-                    /*end animation*/
-                    Anim_del(obj->animpos);
-                    obj->animpos = NULL;
-                }
+                Tween_update(&obj->tweenpos, event->event.frameduration);
+                obj->x = (Gl2DCoord)Tween_getInt(&obj->tweenpos, 0);
+                obj->y = (Gl2DCoord)Tween_getInt(&obj->tweenpos, 1);
             }
-            if (obj->animcol != NULL)
+            if (Tween_isRunning(&obj->tweencol))
             {
-                obj->animcoltime += event->event.frameduration;
-                AnimControl_update(obj->animcolcontrol, obj->animcoltime);
-                if (obj->animcoltime >= obj->animcoltotaltime)
+                Tween_update(&obj->tweencol, event->event.frameduration);
+                for (i = 0; i < 4; i++)
                 {
-                    /*end animation*/
-                    Anim_del(obj->animcol);
-                    obj->animcol = NULL;
+                    obj->col[i] = Tween_getFloat(&obj->tweencol, i);
                 }
             }
             
@@ -231,6 +198,14 @@ Gl2DObject_cmp(Gl2DObject* obj1, Gl2DObject* obj2)
     return (*obj1)->z - (*obj2)->z;
 }
 
+/*----------------------------------------------------------------------------*/
+Uint32
+Gl2DObject_depthKey(Gl2DObject obj)
+{
+    /*same order as Gl2DObject_cmp*/
+    return obj->z;
+}
+
 /******************************************************************************
  *############################################################################*
  *#                             Public functions                             #*
@@ -251,20 +226,12 @@ Gl2DObject_new(GlSurface surf, GlExtID extid, GlEventCallback callback)
     ret->y = 0;
     ret->z = 0;
     ret->zmoved = TRUE;
-    ret->animpos = NULL;
-    ret->animposcontrol = AnimControl_new(2);
-    AnimControl_setIntControl(ret->animposcontrol, 0, &_v0);
-    AnimControl_setIntControl(ret->animposcontrol, 1, &_v1);
+    Tween_init(&ret->tweenpos);
     ret->col[0] = 1.0f;
     ret->col[1] = 1.0f;
     ret->col[2] = 1.0f;
     ret->col[3] = 1.0f;
-    ret->animcol = NULL;
-    ret->animcolcontrol = AnimControl_new(4);
-    AnimControl_setFloatControl(ret->animcolcontrol, 0, ret->col);
-    AnimControl_setFloatControl(ret->animcolcontrol, 1, ret->col + 1);
-    AnimControl_setFloatControl(ret->animcolcontrol, 2, ret->col + 2);
-    AnimControl_setFloatControl(ret->animcolcontrol, 3, ret->col + 3);
+    Tween_init(&ret->tweencol);
     ret->eventcb = callback;
     ret->extid = extid;
     ret->tex = GlLinkedTexture_new(surf, &ret->nbparts);
@@ -344,12 +311,8 @@ Gl2DObject_relink(Gl2DObject obj, GlSurface surf)
 void
 Gl2DObject_setColor(Gl2DObject obj, GlColorRGBA col, CoreTime duration)
 {
-    if (obj->animcol != NULL)
-    {
-        /*there is already an anim*/
-        Anim_del(obj->animcol);
-        obj->animcol = NULL;
-    }
+    /*stop any previous transition*/
+    Tween_stop(&obj->tweencol);
     
     if (duration == 0)
     {
@@ -361,29 +324,19 @@ Gl2DObject_setColor(Gl2DObject obj, GlColorRGBA col, CoreTime duration)
     }
 
     /*setting animation*/
-    obj->animcol = Anim_new(NULL, 4);
-    Anim_addFloatFrame(obj->animcol, 0, 0, obj->col[0]);
-    Anim_addFloatFrame(obj->animcol, 0, 1, obj->col[1]);
-    Anim_addFloatFrame(obj->animcol, 0, 2, obj->col[2]);
-    Anim_addFloatFrame(obj->animcol, 0, 3, obj->col[3]);
-    Anim_addFloatFrame(obj->animcol, duration, 0, (Float)col.r / 255.0);
-    Anim_addFloatFrame(obj->animcol, duration, 1, (Float)col.g / 255.0);
-    Anim_addFloatFrame(obj->animcol, duration, 2, (Float)col.b / 255.0);
-    Anim_addFloatFrame(obj->animcol, duration, 3, (Float)col.a / 255.0);
-    obj->animcoltotaltime = AnimControl_linkToAnim(obj->animcolcontrol, obj->animcol);
-    obj->animcoltime = 0;
+    Tween_setValue(&obj->tweencol, 0, obj->col[0], (Float)col.r / 255.0);
+    Tween_setValue(&obj->tweencol, 1, obj->col[1], (Float)col.g / 255.0);
+    Tween_setValue(&obj->tweencol, 2, obj->col[2], (Float)col.b / 255.0);
+    Tween_setValue(&obj->tweencol, 3, obj->col[3], (Float)col.a / 255.0);
+    Tween_start(&obj->tweencol, duration);
 }
 
 /*----------------------------------------------------------------------------*/
 void
 Gl2DObject_setPos(Gl2DObject obj, Gl2DCoord x, Gl2DCoord y, CoreTime duration)
 {
-    if (obj->animpos != NULL)
-    {
-        /*there is already an anim*/
-        Anim_del(obj->animpos);
-        obj->animpos = NULL;
-    }
+    /*stop any previous transition*/
+    Tween_stop(&obj->tweenpos);
     
     if (duration == 0)
     {
@@ -393,13 +346,9 @@ Gl2DObject_setPos(Gl2DObject obj, Gl2DCoord x, Gl2DCoord y, CoreTime duration)
     }
 
     /*setting animation*/
-    obj->animpos = Anim_new(NULL, 2);
-    Anim_addIntFrame(obj->animpos, 0, 0, (Int)(obj->x));
-    Anim_addIntFrame(obj->animpos, 0, 1, (Int)(obj->y));
-    Anim_addIntFrame(obj->animpos, duration, 0, (Int)x);
-    Anim_addIntFrame(obj->animpos, duration, 1, (Int)y);
-    obj->animpostotaltime = AnimControl_linkToAnim(obj->animposcontrol, obj->animpos);
-    obj->animpostime = 0;
+    Tween_setValue(&obj->tweenpos, 0, (Float)obj->x, (Float)x);
+    Tween_setValue(&obj->tweenpos, 1, (Float)obj->y, (Float)y);
+    Tween_start(&obj->tweenpos, duration);
 }
 
 /*----------------------------------------------------------------------------*/
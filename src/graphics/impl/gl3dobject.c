@@ -58,15 +58,11 @@ struct pv_Gl3DObject
     GlExtID extid;              /*!< External identifier. */
     Gl3DGroup group;            /*!< Object's group. */
     Bool visible;               /*!< Visible or not. */
-    Bool zsorted;               /*!< Z-sorting is needed or not. */
     GlMesh mesh;                /*!< Link to the mesh containing graphical data for this object. */
     GlMeshControl meshcontrol;  /*!< Mesh controller. */
     GlMeshInfo info;
     
-    Anim anim[ANIM_NB];                 /*!< Animations for internal values. */
-    AnimControl animcontrol[ANIM_NB];   /*!< Animation controllers for internal values. */
-    CoreTime animtotaltime[ANIM_NB];    /*!< Total animation time for internal anims. */
-    CoreTime animcurtime[ANIM_NB];      /*!< Current animation time for internal anims. */
+    Tween tween[ANIM_NB];       /*!< Transitions of internal values. */
     
     Gl3DCoord x;                /*!< Current X position in the world. */
     Gl3DCoord y;                /*!< Current Y position in the world. */
@@ -77,6 +73,39 @@ struct pv_Gl3DObject
     GlEventCallback eventcb;    /*!< Callback function to execute for catched events. */
 };
 
+/******************************************************************************
+ *############################################################################*
+ *#                            Private functions                             #*
+ *############################################################################*
+ ******************************************************************************/
+/*This function sets internal values from their transition state*/
+static void
+applyTween(Gl3DObject obj, int anim)
+{
+    Tween* tween = obj->tween + anim;
+    
+    switch (anim)
+    {
+        case ANIM_POS:
+            obj->x = Tween_getFloat(tween, 0);
+            obj->y = Tween_getFloat(tween, 1);
+            obj->z = Tween_getFloat(tween, 2);
+            break;
+        case ANIM_ANG:
+            obj->angh = Tween_getFloat(tween, 0);
+            obj->angv = Tween_getFloat(tween, 1);
+            break;
+        case ANIM_COL:
+            obj->color[0] = Tween_getFloat(tween, 0);
+            obj->color[1] = Tween_getFloat(tween, 1);
+            obj->color[2] = Tween_getFloat(tween, 2);
+            obj->color[3] = Tween_getFloat(tween, 3);
+            break;
+        default:
+            ;
+    }
+}
+
 /******************************************************************************
  *############################################################################*
  *#                            Internal functions                            #*
@@ -95,21 +124,15 @@ Gl3DObject_processEvent(Gl3DObject obj, GlEvent* event)
             /*do animations*/
             for (i = 0; i < ANIM_NB; i++)
             {
-                if (obj->anim[i] != NULL)
+                if (Tween_isRunning(obj->tween + i))
                 {
-                    obj->animcurtime[i] += event->event.frameduration;
-                    AnimControl_update(obj->animcontrol[i], obj->animcurtime[i]);
+                    Tween_update(obj->tween + i, event->event.frameduration);
+                    applyTween(obj, i);
                     if (i < 2)
                     {
                         obj->info.drawn = TRUE;
                         obj->info.check = TRUE;
                     }
-                    if (obj->animcurtime[i] >= obj->animtotaltime[i])
-                    {
-                        /*end animation*/
-                        Anim_del(obj->anim[i]);
-                        obj->anim[i] = NULL;
-                    }
                 }
             }
 
@@ -118,7 +141,7 @@ Gl3DObject_processEvent(Gl3DObject obj, GlEvent* event)
             if ((obj->mesh != NULL) && (obj->visible))
             {
                 cameraPushObject(obj->x, obj->y, obj->z, obj->angh, obj->angv);
-                glColor4fv(obj->color);
+                openglSetColor(obj->color);
                 if (global_cammoved)
                 {
                     obj->info.drawn = TRUE;
@@ -126,7 +149,6 @@ Gl3DObject_processEvent(Gl3DObject obj, GlEvent* event)
                 }
                 ret = obj->info.check;
                 GlMesh_draw(obj->mesh, obj->meshcontrol, &obj->info);
-                obj->info.forcecheck = obj->zsorted;
                 cameraPopObject();
             }
             else
@@ -156,15 +178,7 @@ Gl3DObject_processEvent(Gl3DObject obj, GlEvent* event)
             
             /*free memory*/
             Gl3DObject_setMesh(obj, NULL);  /*to destroy the mesh controller and the link*/
-            for (i = 0; i < ANIM_NB; i++)
-            {
-                AnimControl_del(obj->animcontrol[i]);
-                if (obj->anim[i] != NULL)
-                {
-                    Anim_del(obj->anim[i]);
-                }
-            }
-            FREE(obj);
+            POOL_FREE(MEMPOOL_GL3DOBJECT, obj);
             return FALSE;
         default:
             ;
@@ -190,6 +204,31 @@ Gl3DObject_cmp(Gl3DObject* obj1, Gl3DObject* obj2)
     }
 }
 
+/*----------------------------------------------------------------------------*/
+Uint32
+Gl3DObject_depthKey(Gl3DObject obj)
+{
+    union
+    {
+        Float f;
+        Uint32 u;
+    } bits;
+    
+    /*IEEE floats compare like sign-magnitude integers, flip them into unsigned order*/
+    bits.f = obj->info.z;
+    if (bits.u & 0x80000000)
+    {
+        bits.u = ~bits.u;
+    }
+    else
+    {
+        bits.u |= 0x80000000;
+    }
+    
+    /*Gl3DObject_cmp sorts by decreasing depth*/
+    return ~bits.u;
+}
+
 /******************************************************************************
  *############################################################################*
  *#                             Public functions                             #*
@@ -199,37 +238,24 @@ Gl3DObject
 Gl3DObject_new(GlExtID extid, Gl3DGroup group, GlEventCallback callback)
 {
     Gl3DObject ret;
+    int i;
     
-    ret = (Gl3DObject)MALLOC(sizeof(pv_Gl3DObject));
+    ret = (Gl3DObject)POOL_ALLOC(MEMPOOL_GL3DOBJECT, sizeof(pv_Gl3DObject));
     ret->extid = extid;
     ret->group = group;
     ret->mesh = NULL;
     ret->meshcontrol = NULL;
     ret->visible = TRUE;
-    ret->zsorted = graphicsIsGroupZSorted(group);
     GlRect_MAKE(ret->info.rct, -1, -1, 1, 1);
     ret->info.check = TRUE;
     ret->info.drawn = TRUE;
-    ret->info.forcecheck = ret->zsorted;
     ret->info.z = 0.0;
+    ret->info.color = ret->color;
     
-    ret->anim[ANIM_POS] = NULL;
-    ret->animcontrol[ANIM_POS] = AnimControl_new(3);
-    AnimControl_setFloatControl(ret->animcontrol[ANIM_POS], 0, &ret->x);
-    AnimControl_setFloatControl(ret->animcontrol[ANIM_POS], 1, &ret->y);
-    AnimControl_setFloatControl(ret->animcontrol[ANIM_POS], 2, &ret->z);
-    
-    ret->anim[ANIM_ANG] = NULL;
-    ret->animcontrol[ANIM_ANG] = AnimControl_new(2);
-    AnimControl_setFloatControl(ret->animcontrol[ANIM_ANG], 0, &ret->angh);
-    AnimControl_setFloatControl(ret->animcontrol[ANIM_ANG], 1, &ret->angv);
-
-    ret->anim[ANIM_COL] = NULL;
-    ret->animcontrol[ANIM_COL] = AnimControl_new(4);
-    AnimControl_setFloatControl(ret->animcontrol[ANIM_COL], 0, ret->color + 0);
-    AnimControl_setFloatControl(ret->animcontrol[ANIM_COL], 1, ret->color + 1);
-    AnimControl_setFloatControl(ret->animcontrol[ANIM_COL], 2, ret->color + 2);
-    AnimControl_setFloatControl(ret->animcontrol[ANIM_COL], 3, ret->color + 3);
+    for (i = 0; i < ANIM_NB; i++)
+    {
+        Tween_init(ret->tween + i);
+    }
     
     ret->x = 0.0;
     ret->y = 0.0;
@@ -284,12 +310,8 @@ Gl3DObject_setMesh(Gl3DObject obj, GlMesh mesh)
 void
 Gl3DObject_setColor(Gl3DObject obj, GlColorRGBA col, CoreTime duration)
 {
-    if (obj->anim[ANIM_COL] != NULL)
-    {
-        /*there is already an anim*/
-        Anim_del(obj->anim[ANIM_COL]);
-        obj->anim[ANIM_COL] = NULL;
-    }
+    /*stop any previous transition*/
+    Tween_stop(obj->tween + ANIM_COL);
     
     if (duration == 0)
     {
@@ -300,17 +322,11 @@ Gl3DObject_setColor(Gl3DObject obj, GlColorRGBA col, CoreTime duration)
     }
     else
     {
-        obj->anim[ANIM_COL] = Anim_new(NULL, 4);
-        Anim_addFloatFrame(obj->anim[ANIM_COL], 0, 0, obj->color[0]);
-        Anim_addFloatFrame(obj->anim[ANIM_COL], 0, 1, obj->color[1]);
-        Anim_addFloatFrame(obj->anim[ANIM_COL], 0, 2, obj->color[2]);
-        Anim_addFloatFrame(obj->anim[ANIM_COL], 0, 3, obj->color[3]);
-        Anim_addFloatFrame(obj->anim[ANIM_COL], duration, 0, (Float)col.r / 255.0);
-        Anim_addFloatFrame(obj->anim[ANIM_COL], duration, 1, (Float)col.g / 255.0);
-        Anim_addFloatFrame(obj->anim[ANIM_COL], duration, 2, (Float)col.b / 255.0);
-        Anim_addFloatFrame(obj->anim[ANIM_COL], duration, 3, (Float)col.a / 255.0);
-        obj->animtotaltime[ANIM_COL] = AnimControl_linkToAnim(obj->animcontrol[ANIM_COL], obj->anim[ANIM_COL]);
-        obj->animcurtime[ANIM_COL] = 0;
+        Tween_setValue(obj->tween + ANIM_COL, 0, obj->color[0], (Float)col.r / 255.0);
+        Tween_setValue(obj->tween + ANIM_COL, 1, obj->color[1], (Float)col.g / 255.0);
+        Tween_setValue(obj->tween + ANIM_COL, 2, obj->color[2], (Float)col.b / 255.0);
+        Tween_setValue(obj->tween + ANIM_COL, 3, obj->color[3], (Float)col.a / 255.0);
+        Tween_start(obj->tween + ANIM_COL, duration);
     }
 }
 
@@ -328,12 +344,8 @@ Gl3DObject_setAnim(Gl3DObject obj, String anim, CoreTime time, unsigned int repe
 void
 Gl3DObject_setPos(Gl3DObject obj, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z, CoreTime duration)
 {
-    if (obj->anim[ANIM_POS] != NULL)
-    {
-        /*there is already an anim*/
-        Anim_del(obj->anim[ANIM_POS]);
-        obj->anim[ANIM_POS] = NULL;
-    }
+    /*stop any previous transition*/
+    Tween_stop(obj->tween + ANIM_POS);
     
     if (duration == 0)
     {
@@ -345,15 +357,10 @@ Gl3DObject_setPos(Gl3DObject obj, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z, CoreTim
     }
     else
     {
-        obj->anim[ANIM_POS] = Anim_new(NULL, 3);
-        Anim_addFloatFrame(obj->anim[ANIM_POS], 0, 0, obj->x);
-        Anim_addFloatFrame(obj->anim[ANIM_POS], 0, 1, obj->y);
-        Anim_addFloatFrame(obj->anim[ANIM_POS], 0, 2, obj->z);
-        Anim_addFloatFrame(obj->anim[ANIM_POS], duration, 0, x);
-        Anim_addFloatFrame(obj->anim[ANIM_POS], duration, 1, y);
-        Anim_addFloatFrame(obj->anim[ANIM_POS], duration, 2, z);
-        obj->animtotaltime[ANIM_POS] = AnimControl_linkToAnim(obj->animcontrol[ANIM_POS], obj->anim[ANIM_POS]);
-        obj->animcurtime[ANIM_POS] = 0;
+        Tween_setValue(obj->tween + ANIM_POS, 0, obj->x, x);
+        Tween_setValue(obj->tween + ANIM_POS, 1, obj->y, y);
+        Tween_setValue(obj->tween + ANIM_POS, 2, obj->z, z);
+        Tween_start(obj->tween + ANIM_POS, duration);
     }
 }
 
@@ -361,12 +368,8 @@ Gl3DObject_setPos(Gl3DObject obj, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z, CoreTim
 void
 Gl3DObject_setAngle(Gl3DObject obj, Gl3DCoord angh, Gl3DCoord angv, CoreTime duration)
 {
-    if (obj->anim[ANIM_ANG] != NULL)
-    {
-        /*there is already an anim*/
-        Anim_del(obj->anim[ANIM_ANG]);
-        obj->anim[ANIM_ANG] = NULL;
-    }
+    /*stop any previous transition*/
+    Tween_stop(obj->tween + ANIM_ANG);
     
     if (duration == 0)
     {
@@ -377,13 +380,31 @@ Gl3DObject_setAngle(Gl3DObject obj, Gl3DCoord angh, Gl3DCoord angv, CoreTime dur
     }
     else
     {
-        obj->anim[ANIM_ANG] = Anim_new(NULL, 2);
-        Anim_addFloatFrame(obj->anim[ANIM_ANG], 0, 0, obj->angh);
-        Anim_addFloatFrame(obj->anim[ANIM_ANG], 0, 1, obj->angv);
-        Anim_addFloatFrame(obj->anim[ANIM_ANG], duration, 0, angh);
-        Anim_addFloatFrame(obj->anim[ANIM_ANG], duration, 1, angv);
-        obj->animtotaltime[ANIM_ANG] = AnimControl_linkToAnim(obj->animcontrol[ANIM_ANG], obj->anim[ANIM_ANG]);
-        obj->animcurtime[ANIM_ANG] = 0;
+        Tween_setValue(obj->tween + ANIM_ANG, 0, obj->angh, angh);
+        Tween_setValue(obj->tween + ANIM_ANG, 1, obj->angv, angv);
+        Tween_start(obj->tween + ANIM_ANG, duration);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void
+Gl3DObject_placeArray(Gl3DObject* objs, Uint32 nb, Gl3DCoord* x, Gl3DCoord* y, Gl3DCoord* z, Gl3DCoord* angh, Gl3DCoord* angv)
+{
+    Uint32 i;
+    Gl3DObject obj;
+    
+    for (i = 0; i < nb; i++)
+    {
+        obj = objs[i];
+        Tween_stop(obj->tween + ANIM_POS);
+        Tween_stop(obj->tween + ANIM_ANG);
+        obj->x = x[i];
+        obj->y = y[i];
+        obj->z = z[i];
+        obj->angh = angh[i];
+        obj->angv = angv[i];
+        obj->info.drawn = TRUE;
+        obj->info.check = TRUE;
     }
 }
 
@@ -412,7 +433,6 @@ Gl3DObject_getGroup(Gl3DObject obj)
 GlRect
 Gl3DObject_getRect(Gl3DObject obj)
 {
-    obj->info.forcecheck = TRUE;
     return obj->info.rct;
 }
 
@@ -41,6 +41,8 @@
 #include "tools/varvalidator.h"
 #include "tools/fonct.h"
 
+#include <math.h>
+
 /******************************************************************************
  *                                  Typedefs                                  *
  ******************************************************************************/
@@ -59,7 +61,8 @@ struct pv_GlMesh
     GlMeshPart* parts;      /*NULL terminated array of parts*/
     Uint16 nbctrlpoints;    /*number of control points*/
     Gl3DCoord* ctrlpoints;  /*control points (used for visibility and selection)*/
-    Gl3DCoord* ctrlfback;   /*feedback of control points*/
+    Gl3DCoord* ctrlfback;   /*window projection of control points*/
+    Gl3DCoord bsphere[4];   /*bounding sphere of control points (center and radius)*/
     PtrArray anims;         /*animation data*/
 };
 
@@ -84,6 +87,7 @@ GlMesh_draw(GlMesh mesh, GlMeshControl control, GlMeshInfo* info)
     PartPlace* it_place;
     Uint16 i, n;
     Gl3DCoord xmin, xmax, ymin, ymax, zmin, zmax;
+    GLfloat m[16];
     
     ASSERT(mesh != NULL, return);
     ASSERT(control != NULL, return);
@@ -129,20 +133,10 @@ GlMesh_draw(GlMesh mesh, GlMeshControl control, GlMeshInfo* info)
     /*Check control points*/
     if (mesh->nbctrlpoints != 0)
     {
-        if (info->check && (info->forcecheck || (global_checkcount++ < 50)))
+        if (info->check)
         {
             info->check = FALSE;
-            glFeedbackBuffer(mesh->nbctrlpoints * 4, GL_3D, mesh->ctrlfback);
-            glRenderMode(GL_FEEDBACK);
-            
-            glBegin(GL_POINTS);
-            for (i = 0; i < mesh->nbctrlpoints; i++)
-            {
-                glVertex3fv(mesh->ctrlpoints + i * 3);
-            }
-            glEnd();
-            
-            n = glRenderMode(GL_RENDER);
+            n = cameraProjectPoints(mesh->bsphere, mesh->ctrlpoints, mesh->nbctrlpoints, mesh->ctrlfback);
             if (n != 0)
             {
                 xmax = -1.0;
@@ -151,15 +145,14 @@ GlMesh_draw(GlMesh mesh, GlMeshControl control, GlMeshInfo* info)
                 ymin = (Gl3DCoord)global_screenheight;
                 zmax = -1000000.0f;
                 zmin = 1000000.0f;
-                for (i = 0; i < n; i += 4)
+                for (i = 0; i < n * 3; i += 3)
                 {
-                    ASSERT_WARN(floatEqual(mesh->ctrlfback[i], GL_POINT_TOKEN));
-                    xmax = MAX(mesh->ctrlfback[i + 1], xmax);
-                    xmin = MIN(mesh->ctrlfback[i + 1], xmin);
-                    ymax = MAX(mesh->ctrlfback[i + 2], ymax);
-                    ymin = MIN(mesh->ctrlfback[i + 2], ymin);
-                    zmax = MAX(mesh->ctrlfback[i + 3], zmax);
-                    zmin = MIN(mesh->ctrlfback[i + 3], zmin);
+                    xmax = MAX(mesh->ctrlfback[i], xmax);
+                    xmin = MIN(mesh->ctrlfback[i], xmin);
+                    ymax = MAX(mesh->ctrlfback[i + 1], ymax);
+                    ymin = MIN(mesh->ctrlfback[i + 1], ymin);
+                    zmax = MAX(mesh->ctrlfback[i + 2], zmax);
+                    zmin = MIN(mesh->ctrlfback[i + 2], zmin);
                 }
                 /*TODO: maybe rounds*/
                 info->rct.x = (Gl2DCoord)xmin;
@@ -189,13 +182,27 @@ GlMesh_draw(GlMesh mesh, GlMeshControl control, GlMeshInfo* info)
     /*Render*/
     it_part = mesh->parts;
     it_place = control->parts_place;
-    while (*it_part != NULL)
+    if (GlMeshPart_isQueuing())
+    {
+        /*the queue will sort the draws by render state*/
+        while (*it_part != NULL)
+        {
+            cameraGetObjectMatrix(m, it_place->x, it_place->y, it_place->z, it_place->angh, it_place->angv);
+            GlMeshPart_queue(*it_part, m, info->color);
+            it_part++;
+            it_place++;
+        }
+    }
+    else
     {
-        cameraPushObject(it_place->x, it_place->y, it_place->z, it_place->angh, it_place->angv);
-        GlMeshPart_draw(*it_part);
-        cameraPopObject();
-        it_part++;
-        it_place++;
+        while (*it_part != NULL)
+        {
+            cameraPushObject(it_place->x, it_place->y, it_place->z, it_place->angh, it_place->angv);
+            GlMeshPart_draw(*it_part);
+            cameraPopObject();
+            it_part++;
+            it_place++;
+        }
     }
 }
 
@@ -211,7 +218,7 @@ GlMesh_makeControl(GlMesh mesh, GlMeshControl* control_p)
         {
             AnimControl_del((*control_p)->animcontrol);
             FREE((*control_p)->parts_place);
-            FREE(*control_p);
+            POOL_FREE(MEMPOOL_GLMESHCONTROL, *control_p);
             *control_p = NULL;
         }
     }
@@ -219,7 +226,7 @@ GlMesh_makeControl(GlMesh mesh, GlMeshControl* control_p)
     {
         if (*control_p == NULL)
         {
-            *control_p = MALLOC(sizeof(pv_GlMeshControl));
+            *control_p = POOL_ALLOC(MEMPOOL_GLMESHCONTROL, sizeof(pv_GlMeshControl));
             (*control_p)->animcontrol = AnimControl_new(mesh->nbparts * 5);
             (*control_p)->parts_place = MALLOC(sizeof(PartPlace) * mesh->nbparts * 5);
         }
@@ -273,6 +280,39 @@ GlMesh_linkControl(GlMesh mesh, GlMeshControl control, String anim, CoreTime tim
     Anim_del(as);
 }
 
+/*----------------------------------------------------------------------------*/
+/*Compute the bounding sphere of control points, centered on their bounding box*/
+static void
+GlMesh_computeBounds(GlMesh mesh)
+{
+    Gl3DCoord bmin[3], bmax[3];
+    Gl3DCoord d;
+    Uint16 i, j;
+
+    for (j = 0; j < 3; j++)
+    {
+        bmin[j] = bmax[j] = mesh->ctrlpoints[j];
+    }
+    for (i = 1; i < mesh->nbctrlpoints; i++)
+    {
+        for (j = 0; j < 3; j++)
+        {
+            bmin[j] = MIN(bmin[j], mesh->ctrlpoints[i * 3 + j]);
+            bmax[j] = MAX(bmax[j], mesh->ctrlpoints[i * 3 + j]);
+        }
+    }
+    mesh->bsphere[3] = 0.0f;
+    for (j = 0; j < 3; j++)
+    {
+        mesh->bsphere[j] = (bmin[j] + bmax[j]) / 2.0f;
+    }
+    for (i = 0; i < mesh->nbctrlpoints; i++)
+    {
+        d = dist3d(mesh->bsphere[0], mesh->bsphere[1], mesh->bsphere[2], mesh->ctrlpoints[i * 3], mesh->ctrlpoints[i * 3 + 1], mesh->ctrlpoints[i * 3 + 2]);
+        mesh->bsphere[3] = MAX(mesh->bsphere[3], d);
+    }
+}
+
 /*----------------------------------------------------------------------------*/
 static void
 GlMesh_setFromVar(GlMesh mesh, Var var)
@@ -305,19 +345,22 @@ GlMesh_setFromVar(GlMesh mesh, Var var)
     if (mesh->nbctrlpoints != 0)
     {
         mesh->ctrlpoints = MALLOC(sizeof(Gl3DCoord) * mesh->nbctrlpoints * 3);
-        mesh->ctrlfback = MALLOC(sizeof(Gl3DCoord) * mesh->nbctrlpoints * 4);
+        mesh->ctrlfback = MALLOC(sizeof(Gl3DCoord) * mesh->nbctrlpoints * 3);
         for (i = 0; (int)i < mesh->nbctrlpoints * 3; i++)
         {
             vv = Var_getArrayElemByPos(v, i);
             if (Var_getType(vv) != VAR_FLOAT)
             {
                 /*TODO: error*/
+                mesh->ctrlpoints[i] = 0.0f;
             }
             else
             {
                 mesh->ctrlpoints[i] = Var_getValueFloat(vv);
             }
         }
+
+        GlMesh_computeBounds(mesh);
     }
     
     /*create new mesh parts*/
@@ -392,6 +435,129 @@ GlMesh_new(Var var)
     return ret;
 }
 
+/*----------------------------------------------------------------------------*/
+GlMesh
+GlMesh_newMerged(GlMeshInstance* instances, Uint32 nb)
+{
+    GlMesh ret;
+    GlMeshPart* parts;
+    GlMeshInstance* places;
+    GlMeshPart* group_parts;
+    GlMeshInstance* group_places;
+    Bool* merged;
+    Gl3DCoord bmin[3], bmax[3];
+    Gl3DCoord c, s, px, py, pz;
+    Bool bounded;
+    Uint32 nbsrc, i, j, n;
+    Uint16 k;
+
+    ret = (GlMesh)MALLOC(sizeof(pv_GlMesh));
+    ret->anims = PtrArray_newFull(5, 3, (PtrFunc)Anim_del, (PtrCmpFunc)Anim_cmp);
+
+    /*list all placed parts*/
+    nbsrc = 0;
+    for (i = 0; i < nb; i++)
+    {
+        nbsrc += instances[i].mesh->nbparts;
+    }
+    ret->nbparts = 0;
+    ret->parts = MALLOC(sizeof(GlMeshPart) * (nbsrc + 1));
+    if (nbsrc != 0)
+    {
+        parts = MALLOC(sizeof(GlMeshPart) * nbsrc);
+        places = MALLOC(sizeof(GlMeshInstance) * nbsrc);
+        group_parts = MALLOC(sizeof(GlMeshPart) * nbsrc);
+        group_places = MALLOC(sizeof(GlMeshInstance) * nbsrc);
+        merged = MALLOC(sizeof(Bool) * nbsrc);
+        n = 0;
+        for (i = 0; i < nb; i++)
+        {
+            for (k = 0; k < instances[i].mesh->nbparts; k++)
+            {
+                parts[n] = instances[i].mesh->parts[k];
+                places[n] = instances[i];
+                merged[n] = FALSE;
+                n++;
+            }
+        }
+
+        /*merge compatible parts together*/
+        for (i = 0; i < nbsrc; i++)
+        {
+            if (!merged[i])
+            {
+                n = 0;
+                for (j = i; j < nbsrc; j++)
+                {
+                    if ((!merged[j]) && GlMeshPart_isCompatible(parts[i], parts[j]))
+                    {
+                        group_parts[n] = parts[j];
+                        group_places[n] = places[j];
+                        merged[j] = TRUE;
+                        n++;
+                    }
+                }
+                ret->parts[ret->nbparts++] = GlMeshPart_newMerged(group_parts, group_places, n);
+            }
+        }
+
+        FREE(parts);
+        FREE(places);
+        FREE(group_parts);
+        FREE(group_places);
+        FREE(merged);
+    }
+    ret->parts[ret->nbparts] = NULL;
+
+    /*bounding box of all control points*/
+    bounded = FALSE;
+    for (i = 0; i < nb; i++)
+    {
+        c = cos(-instances[i].angh);
+        s = sin(-instances[i].angh);
+        for (k = 0; k < instances[i].mesh->nbctrlpoints; k++)
+        {
+            Gl3DCoord* p = instances[i].mesh->ctrlpoints + k * 3;
+
+            px = c * p[0] + s * p[2] + instances[i].x;
+            py = p[1] + instances[i].y;
+            pz = -s * p[0] + c * p[2] + instances[i].z;
+            if (!bounded)
+            {
+                bmin[0] = bmax[0] = px;
+                bmin[1] = bmax[1] = py;
+                bmin[2] = bmax[2] = pz;
+                bounded = TRUE;
+            }
+            bmin[0] = MIN(bmin[0], px);
+            bmax[0] = MAX(bmax[0], px);
+            bmin[1] = MIN(bmin[1], py);
+            bmax[1] = MAX(bmax[1], py);
+            bmin[2] = MIN(bmin[2], pz);
+            bmax[2] = MAX(bmax[2], pz);
+        }
+    }
+    if (bounded)
+    {
+        ret->nbctrlpoints = 8;
+        ret->ctrlpoints = MALLOC(sizeof(Gl3DCoord) * 8 * 3);
+        ret->ctrlfback = MALLOC(sizeof(Gl3DCoord) * 8 * 3);
+        for (k = 0; k < 8; k++)
+        {
+            ret->ctrlpoints[k * 3] = (k & 1) ? bmax[0] : bmin[0];
+            ret->ctrlpoints[k * 3 + 1] = (k & 2) ? bmax[1] : bmin[1];
+            ret->ctrlpoints[k * 3 + 2] = (k & 4) ? bmax[2] : bmin[2];
+        }
+        GlMesh_computeBounds(ret);
+    }
+    else
+    {
+        ret->nbctrlpoints = 0;
+    }
+
+    return ret;
+}
+
 /*----------------------------------------------------------------------------*/
 void
 GlMesh_del(GlMesh mesh)
@@ -36,6 +36,8 @@
 #include "tools/fonct.h"
 #include "core/string.h"
 
+#include <math.h>
+
 /******************************************************************************
  *                                  Typedefs                                  *
  ******************************************************************************/
@@ -47,14 +49,41 @@ struct pv_GlMeshPart
     Bool blended;           /*blended or not*/
     Bool twosided;          /*two-sided polygons mode*/
     GlStaticTexture tex;    /*texture identifier*/
-    Gl3DCoord* vertices3;   /*vertex coordinates (3), grouped by triangles*/
-    TexCoord* texcoords3;   /*texture coordinates (2), grouped by triangles*/
-    Gl3DCoord* normals3;    /*normal vector coordinates (3), grouped by triangles*/
-    Gl3DCoord* vertices4;   /*vertex coordinates (3), grouped by quads*/
-    TexCoord* texcoords4;   /*texture coordinates (2), grouped by quads*/
-    Gl3DCoord* normals4;    /*normal vector coordinates (3), grouped by quads*/
+    Gl3DCoord* vertices3;   /*vertex coordinates (3), grouped by triangles (only while loading)*/
+    TexCoord* texcoords3;   /*texture coordinates (2), grouped by triangles (only while loading)*/
+    Gl3DCoord* normals3;    /*normal vector coordinates (3), grouped by triangles (only while loading)*/
+    Gl3DCoord* vertices4;   /*vertex coordinates (3), grouped by quads (only while loading)*/
+    TexCoord* texcoords4;   /*texture coordinates (2), grouped by quads (only while loading)*/
+    Gl3DCoord* normals4;    /*normal vector coordinates (3), grouped by quads (only while loading)*/
+
+    unsigned int nbvertices;    /*number of vertices in the indexed arrays*/
+    unsigned int nbindices;     /*number of indices (3 per triangle)*/
+    GLfloat* data;              /*vertex coordinates (3), then normals (3), then texture coordinates (2)*/
+    GLuint* indices;            /*triangle list*/
+    OpenGLBuffer vbo;           /*vertex buffer object holding 'data', 0 if not uploaded*/
+    OpenGLBuffer ibo;           /*index buffer object holding 'indices', 0 if not uploaded*/
+    Uint32 buffersgen;          /*buffers generation of vbo and ibo*/
 };
 
+typedef struct
+{
+    Uint32 key;                 /*packed render state, see makeKey*/
+    Uint32 seq;                 /*submission order, keeps the sort stable*/
+    GlMeshPart part;
+    GLfloat matrix[16];         /*modelview matrix*/
+    GLfloat color[4];
+} RenderRecord;
+
+/******************************************************************************
+ *                              Static variables                              *
+ ******************************************************************************/
+/*frame render queue*/
+static Bool _queuing = FALSE;
+static RenderRecord* _records = NULL;
+static RenderRecord** _sorted = NULL;
+static Uint32 _nbrecords = 0;
+static Uint32 _allocrecords = 0;
+
 /******************************************************************************
  *############################################################################*
  *#                            Private functions                             #*
@@ -116,6 +145,186 @@ read2TexCoord(Var v, TexCoord* c)
     }
 }
 
+/*----------------------------------------------------------------------------*/
+/*Merge triangles and quads into a single indexed triangle list*/
+static void
+GlMeshPart_buildIndexed(GlMeshPart part)
+{
+    GLfloat* vert;
+    GLfloat* norm;
+    GLfloat* texc;
+    GLuint* ind;
+    unsigned int i, base;
+
+    part->nbvertices = part->nbtriangles * 3 + part->nbquads * 4;
+    part->nbindices = part->nbtriangles * 3 + part->nbquads * 6;
+    if (part->nbvertices == 0)
+    {
+        return;
+    }
+
+    part->data = MALLOC(sizeof(GLfloat) * part->nbvertices * 8);
+    part->indices = MALLOC(sizeof(GLuint) * part->nbindices);
+    vert = part->data;
+    norm = part->data + part->nbvertices * 3;
+    texc = part->data + part->nbvertices * 6;
+    ind = part->indices;
+
+    if (part->nbtriangles != 0)
+    {
+        memCOPY(vert, part->vertices3, sizeof(GLfloat) * part->nbtriangles * 3 * 3);
+        memCOPY(norm, part->normals3, sizeof(GLfloat) * part->nbtriangles * 3 * 3);
+        memCOPY(texc, part->texcoords3, sizeof(GLfloat) * part->nbtriangles * 3 * 2);
+        for (i = 0; i < part->nbtriangles * 3; i++)
+        {
+            *ind++ = i;
+        }
+        FREE(part->vertices3);
+        FREE(part->texcoords3);
+        FREE(part->normals3);
+    }
+    if (part->nbquads != 0)
+    {
+        base = part->nbtriangles * 3;
+        memCOPY(vert + base * 3, part->vertices4, sizeof(GLfloat) * part->nbquads * 4 * 3);
+        memCOPY(norm + base * 3, part->normals4, sizeof(GLfloat) * part->nbquads * 4 * 3);
+        memCOPY(texc + base * 2, part->texcoords4, sizeof(GLfloat) * part->nbquads * 4 * 2);
+        for (i = 0; i < part->nbquads; i++)
+        {
+            /*a quad (a,b,c,d) is split in (a,b,c) and (a,c,d)*/
+            *ind++ = base + i * 4;
+            *ind++ = base + i * 4 + 1;
+            *ind++ = base + i * 4 + 2;
+            *ind++ = base + i * 4;
+            *ind++ = base + i * 4 + 2;
+            *ind++ = base + i * 4 + 3;
+        }
+        FREE(part->vertices4);
+        FREE(part->texcoords4);
+        FREE(part->normals4);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*Drop the buffer objects (if any) and upload them again if buffers are enabled*/
+static void
+GlMeshPart_uploadBuffers(GlMeshPart part)
+{
+    if ((part->vbo != 0) && (part->buffersgen == openglBuffersGeneration()))
+    {
+        openglDeleteBuffer(part->vbo);
+        openglDeleteBuffer(part->ibo);
+    }
+    /*buffers of a previous generation died with their context, their names may be reused*/
+    part->vbo = 0;
+    part->ibo = 0;
+    if (openglHasBuffers())
+    {
+        part->vbo = openglCreateBuffer(GL_ARRAY_BUFFER_ARB, part->data, sizeof(GLfloat) * part->nbvertices * 8);
+        part->ibo = openglCreateBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, part->indices, sizeof(GLuint) * part->nbindices);
+    }
+    part->buffersgen = openglBuffersGeneration();
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+setState(GlMeshPart part)
+{
+    openglSetCulling(!part->twosided);
+    openglSetBlending(global_forceblend || part->blended);
+    GlStaticTexture_use(part->tex);
+    openglSetShadeModel(part->shademode);
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+setArrays(GlMeshPart part)
+{
+    if ((part->buffersgen != openglBuffersGeneration()) || ((part->vbo != 0) != openglHasBuffers()))
+    {
+        GlMeshPart_uploadBuffers(part);
+    }
+    if (part->vbo != 0)
+    {
+        /*retained data, pointers are offsets in the buffers*/
+        openglBindBuffer(GL_ARRAY_BUFFER_ARB, part->vbo);
+        openglBindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, part->ibo);
+        glVertexPointer(3, GL_FLOAT, 0, (GLvoid*)0);
+        glNormalPointer(GL_FLOAT, 0, (GLvoid*)(sizeof(GLfloat) * part->nbvertices * 3));
+        glTexCoordPointer(2, GL_FLOAT, 0, (GLvoid*)(sizeof(GLfloat) * part->nbvertices * 6));
+    }
+    else
+    {
+        /*client side arrays*/
+        if (openglHasBuffers())
+        {
+            openglBindBuffer(GL_ARRAY_BUFFER_ARB, 0);
+            openglBindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+        }
+        glVertexPointer(3, GL_FLOAT, 0, part->data);
+        glNormalPointer(GL_FLOAT, 0, part->data + part->nbvertices * 3);
+        glTexCoordPointer(2, GL_FLOAT, 0, part->data + part->nbvertices * 6);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*Arrays must be set for this part*/
+static void
+drawElements(GlMeshPart part)
+{
+    if (part->vbo != 0)
+    {
+        glDrawElements(GL_TRIANGLES, part->nbindices, GL_UNSIGNED_INT, (GLvoid*)0);
+    }
+    else
+    {
+        glDrawElements(GL_TRIANGLES, part->nbindices, GL_UNSIGNED_INT, part->indices);
+    }
+    openglCount(part->nbindices / 3);
+}
+
+/*----------------------------------------------------------------------------*/
+/*Sort key: pass (blended parts last), texture, shading model then culling*/
+static Uint32
+makeKey(GlMeshPart part)
+{
+    Uint32 ret;
+
+    ret = (GlStaticTexture_getId(part->tex) & 0x0FFFFFFF) << 3;
+    if (part->blended)
+    {
+        ret |= 0x80000000;
+    }
+    if (part->shademode == GL_SMOOTH)
+    {
+        ret |= 4;
+    }
+    if (!part->twosided)
+    {
+        ret |= 2;
+    }
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Records of the same part are kept together to share the arrays setup*/
+static int
+cmpRecords(const void* p1, const void* p2)
+{
+    const RenderRecord* r1 = *(const RenderRecord**)p1;
+    const RenderRecord* r2 = *(const RenderRecord**)p2;
+
+    if (r1->key != r2->key)
+    {
+        return (r1->key < r2->key) ? -1 : 1;
+    }
+    if (r1->part != r2->part)
+    {
+        return (r1->part < r2->part) ? -1 : 1;
+    }
+    return (r1->seq < r2->seq) ? -1 : ((r1->seq > r2->seq) ? 1 : 0);
+}
+
 /*----------------------------------------------------------------------------*/
 static void
 GlMeshPart_setFromVar(GlMeshPart part, Var var)
@@ -426,6 +635,8 @@ GlMeshPart_setFromVar(GlMeshPart part, Var var)
         FREE(texc);
     }
     shellPopErrorStack();
+
+    GlMeshPart_buildIndexed(part);
 }
 
 /******************************************************************************
@@ -441,26 +652,118 @@ GlMeshPart_new(Var v)
     ret = (GlMeshPart)MALLOC(sizeof(pv_GlMeshPart));
     ret->nbtriangles = 0;
     ret->nbquads = 0;
+    ret->nbvertices = 0;
+    ret->nbindices = 0;
+    ret->vbo = 0;
+    ret->ibo = 0;
+    ret->buffersgen = 0;
     GlMeshPart_setFromVar(ret, v);
     
     return ret;
 }
 
 /*----------------------------------------------------------------------------*/
-void
-GlMeshPart_del(GlMeshPart part)
+GlMeshPart
+GlMeshPart_newMerged(GlMeshPart* parts, GlMeshInstance* places, Uint32 nb)
 {
-    if (part->nbtriangles != 0)
+    GlMeshPart ret;
+    GLfloat* vert;
+    GLfloat* norm;
+    GLfloat* texc;
+    GLuint* ind;
+    GlMeshPart src;
+    Uint32 i;
+    unsigned int j, base;
+    GLfloat c, s;
+
+    ASSERT(nb > 0, return NULL);
+
+    ret = (GlMeshPart)MALLOC(sizeof(pv_GlMeshPart));
+    ret->shademode = parts[0]->shademode;
+    ret->blended = parts[0]->blended;
+    ret->twosided = parts[0]->twosided;
+    ret->tex = parts[0]->tex;
+    ret->nbvertices = 0;
+    ret->nbindices = 0;
+    ret->vbo = 0;
+    ret->ibo = 0;
+    ret->buffersgen = 0;
+    for (i = 0; i < nb; i++)
     {
-        FREE(part->vertices3);
-        FREE(part->texcoords3);
-        FREE(part->normals3);
+        ret->nbvertices += parts[i]->nbvertices;
+        ret->nbindices += parts[i]->nbindices;
     }
-    if (part->nbquads != 0)
+    ret->nbtriangles = ret->nbindices / 3;
+    ret->nbquads = 0;
+    if (ret->nbvertices == 0)
     {
-        FREE(part->vertices4);
-        FREE(part->texcoords4);
-        FREE(part->normals4);
+        return ret;
+    }
+
+    ret->data = MALLOC(sizeof(GLfloat) * ret->nbvertices * 8);
+    ret->indices = MALLOC(sizeof(GLuint) * ret->nbindices);
+    vert = ret->data;
+    norm = ret->data + ret->nbvertices * 3;
+    texc = ret->data + ret->nbvertices * 6;
+    ind = ret->indices;
+    base = 0;
+    for (i = 0; i < nb; i++)
+    {
+        src = parts[i];
+        if (src->nbvertices == 0)
+        {
+            continue;
+        }
+
+        /*same transformation as cameraPushObject (without vertical angle)*/
+        c = cos(-places[i].angh);
+        s = sin(-places[i].angh);
+        for (j = 0; j < src->nbvertices; j++)
+        {
+            GLfloat* sv = src->data + j * 3;
+            GLfloat* sn = src->data + src->nbvertices * 3 + j * 3;
+
+            vert[0] = c * sv[0] + s * sv[2] + places[i].x;
+            vert[1] = sv[1] + places[i].y;
+            vert[2] = -s * sv[0] + c * sv[2] + places[i].z;
+            norm[0] = c * sn[0] + s * sn[2];
+            norm[1] = sn[1];
+            norm[2] = -s * sn[0] + c * sn[2];
+            vert += 3;
+            norm += 3;
+        }
+        memCOPY(texc, src->data + src->nbvertices * 6, sizeof(GLfloat) * src->nbvertices * 2);
+        texc += src->nbvertices * 2;
+        for (j = 0; j < src->nbindices; j++)
+        {
+            *ind++ = src->indices[j] + base;
+        }
+        base += src->nbvertices;
+    }
+
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+GlMeshPart_isCompatible(GlMeshPart part1, GlMeshPart part2)
+{
+    return (part1->tex == part2->tex) && (part1->shademode == part2->shademode) && (part1->blended == part2->blended) && (part1->twosided == part2->twosided);
+}
+
+/*----------------------------------------------------------------------------*/
+void
+GlMeshPart_del(GlMeshPart part)
+{
+    if (part->nbvertices != 0)
+    {
+        if ((part->vbo != 0) && (part->buffersgen == openglBuffersGeneration()))
+        {
+            openglDeleteBuffer(part->vbo);
+            openglDeleteBuffer(part->ibo);
+        }
+        FREE(part->data);
+        FREE(part->indices);
     }
     FREE(part);
 }
@@ -469,40 +772,119 @@ GlMeshPart_del(GlMeshPart part)
 void
 GlMeshPart_draw(GlMeshPart part)
 {
-    if (part->twosided)
+    setState(part);
+
+    if (part->nbindices == 0)
     {
-        glDisable(GL_CULL_FACE);
+        return;
     }
-    else
+
+    setArrays(part);
+    drawElements(part);
+}
+
+/******************************************************************************
+ *############################################################################*
+ *#                           Render queue functions                         #*
+ *############################################################################*
+ ******************************************************************************/
+void
+GlMeshPart_beginQueue(void)
+{
+    _queuing = TRUE;
+    _nbrecords = 0;
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+GlMeshPart_isQueuing(void)
+{
+    return _queuing;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+GlMeshPart_queue(GlMeshPart part, const Float* matrix, const Float* color)
+{
+    RenderRecord* rec;
+
+    ASSERT(_queuing, return);
+
+    if (part->nbindices == 0)
     {
-        glEnable(GL_CULL_FACE);
+        /*nothing to draw, the state would not be used*/
+        return;
     }
-    if (global_forceblend || part->blended)
+
+    if (_nbrecords == _allocrecords)
     {
-        glEnable(GL_BLEND);
-        glDepthMask(GL_FALSE);
+        _allocrecords = (_allocrecords == 0) ? 256 : _allocrecords * 2;
+        _records = REALLOC(_records, sizeof(RenderRecord) * _allocrecords);
+        _sorted = REALLOC(_sorted, sizeof(RenderRecord*) * _allocrecords);
     }
-    else
+
+    rec = _records + _nbrecords;
+    rec->key = makeKey(part);
+    rec->seq = _nbrecords;
+    rec->part = part;
+    memCOPY(rec->matrix, matrix, sizeof(GLfloat) * 16);
+    memCOPY(rec->color, color, sizeof(GLfloat) * 4);
+    _nbrecords++;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+GlMeshPart_flushQueue(void)
+{
+    RenderRecord* rec;
+    GlMeshPart last;
+    Uint32 i;
+
+    _queuing = FALSE;
+    if (_nbrecords == 0)
     {
-        glDisable(GL_BLEND);
-        glDepthMask(GL_TRUE);
+        return;
     }
-    GlStaticTexture_use(part->tex);
-    glShadeModel(part->shademode);
-    if (part->nbtriangles != 0)
+
+    for (i = 0; i < _nbrecords; i++)
     {
-        glVertexPointer(3, GL_FLOAT, 0, part->vertices3);
-        glNormalPointer(GL_FLOAT, 0, part->normals3);
-        glTexCoordPointer(2, GL_FLOAT, 0, part->texcoords3);
-        glDrawArrays(GL_TRIANGLES, 0, part->nbtriangles * 3);
-        openglCount(part->nbtriangles);
+        _sorted[i] = _records + i;
     }
-    if (part->nbquads != 0)
+    qsort(_sorted, _nbrecords, sizeof(RenderRecord*), cmpRecords);
+
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    last = NULL;
+    for (i = 0; i < _nbrecords; i++)
+    {
+        rec = _sorted[i];
+        setState(rec->part);
+        glLoadMatrixf(rec->matrix);
+        openglSetColor(rec->color);
+        if (rec->part != last)
+        {
+            setArrays(rec->part);
+            last = rec->part;
+        }
+        drawElements(rec->part);
+    }
+    glPopMatrix();
+
+    _nbrecords = 0;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+GlMeshPart_freeQueue(void)
+{
+    if (_allocrecords != 0)
     {
-        glVertexPointer(3, GL_FLOAT, 0, part->vertices4);
-        glNormalPointer(GL_FLOAT, 0, part->normals4);
-        glTexCoordPointer(2, GL_FLOAT, 0, part->texcoords4);
-        glDrawArrays(GL_QUADS, 0, part->nbquads * 4);
-        openglCount(part->nbquads);
+        FREE(_records);
+        FREE(_sorted);
+        _records = NULL;
+        _sorted = NULL;
+        _allocrecords = 0;
     }
+    _nbrecords = 0;
+    _queuing = FALSE;
 }
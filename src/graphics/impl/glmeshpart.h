@@ -42,6 +42,7 @@
 #include "main.h"
 #include "core/types.h"
 #include "graphics/types.h"
+#include "graphics/glmesh.h"
 
 /******************************************************************************
  *                                  Typedefs                                  *
@@ -68,6 +69,27 @@ typedef pv_GlMeshPart* GlMeshPart;
  */
 GlMeshPart GlMeshPart_new(Var var);
 
+/*!
+ * \brief Create a new mesh part by merging placed parts.
+ *
+ * Rendering properties are taken from the first part, all parts should be
+ * compatible (see GlMeshPart_isCompatible).
+ * \param parts - Array of parts to merge.
+ * \param places - Placement of each part (the 'mesh' field is not used).
+ * \param nb - Number of parts.
+ * \return The newly allocated mesh part.
+ */
+GlMeshPart GlMeshPart_newMerged(GlMeshPart* parts, GlMeshInstance* places, Uint32 nb);
+
+/*!
+ * \brief Check if two parts can be merged.
+ *
+ * \param part1 - First mesh part.
+ * \param part2 - Second mesh part.
+ * \return TRUE if both parts share the same rendering properties.
+ */
+Bool GlMeshPart_isCompatible(GlMeshPart part1, GlMeshPart part2);
+
 /*!
  * \brief Destroy a mesh part.
  *
@@ -84,4 +106,47 @@ void GlMeshPart_del(GlMeshPart part);
  */
 void GlMeshPart_draw(GlMeshPart part);
 
+/******************************************************************************
+ *############################################################################*
+ *#                           Render queue functions                         #*
+ *############################################################################*
+ ******************************************************************************/
+/*!
+ * \brief Start collecting mesh parts draws into the frame render queue.
+ *
+ * \mainthread
+ */
+void GlMeshPart_beginQueue(void);
+
+/*!
+ * \brief Tell if mesh parts draws are currently queued.
+ *
+ * \return TRUE between GlMeshPart_beginQueue and GlMeshPart_flushQueue.
+ */
+Bool GlMeshPart_isQueuing(void);
+
+/*!
+ * \brief Add a mesh part draw to the render queue.
+ *
+ * \param part - The mesh part.
+ * \param matrix - Modelview matrix to draw the part with.
+ * \param color - RGBA color of the part.
+ */
+void GlMeshPart_queue(GlMeshPart part, const Float* matrix, const Float* color);
+
+/*!
+ * \brief Draw all queued mesh parts and stop queuing.
+ *
+ * Draws are sorted by render state (pass, texture, shading, culling) so that
+ * redundant state changes are skipped, the submission order is kept among
+ * draws sharing the same state.
+ * \mainthread
+ */
+void GlMeshPart_flushQueue(void);
+
+/*!
+ * \brief Free the render queue memory.
+ */
+void GlMeshPart_freeQueue(void);
+
 #endif
@@ -40,8 +40,14 @@
 #include "tools/fonct.h"
 
 #include "SDL_image.h"
+#include "SDL_cpuinfo.h"
+#ifdef HAVE_TARGET_SSE2
+    #include <emmintrin.h>
+    #define GLSURFACE_SSE2 1
+#endif
 
 #include "graphics/impl/opengl.h"   /*for GLU*/
+#include "graphics/impl/impl.h"
 
 /******************************************************************************
  *                                  Typedefs                                  *
@@ -52,8 +58,25 @@ struct pv_GlSurface
     GlRect rct;             /*Surface rectangle (0,0,w,h).*/
     GlColor* pixels;        /*Pointer to pixels data.*/
     Uint32 lineskip;        /*Number of GlColor on a line.*/
+    Uint16 nbdirty;         /*Number of dirty rectangles.*/
+    GlRect dirty[GLSURFACE_DIRTY_NB];   /*Areas changed since the last GlSurface_takeDirty.*/
 };
 
+/*Pixel kernels, working on spans of pixels*/
+typedef struct
+{
+    const char* name;
+    void (*fill)(GlColor* dest, Uint32 nb, GlColor col);                /*Solid fill.*/
+    void (*recolor)(GlColor* pixels, Uint32 nb, GlColor col, GlColor keep);  /*Replace the bits outside 'keep' by those of col.*/
+    void (*blend)(GlColor* dest, const GlColor* src, Uint32 nb);        /*Straight alpha blending, keeping the destination alpha.*/
+} GlPixelKernels;
+
+/******************************************************************************
+ *                             Static variables                               *
+ ******************************************************************************/
+static CoreID MOD_ID = CORE_INVALID_ID;
+static CoreID FUNC_SIMD = CORE_INVALID_ID;
+
 /******************************************************************************
  *############################################################################*
  *#                             Private functions                            #*
@@ -125,11 +148,437 @@ prodCode(Bool codestart[], Bool codeend[])
     return ret;
 }
 
+/*----------------------------------------------------------------------------*/
+static void
+fillScalar(GlColor* dest, Uint32 nb, GlColor col)
+{
+    while (nb-- > 0)
+    {
+        *dest++ = col;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+recolorScalar(GlColor* pixels, Uint32 nb, GlColor col, GlColor keep)
+{
+    col &= ~keep;
+    while (nb-- > 0)
+    {
+        *pixels = (*pixels & keep) | col;
+        pixels++;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*Same results as the SDL per-pixel alpha blitter (alpha in the high byte)*/
+static void
+blendScalar(GlColor* dest, const GlColor* src, Uint32 nb)
+{
+    Uint32 s, d, s1, d1, alpha;
+    
+    while (nb-- > 0)
+    {
+        s = *src++;
+        alpha = s >> 24;
+        if (alpha == 0xFF)
+        {
+            *dest = (s & 0x00FFFFFF) | (*dest & 0xFF000000);
+        }
+        else if (alpha != 0)
+        {
+            /*red and blue are processed together*/
+            d = *dest;
+            s1 = s & 0x00FF00FF;
+            d1 = d & 0x00FF00FF;
+            d1 = (d1 + ((s1 - d1) * alpha >> 8)) & 0x00FF00FF;
+            s &= 0x0000FF00;
+            d1 |= (((d & 0x0000FF00) + ((s - (d & 0x0000FF00)) * alpha >> 8)) & 0x0000FF00);
+            *dest = d1 | (d & 0xFF000000);
+        }
+        dest++;
+    }
+}
+
+#ifdef GLSURFACE_SSE2
+/*----------------------------------------------------------------------------*/
+static TARGET_SSE2 void
+fillSSE2(GlColor* dest, Uint32 nb, GlColor col)
+{
+    __m128i c;
+    
+    /*align the destination*/
+    while ((nb > 0) && (((size_t)dest & 15) != 0))
+    {
+        *dest++ = col;
+        nb--;
+    }
+    
+    c = _mm_set1_epi32((int)col);
+    for (; nb >= 4; nb -= 4, dest += 4)
+    {
+        _mm_store_si128((__m128i*)dest, c);
+    }
+    
+    fillScalar(dest, nb, col);
+}
+
+/*----------------------------------------------------------------------------*/
+static TARGET_SSE2 void
+recolorSSE2(GlColor* pixels, Uint32 nb, GlColor col, GlColor keep)
+{
+    __m128i c, k;
+    
+    c = _mm_set1_epi32((int)(col & ~keep));
+    k = _mm_set1_epi32((int)keep);
+    for (; nb >= 4; nb -= 4, pixels += 4)
+    {
+        _mm_storeu_si128((__m128i*)pixels, _mm_or_si128(_mm_and_si128(_mm_loadu_si128((__m128i*)pixels), k), c));
+    }
+    
+    recolorScalar(pixels, nb, col, keep);
+}
+
+/*----------------------------------------------------------------------------*/
+/*32-bit multiplication by a byte (duplicated in both 16-bit halves), modulo 2^32 like the scalar code*/
+static TARGET_SSE2 __m128i
+mulAlphaSSE2(__m128i x, __m128i alpha)
+{
+    return _mm_add_epi32(_mm_mullo_epi16(x, alpha), _mm_slli_epi32(_mm_mulhi_epu16(x, alpha), 16));
+}
+
+/*----------------------------------------------------------------------------*/
+static TARGET_SSE2 void
+blendSSE2(GlColor* dest, const GlColor* src, Uint32 nb)
+{
+    __m128i s, d, alpha, opaque, rb, d1, g, d2;
+    __m128i mrb, mg, ma, full;
+    
+    mrb = _mm_set1_epi32(0x00FF00FF);
+    mg = _mm_set1_epi32(0x0000FF00);
+    ma = _mm_set1_epi32((int)0xFF000000);
+    full = _mm_set1_epi32(0xFF);
+    
+    for (; nb >= 4; nb -= 4, src += 4, dest += 4)
+    {
+        s = _mm_loadu_si128((__m128i*)src);
+        d = _mm_loadu_si128((__m128i*)dest);
+        alpha = _mm_srli_epi32(s, 24);
+        opaque = _mm_cmpeq_epi32(alpha, full);
+        alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16));
+        
+        /*red and blue*/
+        d1 = _mm_and_si128(d, mrb);
+        rb = mulAlphaSSE2(_mm_sub_epi32(_mm_and_si128(s, mrb), d1), alpha);
+        d1 = _mm_and_si128(_mm_add_epi32(d1, _mm_srli_epi32(rb, 8)), mrb);
+        
+        /*green*/
+        d2 = _mm_and_si128(d, mg);
+        g = mulAlphaSSE2(_mm_sub_epi32(_mm_and_si128(s, mg), d2), alpha);
+        d2 = _mm_and_si128(_mm_add_epi32(d2, _mm_srli_epi32(g, 8)), mg);
+        
+        /*transparent pixels give back the destination, opaque ones are copied*/
+        d1 = _mm_or_si128(_mm_or_si128(d1, d2), _mm_and_si128(d, ma));
+        s = _mm_or_si128(_mm_andnot_si128(ma, s), _mm_and_si128(d, ma));
+        _mm_storeu_si128((__m128i*)dest, _mm_or_si128(_mm_and_si128(opaque, s), _mm_andnot_si128(opaque, d1)));
+    }
+    
+    blendScalar(dest, src, nb);
+}
+#endif
+
+/*----------------------------------------------------------------------------*/
+static const GlPixelKernels _kernelsscalar = {"scalar", fillScalar, recolorScalar, blendScalar};
+#ifdef GLSURFACE_SSE2
+static const GlPixelKernels _kernelssse2 = {"SSE2", fillSSE2, recolorSSE2, blendSSE2};
+#endif
+static const GlPixelKernels* _kernels = &_kernelsscalar;
+
+/*----------------------------------------------------------------------------*/
+/*Fill a rectangle, clipped to the surface*/
+static void
+fillArea(GlSurface surf, GlRect rct, GlColor col)
+{
+    GlColor* pos;
+    int x1, y1, x2, y2;
+    
+    /*GlRect_clip doesn't like sizes that wrapped around*/
+    x1 = MAX(rct.x, 0);
+    y1 = MAX(rct.y, 0);
+    x2 = MIN(rct.x + rct.w, surf->rct.w);
+    y2 = MIN(rct.y + rct.h, surf->rct.h);
+    if ((x2 <= x1) || (y2 <= y1))
+    {
+        return;
+    }
+    
+    pos = surf->pixels + y1 * surf->lineskip + x1;
+    if ((Uint32)(x2 - x1) == surf->lineskip)
+    {
+        _kernels->fill(pos, (Uint32)(x2 - x1) * (y2 - y1), col);
+        return;
+    }
+    for (; y1 < y2; y1++)
+    {
+        _kernels->fill(pos, x2 - x1, col);
+        pos += surf->lineskip;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*Repeat a span of pixels along a line, copies grow by doubling*/
+static void
+tileSpan(GlColor* dest, Uint32 nb, const GlColor* src, Uint32 srcnb)
+{
+    Uint32 done;
+    
+    done = MIN(nb, srcnb);
+    memCOPY(dest, src, sizeof(GlColor) * done);
+    
+    /*the part already copied holds whole tiles*/
+    while (done < nb)
+    {
+        srcnb = MIN(done, nb - done);
+        memCOPY(dest + done, dest, sizeof(GlColor) * srcnb);
+        done += srcnb;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*Clip a blit the way SDL_BlitSurface does, returns FALSE if nothing is left*/
+static Bool
+clipBlit(GlSurface src, GlSurface dest, GlRect* srcrect, GlRect* destrect)
+{
+    int sx, sy, dx, dy, w, h;
+    
+    sx = srcrect->x;
+    sy = srcrect->y;
+    w = srcrect->w;
+    h = srcrect->h;
+    dx = destrect->x;
+    dy = destrect->y;
+    
+    if (sx < 0)
+    {
+        w += sx;
+        dx -= sx;
+        sx = 0;
+    }
+    if (sy < 0)
+    {
+        h += sy;
+        dy -= sy;
+        sy = 0;
+    }
+    w = MIN(w, src->rct.w - sx);
+    h = MIN(h, src->rct.h - sy);
+    
+    if (dx < 0)
+    {
+        w += dx;
+        sx -= dx;
+        dx = 0;
+    }
+    if (dy < 0)
+    {
+        h += dy;
+        sy -= dy;
+        dy = 0;
+    }
+    w = MIN(w, dest->rct.w - dx);
+    h = MIN(h, dest->rct.h - dy);
+    
+    if ((w <= 0) || (h <= 0))
+    {
+        return FALSE;
+    }
+    GlRect_MAKE(*srcrect, sx, sy, w, h);
+    GlRect_MAKE(*destrect, dx, dy, w, h);
+    return TRUE;
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+shellCallback(ShellFunction* func)
+{
+    if (func->id == FUNC_SIMD)
+    {
+        _kernels = &_kernelsscalar;
+#ifdef GLSURFACE_SSE2
+        if ((Var_getValueInt(func->params[0]) != 0) && SDL_HasSSE2())
+        {
+            _kernels = &_kernelssse2;
+        }
+#endif
+        Var_setVoid(func->ret);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*Add an area to the dirty rectangles, clipped to the surface*/
+static void
+markDirty(GlSurface surf, int x, int y, int w, int h)
+{
+    GlRect* r;
+    GlRect* best;
+    int x2, y2, rx2, ry2;
+    long grow, bestgrow;
+    Uint16 i;
+
+    x2 = MIN(x + w, surf->rct.w);
+    y2 = MIN(y + h, surf->rct.h);
+    x = MAX(x, 0);
+    y = MAX(y, 0);
+    if ((x >= x2) || (y >= y2))
+    {
+        return;
+    }
+
+    /*merge with an overlapping or touching rectangle*/
+    for (i = 0; i < surf->nbdirty; i++)
+    {
+        r = surf->dirty + i;
+        rx2 = r->x + r->w;
+        ry2 = r->y + r->h;
+        if ((x <= rx2) && (x2 >= r->x) && (y <= ry2) && (y2 >= r->y))
+        {
+            break;
+        }
+    }
+
+    if ((i == surf->nbdirty) && (surf->nbdirty < GLSURFACE_DIRTY_NB))
+    {
+        GlRect_MAKE(surf->dirty[surf->nbdirty], x, y, x2 - x, y2 - y);
+        surf->nbdirty++;
+        return;
+    }
+
+    if (i == surf->nbdirty)
+    {
+        /*no room left, grow the rectangle that grows the least*/
+        best = surf->dirty;
+        bestgrow = -1;
+        for (i = 0; i < surf->nbdirty; i++)
+        {
+            r = surf->dirty + i;
+            grow = (long)(MAX(x2, r->x + r->w) - MIN(x, r->x)) * (long)(MAX(y2, r->y + r->h) - MIN(y, r->y)) - (long)r->w * (long)r->h;
+            if ((bestgrow < 0) || (grow < bestgrow))
+            {
+                best = r;
+                bestgrow = grow;
+            }
+        }
+        r = best;
+    }
+    else
+    {
+        r = surf->dirty + i;
+    }
+
+    rx2 = MAX(x2, r->x + r->w);
+    ry2 = MAX(y2, r->y + r->h);
+    r->x = MIN(x, r->x);
+    r->y = MIN(y, r->y);
+    r->w = rx2 - r->x;
+    r->h = ry2 - r->y;
+}
+
 /******************************************************************************
  *############################################################################*
  *#                             Internal functions                           #*
  *############################################################################*
  ******************************************************************************/
+void
+glsurfaceInit(void)
+{
+    /*choose the pixel kernels*/
+    _kernels = &_kernelsscalar;
+#ifdef GLSURFACE_SSE2
+    if (SDL_HasSSE2())
+    {
+        _kernels = &_kernelssse2;
+    }
+#endif
+    if (glsurfaceCheckKernels() != 0)
+    {
+        shellPrintf(LEVEL_ERROR, "Surface kernels '%s' differ from the scalar ones, not used.", _kernels->name);
+        _kernels = &_kernelsscalar;
+    }
+    shellPrintf(LEVEL_INFO, " -> surface kernels: %s", _kernels->name);
+
+    MOD_ID = coreDeclareModule("surf", NULL, NULL, shellCallback, NULL, NULL, NULL);
+    FUNC_SIMD = coreDeclareShellFunction(MOD_ID, "simd", VAR_VOID, 1, VAR_INT);
+}
+
+/*----------------------------------------------------------------------------*/
+Uint32
+glsurfaceCheckKernels(void)
+{
+    GlColor ref[67 + 3];
+    GlColor test[67 + 3];
+    GlColor src[67 + 3];
+    GlColor col;
+    Uint32 nb, i, offset;
+    Uint32 diff = 0;
+    
+    for (nb = 0; nb <= 67; nb++)
+    {
+        for (offset = 0; offset < 4; offset++)
+        {
+            for (i = 0; i < nb + 3; i++)
+            {
+                ref[i] = test[i] = ((GlColor)rnd(0, 0x10000) << 16) | (GlColor)rnd(0, 0x10000);
+                src[i] = ((GlColor)rnd(0, 0x10000) << 16) | (GlColor)rnd(0, 0x10000);
+                if ((i & 3) == 0)
+                {
+                    /*keep some opaque and transparent pixels*/
+                    src[i] |= 0xFF000000;
+                }
+                else if ((i & 3) == 1)
+                {
+                    src[i] &= 0x00FFFFFF;
+                }
+            }
+            col = src[offset];
+            
+            blendScalar(ref + offset, src, nb);
+            _kernels->blend(test + offset, src, nb);
+            recolorScalar(ref + 1, nb, col, GlColor_Amask);
+            _kernels->recolor(test + 1, nb, col, GlColor_Amask);
+            fillScalar(ref + 3, nb / 2, col);
+            _kernels->fill(test + 3, nb / 2, col);
+            for (i = 0; i < nb + 3; i++)
+            {
+                diff += (ref[i] != test[i]);
+            }
+            
+            /*tiled copies, the reference repeats the source pixel by pixel; offset + 1 >= nb is a plain copy*/
+            for (i = 0; i < nb; i++)
+            {
+                ref[i] = src[i % (offset + 1)];
+                test[i] = 0;
+            }
+            tileSpan(test, nb, src, offset + 1);
+            for (i = 0; i < nb; i++)
+            {
+                diff += (ref[i] != test[i]);
+            }
+        }
+    }
+    
+    /*whole tile spans*/
+    for (nb = 1; nb <= 67; nb++)
+    {
+        tileSpan(test, 67, src, nb);
+        for (i = 0; i < 67; i++)
+        {
+            diff += (test[i] != src[i % nb]);
+        }
+    }
+    return diff;
+}
+
+/*----------------------------------------------------------------------------*/
 void 
 GlSurface_initIterator(GlSurface surf, GlIterator* it)
 {
@@ -145,6 +594,22 @@ GlSurface_getSDLSurface(GlSurface surf)
     return surf->surf;
 }
 
+/*----------------------------------------------------------------------------*/
+void
+GlSurface_recolor(GlSurface surf, GlColor col, GlColor keep)
+{
+    GlColor* pos;
+    Uint16 y;
+    
+    pos = surf->pixels;
+    for (y = 0; y < surf->rct.h; y++)
+    {
+        _kernels->recolor(pos, surf->rct.w, col, keep);
+        pos += surf->lineskip;
+    }
+    markDirty(surf, 0, 0, surf->rct.w, surf->rct.h);
+}
+
 /******************************************************************************
  *############################################################################*
  *#                            GlSurface functions                           #*
@@ -205,6 +670,7 @@ GlSurface GlSurface_new(Gl2DSize width, Gl2DSize height, Bool alpha)
     GlRect_MAKE(ret->rct, 0, 0, width, height);
     ret->pixels = surfconv->pixels;
     ret->lineskip = surfconv->pitch / surfconv->format->BytesPerPixel;
+    ret->nbdirty = 0;
     
     return ret;
 }
@@ -255,6 +721,7 @@ GlSurface_newFromFile(String imagefile)
     ret->surf = (SDL_Surface*)debugALLOC(surfconv, sizeof(GlColor) * ret->rct.w * ret->rct.h + sizeof(SDL_Surface));
     ret->pixels = surfconv->pixels;
     ret->lineskip = surfconv->pitch / surfconv->format->BytesPerPixel;
+    ret->nbdirty = 0;
     
     String_del(file);
     return ret;
@@ -300,6 +767,8 @@ GlSurface_resize(GlSurface surf, Gl2DSize w, Gl2DSize h, GlSurfaceResizeMode mod
     surf->rct.h = h;
     surf->pixels = newsurf->pixels;
     surf->lineskip = newsurf->pitch / newsurf->format->BytesPerPixel;
+    surf->nbdirty = 0;
+    markDirty(surf, 0, 0, w, h);
     
     /*delete the old surface*/
     SDL_FreeSurface((SDL_Surface*)debugFREE(oldsurf));
@@ -389,7 +858,43 @@ GlSurface_getColor(GlSurface surf, Gl2DCoord x, Gl2DCoord y)
 void
 GlSurface_clear(GlSurface surface, GlColor color)
 {
-    SDL_FillRect(surface->surf, NULL, color);
+    fillArea(surface, surface->rct, color);
+    surface->nbdirty = 0;
+    markDirty(surface, 0, 0, surface->rct.w, surface->rct.h);
+}
+
+/*----------------------------------------------------------------------------*/
+void
+GlSurface_setDirty(GlSurface surf, GlRect* rect)
+{
+    if (rect == NULL)
+    {
+        markDirty(surf, 0, 0, surf->rct.w, surf->rct.h);
+    }
+    else
+    {
+        markDirty(surf, rect->x, rect->y, rect->w, rect->h);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+Uint16
+GlSurface_getDirty(GlSurface surf, GlRect* rects)
+{
+    memCOPY(rects, surf->dirty, sizeof(GlRect) * surf->nbdirty);
+    return surf->nbdirty;
+}
+
+/*----------------------------------------------------------------------------*/
+Uint16
+GlSurface_takeDirty(GlSurface surf, GlRect* rects)
+{
+    Uint16 ret;
+
+    ret = surf->nbdirty;
+    memCOPY(rects, surf->dirty, sizeof(GlRect) * ret);
+    surf->nbdirty = 0;
+    return ret;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -405,6 +910,7 @@ GlSurface_drawPixel(GlSurface surf, Gl2DCoord x, Gl2DCoord y, GlColor col)
 
     pos = surf->pixels + y * surf->lineskip + x;
     *pos = col;
+    markDirty(surf, x, y, 1, 1);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -417,6 +923,7 @@ GlSurface_drawPixelSecure(GlSurface surf, Gl2DCoord x, Gl2DCoord y, GlColor col)
     {
         pos = surf->pixels + y * surf->lineskip + x;
         *pos = col;
+        markDirty(surf, x, y, 1, 1);
     }
 }
 
@@ -429,7 +936,8 @@ GlSurface_drawRect(GlSurface surf, GlRect rct, GlColor colfill)
     ASSERT(rct.x + rct.w <= surf->rct.w, return);
     ASSERT(rct.y + rct.h <= surf->rct.h, return);
     
-    SDL_FillRect(surf->surf, &rct, colfill);
+    fillArea(surf, rct, colfill);
+    markDirty(surf, rct.x, rct.y, rct.w, rct.h);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -439,16 +947,17 @@ GlSurface_drawBorderRect(GlSurface surf, GlRect rct, Gl2DSize border, GlColor co
     ASSERT(rct.x + rct.w <= surf->rct.w, return);
     ASSERT(rct.y + rct.h <= surf->rct.h, return);
     
+    markDirty(surf, rct.x, rct.y, rct.w, rct.h);
     if (border != 0)
     {
         /*TODO: test if border isn't too large*/
-        SDL_FillRect(surf->surf, &rct, colborder);
+        fillArea(surf, rct, colborder);
         rct.w -= 2 * border;
         rct.h -= 2 * border;
         rct.x += border;
         rct.y += border;
     }
-    SDL_FillRect(surf->surf, &rct, colfill);
+    fillArea(surf, rct, colfill);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -469,6 +978,8 @@ GlSurface_drawLine(GlSurface surf, Gl2DCoord x1, Gl2DCoord y1, Gl2DCoord x2, Gl2
     ASSERT(y1 < surf->rct.h, return);
     ASSERT(y2 < surf->rct.h, return);
 
+    markDirty(surf, MIN(x1, x2), MIN(y1, y2), iabs(x2 - x1) + 1, iabs(y2 - y1) + 1);
+
     dx = iabs(x2 - x1);
     dy = iabs(y2 - y1);
 
@@ -487,7 +998,7 @@ GlSurface_drawLine(GlSurface surf, Gl2DCoord x1, Gl2DCoord y1, Gl2DCoord x2, Gl2
         {
             if (d < 0)
             {
-                pos += sty * surf->lineskip;
+                pos += sty * (Sint32)surf->lineskip;
                 d += dxy;
             }
             else
@@ -514,7 +1025,7 @@ GlSurface_drawLine(GlSurface surf, Gl2DCoord x1, Gl2DCoord y1, Gl2DCoord x2, Gl2
             {
                 d -= dx;
             }
-            pos += sty * surf->lineskip;
+            pos += sty * (Sint32)surf->lineskip;
             *pos = col;
         }
     }
@@ -620,6 +1131,7 @@ GlSurface_drawCircle(GlSurface surf, Gl2DCoord centerx, Gl2DCoord centery, Gl2DS
     ASSERT(centerx + radius < surf->rct.w, return)
     ASSERT(centery + radius < surf->rct.h, return)
     
+    markDirty(surf, centerx - radius, centery - radius, 2 * radius + 1, 2 * radius + 1);
     x = 0;
     y = radius;
     d = 3 - 2 * radius;
@@ -702,6 +1214,11 @@ GlSurface_doBlit(GlSurface src, GlSurface dest, GlRect* srcrect, GlRect* destrec
 {
     GlRect srcrct;
     GlRect destrct;
+    SDL_PixelFormat* srcfmt;
+    SDL_PixelFormat* destfmt;
+    GlColor* psrc;
+    GlColor* pdest;
+    Uint16 y;
     
     if (srcrect != NULL)
     {
@@ -712,7 +1229,55 @@ GlSurface_doBlit(GlSurface src, GlSurface dest, GlRect* srcrect, GlRect* destrec
         destrct = *destrect;
     }
     
+    srcfmt = src->surf->format;
+    destfmt = dest->surf->format;
+    if ((srcfmt->Amask == 0xFF000000) && (srcfmt->Rmask == destfmt->Rmask) && (srcfmt->Gmask == destfmt->Gmask)
+        && (srcfmt->Bmask == destfmt->Bmask) && (srcfmt->Amask == destfmt->Amask) && ((src->surf->flags & SDL_SRCCOLORKEY) == 0))
+    {
+        /*same 32-bit format, blit it ourself*/
+        if (srcrect == NULL)
+        {
+            srcrct = src->rct;
+        }
+        if (destrect == NULL)
+        {
+            GlRect_MAKE(destrct, 0, 0, 0, 0);
+        }
+        if (!clipBlit(src, dest, &srcrct, &destrct))
+        {
+            return;
+        }
+        
+        psrc = src->pixels + srcrct.y * src->lineskip + srcrct.x;
+        pdest = dest->pixels + destrct.y * dest->lineskip + destrct.x;
+        for (y = 0; y < srcrct.h; y++)
+        {
+            if (src->surf->flags & SDL_SRCALPHA)
+            {
+                _kernels->blend(pdest, psrc, srcrct.w);
+            }
+            else
+            {
+                memCOPY(pdest, psrc, sizeof(GlColor) * srcrct.w);
+            }
+            psrc += src->lineskip;
+            pdest += dest->lineskip;
+        }
+        markDirty(dest, destrct.x, destrct.y, destrct.w, destrct.h);
+        return;
+    }
+    
     SDL_BlitSurface(src->surf, (srcrect == NULL) ? NULL : &srcrct, dest->surf, (destrect == NULL) ? NULL : &destrct);
+
+    /*SDL gives back the final blit rectangle*/
+    if (destrect != NULL)
+    {
+        markDirty(dest, destrct.x, destrct.y, destrct.w, destrct.h);
+    }
+    else
+    {
+        markDirty(dest, 0, 0, (srcrect == NULL) ? src->rct.w : srcrect->w, (srcrect == NULL) ? src->rct.h : srcrect->h);
+    }
 }
 
 /*----------------------------------------------------------------------------*/
@@ -734,6 +1299,7 @@ GlSurface_copyRect(GlSurface src, GlSurface dest, GlRect* srcrect, GlRect* destr
     ASSERT(GlIterator_getRect(itsrc).w == GlIterator_getRect(itdest).w, return);
     ASSERT(GlIterator_getRect(itsrc).h == GlIterator_getRect(itdest).h, return);
 
+    markDirty(dest, GlIterator_getRect(itdest).x, GlIterator_getRect(itdest).y, GlIterator_getRect(itdest).w, GlIterator_getRect(itdest).h);
     while (!GlIterator_endReached(itsrc))    /*rects should have same size*/
     {
         memCOPY(itdest.pos, itsrc.pos, (size_t)GlIterator_getLineSize(itsrc));
@@ -745,46 +1311,38 @@ GlSurface_copyRect(GlSurface src, GlSurface dest, GlRect* srcrect, GlRect* destr
 void
 GlSurface_copyRectTiled(GlSurface src, GlSurface dest, GlRect* srcrect, GlRect* destrect)
 {
-    GlRect overall_rectsrc;
-    GlRect overall_rectdest;
     GlRect rectsrc;
     GlRect rectdest;
-    Uint16 w;
+    Uint16 y;
+    
     if (srcrect == NULL)
     {
-        overall_rectsrc = src->rct;
+        rectsrc = src->rct;
     }
     else
     {
-        overall_rectsrc = *srcrect;
+        rectsrc = *srcrect;
+        GlRect_clip(&rectsrc, &src->rct);
     }
     if (destrect == NULL)
     {
-        overall_rectdest = dest->rct;
+        rectdest = dest->rct;
     }
     else
     {
-        overall_rectdest = *destrect;
+        rectdest = *destrect;
+        GlRect_clip(&rectdest, &dest->rct);
+    }
+    if ((rectsrc.w == 0) || (rectsrc.h == 0))
+    {
+        return;
     }
     
-    rectsrc.x = overall_rectsrc.x;
-    rectsrc.y = overall_rectsrc.y;
-    rectdest.y = overall_rectdest.y;
-    while (overall_rectdest.h > 0)
+    markDirty(dest, rectdest.x, rectdest.y, rectdest.w, rectdest.h);
+    for (y = 0; y < rectdest.h; y++)
     {
-        /*we tile a 'row'*/
-        w = overall_rectdest.w;
-        rectdest.x = overall_rectdest.x;
-        rectsrc.h = rectdest.h = MIN(overall_rectdest.h, overall_rectsrc.h);
-        while (w > 0)
-        {
-            rectsrc.w = rectdest.w = MIN(w, overall_rectsrc.w);
-            GlSurface_copyRect(src, dest, &rectsrc, &rectdest);
-            rectdest.x += rectdest.w;
-            w -= rectdest.w;
-        }
-        rectdest.y += rectdest.h;
-        overall_rectdest.h -= rectdest.h;
+        tileSpan(dest->pixels + (rectdest.y + y) * dest->lineskip + rectdest.x, rectdest.w,
+                 src->pixels + (rectsrc.y + y % rectsrc.h) * src->lineskip + rectsrc.x, rectsrc.w);
     }
 }
 
@@ -823,10 +1381,9 @@ GlSurface_copyRectSecure(GlSurface src, GlSurface dest, GlRect* srcrect, GlRect*
 void
 GlSurface_movePart(GlSurface surf, GlRect rct, Gl2DCoord dx, Gl2DCoord dy)
 {
-    Bool reverse;
-    GlRect destrct;
-    GlIterator itsrc;
-    GlIterator itdest;
+    GlColor* src;
+    GlColor* dest;
+    Uint16 y;
     
     ASSERT(rct.x >= 0, return);
     ASSERT(rct.y >= 0, return);
@@ -837,68 +1394,27 @@ GlSurface_movePart(GlSurface surf, GlRect rct, Gl2DCoord dx, Gl2DCoord dy)
     ASSERT(rct.x + rct.w + dx <= surf->rct.w, return);
     ASSERT(rct.y + rct.h + dy <= surf->rct.h, return);
     
-    destrct = rct;
-    destrct.x += dx;
-    destrct.y += dy;
-
-    if (dy > 0)
-    {
-        reverse = TRUE;
-    }
-    else if (dy < 0)
-    {
-        reverse = FALSE;
-    }
-    else    /*dy == 0*/
+    markDirty(surf, rct.x + dx, rct.y + dy, rct.w, rct.h);
+    if ((dx == 0) && (dy == 0))
     {
-        if (dx == 0)
-        {
-            return;
-        }
-        reverse = (dx > 0);
+        return;
     }
 
-    GlIterator_init(&itsrc, surf);
-    GlIterator_init(&itdest, surf);
-    GlIterator_setClipRect(&itsrc, &rct, (reverse) ? ((dy == 0) ? CORNER_BOTTOMRIGHT : CORNER_BOTTOMLEFT) : CORNER_TOPLEFT);
-    GlIterator_setClipRect(&itdest, &destrct, (reverse) ? ((dy == 0) ? CORNER_BOTTOMRIGHT : CORNER_BOTTOMLEFT) : CORNER_TOPLEFT);
-
-    if (reverse)
+    /*lines are moved from the side the movement goes to, memmove handles horizontal overlaps*/
+    src = surf->pixels + rct.y * surf->lineskip + rct.x;
+    dest = src + dy * (int)surf->lineskip + dx;
+    if (dy > 0)
     {
-        if (dy == 0)
+        for (y = rct.h; y > 0; y--)
         {
-            while (!GlIterator_endReached(itsrc))
-            {
-                *(itdest.pos) = *(itsrc.pos);
-                GlIterator_bwdCoupled(&itsrc, &itdest);
-            }
-        }
-        else
-        {
-            while (!GlIterator_endReached(itsrc))
-            {
-                memCOPY(itdest.pos, itsrc.pos, GlIterator_getLineSize(itsrc));
-                GlIterator_upCoupled(&itsrc, &itdest);
-            }
+            memmove(dest + (y - 1) * surf->lineskip, src + (y - 1) * surf->lineskip, sizeof(GlColor) * rct.w);
         }
     }
     else
     {
-        if (dy == 0)
-        {
-            while (!GlIterator_endReached(itsrc))
-            {
-                *(itdest.pos) = *(itsrc.pos);
-                GlIterator_fwdCoupled(&itsrc, &itdest);
-            }
-        }
-        else
+        for (y = 0; y < rct.h; y++)
         {
-            while (!GlIterator_endReached(itsrc))
-            {
-                memCOPY(itdest.pos, itsrc.pos, GlIterator_getLineSize(itsrc));
-                GlIterator_downCoupled(&itsrc, &itdest);
-            }
+            memmove(dest + y * surf->lineskip, src + y * surf->lineskip, sizeof(GlColor) * rct.w);
         }
     }
 }
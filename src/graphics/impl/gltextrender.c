@@ -39,18 +39,39 @@
 #include "tools/varvalidator.h"
 #include "tools/fonct.h"
 
+#include "graphics/impl/impl.h"
+
+#include "SDL_mutex.h"
+
+/******************************************************************************
+ *                                 Constants                                  *
+ ******************************************************************************/
+/*Number of tinted copies kept for each font*/
+#define GLFONT_TINTS_NB 4
+
+/*Number of entries in the text size cache*/
+#define GLTEXT_LAYOUTS_NB 64
+
 /******************************************************************************
  *                                  Typedefs                                  *
  ******************************************************************************/
+typedef struct
+{
+    GlSurface   surf;       /* Font surface filled with the color, NULL if unused. */
+    GlColor     color;      /* Color of the surface.                               */
+    Uint32      lastuse;    /* Font use counter at the last use.                   */
+} GlFontTint;
+
 typedef struct
 {
     String      name;       /* Font's name.                                   */
-    GlSurface   surf;       /* Graphical representation of the font.          */
+    GlSurface   surf;       /* Alpha mask of the font (black characters).     */
     Gl2DSize    w;          /* Normal size of a character.                    */
     Gl2DSize    h;          /* Normal size of a character.                    */
     Gl2DSize*   wcrop;      /* Horizontally cropped width of each character.  */
     Gl2DSize    wspacing;   /* Horizontal standard space size (between words).*/
-    GlColor     lastcolor;  /* Last color applied on the surface.             */
+    GlFontTint  tints[GLFONT_TINTS_NB]; /* Tinted copies of the font surface. */
+    Uint32      usecount;   /* Incremented each time a tint is asked.         */
 } pv_GlFont;
 
 typedef pv_GlFont* GlFont;
@@ -71,11 +92,23 @@ struct pv_GlTextRender
     Gl2DSize wlimit;        /* Width limit.                                     */
 };
 
+typedef struct
+{
+    String text;            /* Copy of the measured text, NULL if unused.       */
+    GlFont font;            /* Font used for the measure.                       */
+    Gl2DSize wlimit;        /* Width limit used for the measure.                */
+    Bool monospace;         /* Monospace option used for the measure.           */
+    Gl2DSize w;             /* Resulting width.                                 */
+    Gl2DSize h;             /* Resulting height.                                */
+} GlTextLayout;
+
 /******************************************************************************
  *                             Static variables                               *
  ******************************************************************************/
 static PtrArray _fonts;
 static PtrArray _textrenders;
+static GlTextLayout _layouts[GLTEXT_LAYOUTS_NB];
+static SDL_mutex* _cachelock;   /*guards the layouts and the fonts tints, as module threads measure texts*/
 
 /******************************************************************************
  *                             Static constants                               *
@@ -91,6 +124,7 @@ static void
 GlFont_del(GlFont font)
 {
     PtrArrayIterator it;
+    unsigned int i;
     
     /*check if any renderer is linked to this font*/
     for (it = PtrArray_START(_textrenders); it != PtrArray_STOP(_textrenders); it++)
@@ -101,13 +135,71 @@ GlFont_del(GlFont font)
         }
     }
     
+    /*forget the sizes measured with it*/
+    SDL_mutexP(_cachelock);
+    for (i = 0; i < GLTEXT_LAYOUTS_NB; i++)
+    {
+        if (_layouts[i].font == font)
+        {
+            _layouts[i].font = NULL;
+        }
+    }
+    
     /*delete*/
+    for (i = 0; i < GLFONT_TINTS_NB; i++)
+    {
+        if (font->tints[i].surf != NULL)
+        {
+            GlSurface_del(font->tints[i].surf);
+        }
+    }
+    SDL_mutexV(_cachelock);
     String_del(font->name);
     GlSurface_del(font->surf);
     FREE(font->wcrop);
     FREE(font);
 }
 
+/*----------------------------------------------------------------------------*/
+/*This function returns a copy of the font surface filled with the given color,
+keeping the last used colors to avoid refilling when a few colors alternate.
+The cache lock must be held as long as the returned surface is used*/
+static GlSurface
+GlFont_getTinted(GlFont font, GlColor col)
+{
+    GlFontTint* tint;
+    unsigned int i;
+    
+    font->usecount++;
+    
+    tint = font->tints;
+    for (i = 0; i < GLFONT_TINTS_NB; i++)
+    {
+        if ((font->tints[i].surf != NULL) && (font->tints[i].color == col))
+        {
+            font->tints[i].lastuse = font->usecount;
+            return font->tints[i].surf;
+        }
+        
+        /*free slot or least recently used one*/
+        if ((tint->surf != NULL) && ((font->tints[i].surf == NULL) || (font->tints[i].lastuse < tint->lastuse)))
+        {
+            tint = font->tints + i;
+        }
+    }
+    
+    /*fill the slot with the drawing color (without altering alpha channel)*/
+    if (tint->surf == NULL)
+    {
+        tint->surf = GlSurface_newByCopy(font->surf);
+    }
+    GlSurface_recolor(tint->surf, col, GlColor_Amask);
+    tint->color = col;
+    tint->lastuse = font->usecount;
+    
+    return tint->surf;
+}
+
 /*----------------------------------------------------------------------------*/
 static int
 GlFont_cmp(GlFont* font1, GlFont* font2)
@@ -163,7 +255,7 @@ performAutoCrop(GlFont font)
                 }
                 GlColor_SETA(col, channel);
                 
-                /*to respect the lastcolor attribute:*/
+                /*keep an alpha mask, tinted copies are made on demand*/
                 GlColor_SETR(col, 0x00);
                 GlColor_SETG(col, 0x00);
                 GlColor_SETB(col, 0x00);
@@ -183,7 +275,7 @@ performAutoCrop(GlFont font)
 /*----------------------------------------------------------------------------*/
 /*This function draws a single character*/
 static Gl2DSize
-drawChar(GlFont font, GlSurface surf, GlRect rect, Bool monospace, unsigned char c, Gl2DCoord offsetx, Gl2DCoord offsety)
+drawChar(GlFont font, GlSurface tinted, GlSurface surf, GlRect rect, Bool monospace, unsigned char c, Gl2DCoord offsetx, Gl2DCoord offsety)
 {
     GlRect src;
     
@@ -204,7 +296,7 @@ drawChar(GlFont font, GlSurface surf, GlRect rect, Bool monospace, unsigned char
     }
     rect.x += offsetx;
     rect.y += offsety;
-    GlSurface_doBlit(font->surf, surf, &src, &rect);
+    GlSurface_doBlit(tinted, surf, &src, &rect);
     
     return src.w;
 }
@@ -225,6 +317,100 @@ sizeChar(unsigned char c, GlFont font, Bool monospace)
     return font->wcrop[(unsigned int)c];
 }
 
+/*----------------------------------------------------------------------------*/
+/*This function computes the size needed to draw a text*/
+static void
+measureText(GlTextRender tr, String text, Gl2DSize* r_width, Gl2DSize* r_height)
+{
+    char* st = String_get(text);
+    Uint16 x;
+    Uint16 y;
+    Uint16 ax;
+    
+    *r_width = x = 0;
+    y = tr->font->h;
+    
+    while (*st != '\0')
+    {
+        if (*st == '\n')
+        {
+            if (x > *r_width)
+            {
+                *r_width = x;
+            }
+            x = 0;
+            y += tr->font->h;
+        }
+        else if (*st == '\r')
+        {
+            if (x > *r_width)
+            {
+                *r_width = x;
+            }
+            x = 0;
+        }
+        else
+        {
+            if (tr->opt.monospace)
+            {
+                ax = tr->font->w;
+            }
+            else
+            {
+                if (*st == 32)
+                {
+                    ax = tr->font->wspacing;
+                }
+                else
+                {
+                    ax = tr->font->wcrop[(unsigned char)*st];
+                }
+            }
+            
+            if ((tr->wlimit != 0) && (x + ax > tr->wlimit))
+            {
+                /*left limit reached*/
+                if (x > *r_width)
+                {
+                    *r_width = x;
+                }
+                x = 0;
+                y += tr->font->h;
+                continue;
+            }
+            x += ax;
+        }
+        st++;
+    }
+
+    if (x > *r_width)
+    {
+        *r_width = x;
+    }
+    *r_height = y;
+}
+
+/*----------------------------------------------------------------------------*/
+/*This function gives the text size cache entry for a text and rendering options
+(the cache lock must be held)*/
+static GlTextLayout*
+getLayout(GlTextRender tr, String text)
+{
+    char* st;
+    Uint32 hash;
+    
+    /*FNV-1a*/
+    hash = 2166136261U;
+    for (st = String_get(text); *st != '\0'; st++)
+    {
+        hash = (hash ^ (unsigned char)*st) * 16777619U;
+    }
+    hash ^= (Uint32)tr->wlimit + ((Uint32)tr->opt.monospace << 16);
+    hash ^= hash >> 15;
+    
+    return _layouts + (hash % GLTEXT_LAYOUTS_NB);
+}
+
 /*----------------------------------------------------------------------------*/
 static void
 gltextAddFont(Var vfont)
@@ -232,6 +418,7 @@ gltextAddFont(Var vfont)
     VarValidator varvalid;
     GlFont font;
     PtrArrayIterator it;
+    unsigned int i;
     
     varvalid = VarValidator_new();
     
@@ -258,7 +445,11 @@ gltextAddFont(Var vfont)
     font->wspacing = Var_getValueInt(Var_getArrayElemByCName(vfont, "hor_spacing"));
     font->wcrop = MALLOC(sizeof(Gl2DSize) * 256);
     
-    font->lastcolor = GlColor_NULL;
+    for (i = 0; i < GLFONT_TINTS_NB; i++)
+    {
+        font->tints[i].surf = NULL;
+    }
+    font->usecount = 0;
     
     /*some checks*/
     if ((GlSurface_getWidth(font->surf) != font->w * 16)
@@ -305,6 +496,15 @@ gltextAddFont(Var vfont)
 void
 gltextInit()
 {
+    unsigned int i;
+    
+    for (i = 0; i < GLTEXT_LAYOUTS_NB; i++)
+    {
+        _layouts[i].text = NULL;
+        _layouts[i].font = NULL;
+    }
+    _cachelock = SDL_CreateMutex();
+    
     _fonts = PtrArray_newFull(3, 2, (PtrFunc)GlFont_del, (PtrCmpFunc)GlFont_cmp);
     _textrenders = PtrArray_newFull(10, 5, (PtrFunc)GlTextRender_delFinal, NULL);
     
@@ -315,10 +515,21 @@ gltextInit()
 void
 gltextUninit()
 {
+    unsigned int i;
+    
     PtrArray_clear(_textrenders);       /*to avoid callbacks on font deleting*/
     PtrArray_del(_fonts);
     PtrArray_del(_textrenders);
     
+    for (i = 0; i < GLTEXT_LAYOUTS_NB; i++)
+    {
+        if (_layouts[i].text != NULL)
+        {
+            String_del(_layouts[i].text);
+        }
+    }
+    SDL_DestroyMutex(_cachelock);
+    
     shellPrint(LEVEL_INFO, "Text module unloaded.");
 }
 
@@ -470,10 +681,7 @@ GlTextRender_getLineHeight(GlTextRender tr)
 void
 GlTextRender_guessSize(GlTextRender tr, String text, Gl2DSize* r_width, Gl2DSize* r_height)
 {
-    char* st = String_get(text);
-    Uint16 x;
-    Uint16 y;
-    Uint16 ax;
+    GlTextLayout* layout;
     
     if (tr->font == NULL)
     {
@@ -482,67 +690,28 @@ GlTextRender_guessSize(GlTextRender tr, String text, Gl2DSize* r_width, Gl2DSize
         return;
     }
     
-    *r_width = x = 0;
-    y = tr->font->h;
-    
-    while (*st != '\0')
+    SDL_mutexP(_cachelock);
+    layout = getLayout(tr, text);
+    if ((layout->font != tr->font) || (layout->wlimit != tr->wlimit)
+     || (layout->monospace != tr->opt.monospace) || (!String_equal(layout->text, text)))
     {
-        if (*st == '\n')
-        {
-            if (x > *r_width)
-            {
-                *r_width = x;
-            }
-            x = 0;
-            y += tr->font->h;
-        }
-        else if (*st == '\r')
+        measureText(tr, text, &layout->w, &layout->h);
+        if (layout->text == NULL)
         {
-            if (x > *r_width)
-            {
-                *r_width = x;
-            }
-            x = 0;
+            layout->text = String_newByCopy(text);
         }
         else
         {
-            if (tr->opt.monospace)
-            {
-                ax = tr->font->w;
-            }
-            else
-            {
-                if (*st == 32)
-                {
-                    ax = tr->font->wspacing;
-                }
-                else
-                {
-                    ax = tr->font->wcrop[(unsigned char)*st];
-                }
-            }
-            
-            if ((tr->wlimit != 0) && (x + ax > tr->wlimit))
-            {
-                /*left limit reached*/
-                if (x > *r_width)
-                {
-                    *r_width = x;
-                }
-                x = 0;
-                y += tr->font->h;
-                continue;
-            }
-            x += ax;
+            String_copy(layout->text, text);
         }
-        st++;
-    }
-
-    if (x > *r_width)
-    {
-        *r_width = x;
+        layout->font = tr->font;
+        layout->wlimit = tr->wlimit;
+        layout->monospace = tr->opt.monospace;
     }
-    *r_height = y;
+    
+    *r_width = layout->w;
+    *r_height = layout->h;
+    SDL_mutexV(_cachelock);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -552,10 +721,9 @@ GlTextRender_render(GlTextRender tr, String text, GlSurface surf, Gl2DCoord posx
     GlTextRenderStatus ret;
     char* st;
     GlFont font;
-    GlIterator it;
+    GlSurface tinted;
     GlRect rct;
     Gl2DSize dw;
-    GlColor col;
     
     ret.width = 0;
     ret.height = 0;
@@ -594,19 +762,8 @@ GlTextRender_render(GlTextRender tr, String text, GlSurface surf, Gl2DCoord posx
         return ret;
     }
     
-    /*we fill the font surface with the drawing color (without altering alpha channel)*/
-    if (tr->opt.color != font->lastcolor)
-    {
-        GlIterator_init(&it, font->surf);
-        while (!GlIterator_endReached(it))
-        {
-            col = GlIterator_getColor(it) & GlColor_Amask;
-            col |= (tr->opt.color & (~GlColor_Amask));
-            GlIterator_setColor(it, col);
-            GlIterator_fwd(&it);
-        }
-        font->lastcolor = tr->opt.color;
-    }
+    SDL_mutexP(_cachelock);
+    tinted = GlFont_getTinted(font, tr->opt.color);
     
     /*draw characters*/
     if (tr->render == text)
@@ -626,30 +783,35 @@ GlTextRender_render(GlTextRender tr, String text, GlSurface surf, Gl2DCoord posx
             tr->render = text;
             tr->renderpos = st - String_get(text) + 1;
             ret.breakevent = GLTEXTRENDER_NEWLINE;
-            return ret;
+            break;
         }
         if (*st == '\r')
         {
             tr->render = text;
             tr->renderpos = st - String_get(text) + 1;
             ret.breakevent = GLTEXTRENDER_RETURN;
-            return ret;
+            break;
         }
         if ((tr->wlimit != 0) && (sizeChar(*st, font, tr->opt.monospace) > rct.w))
         {
             tr->render = text;
             tr->renderpos = st - String_get(text);
             ret.breakevent = GLTEXTRENDER_NEWLINE;
-            return ret;
+            break;
         }
-        dw = drawChar(font, surf, rct, tr->opt.monospace, *st, 0, 0);
+        dw = drawChar(font, tinted, surf, rct, tr->opt.monospace, *st, 0, 0);
         ret.width += dw;
         rct.x += dw;
         rct.w -= dw;
         st++;
     }
-    tr->render = NULL;
-    ret.breakevent = GLTEXTRENDER_END;
+    SDL_mutexV(_cachelock);
+    
+    if (*st == '\0')
+    {
+        tr->render = NULL;
+        ret.breakevent = GLTEXTRENDER_END;
+    }
     return ret;
 }
 
@@ -658,10 +820,9 @@ void
 GlTextRender_directRender(GlTextRender tr, String text, GlSurface surf, GlRect rect, Gl2DCoord offsetx, Gl2DCoord offsety)
 {
     GlFont font;
+    GlSurface tinted;
     char* st;
     Gl2DCoord x, y;
-    GlIterator it;
-    GlColor col;
     
     if (tr->font == NULL)
     {
@@ -679,15 +840,8 @@ GlTextRender_directRender(GlTextRender tr, String text, GlSurface surf, GlRect r
     x = offsetx;
     y = offsety;
     
-    /*we fill the font surface with the drawing color (without altering alpha channel)*/
-    GlIterator_init(&it, font->surf);
-    while (!GlIterator_endReached(it))
-    {
-        col = GlIterator_getColor(it) & GlColor_Amask;
-        col |= (tr->opt.color & (~GlColor_Amask));
-        GlIterator_setColor(it, col);
-        GlIterator_fwd(&it);
-    }
+    SDL_mutexP(_cachelock);
+    tinted = GlFont_getTinted(font, tr->opt.color);
     
     /*draw characters*/
     while (*st != '\0')
@@ -713,7 +867,8 @@ GlTextRender_directRender(GlTextRender tr, String text, GlSurface surf, GlRect r
             y += tr->font->h;
         }
         
-        x += drawChar(font, surf, rect, tr->opt.monospace, *st, x, y);
+        x += drawChar(font, tinted, surf, rect, tr->opt.monospace, *st, x, y);
         st++;
     }
+    SDL_mutexV(_cachelock);
 }
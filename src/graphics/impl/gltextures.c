@@ -34,6 +34,7 @@
 #include "graphics/color.h"
 #include "graphics/graphics.h"
 #include "graphics/glsurface.h"
+#include "graphics/glrect.h"
 #include "graphics/impl/impl.h"
 
 #include "core/string.h"
@@ -97,11 +98,15 @@ static CoreID MOD_ID = 0;
 static CoreID FUNC_SETFILTER = 0;
 static CoreID FUNC_NBTEX = 0;
 static CoreID FUNC_NBSTATICTEX = 0;
+static CoreID FUNC_TEXUPLOAD = 0;
 
 static Var _prefsvar;
 
 static unsigned int _nbtextures;     /*effective number of OpenGL textures reserved*/
 
+static Uint32 _uploaded;             /*bytes uploaded during the current frame*/
+static Uint32 _uploaded_last;        /*bytes uploaded during the last frame*/
+
 static void* _placedtex;             /*currently placed texture*/
 
 static Gl2DSize _maxtexsize;
@@ -310,12 +315,14 @@ GlStaticTexture_upload(GlStaticTexture tex)
     if (_currentfilter > GLTEX_BILINEAR)
     {
         gluBuild2DMipmaps(GL_TEXTURE_2D, 4, w, h, BYTEORDER, GL_UNSIGNED_BYTE, GlSurface_getPixels(surf));
+        _uploaded += (Uint32)w * (Uint32)h * 4;
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, (tex->xwrap) ? GL_REPEAT : GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, (tex->ywrap) ? GL_REPEAT : GL_CLAMP_TO_EDGE);
     }
     else
     {
         glTexImage2D(GL_TEXTURE_2D, 0, 4, w, h, 0, BYTEORDER, GL_UNSIGNED_BYTE, GlSurface_getPixels(surf));
+        _uploaded += (Uint32)w * (Uint32)h * 4;
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, (tex->xwrap) ? GL_REPEAT : GL_CLAMP);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, (tex->ywrap) ? GL_REPEAT : GL_CLAMP);
     }
@@ -376,12 +383,85 @@ GlLinkedTexture_upload(GlLinkedTexture tex)
         }
 
         glTexImage2D(GL_TEXTURE_2D, 0, 4, w, h, 0, BYTEORDER, GL_UNSIGNED_BYTE, GlSurface_getPixels(surf));
+        _uploaded += (Uint32)w * (Uint32)h * 4;
     }
+    _placedtex = NULL;
 #ifdef DEBUG_TEX
     shellPrintf(LEVEL_DEBUG, "TEX: Linked texture %p uploaded.", (void*)tex);
 #endif
 }
 
+/*----------------------------------------------------------------------------*/
+/*Copy the whole linked surface into the parts and upload them*/
+static void
+GlLinkedTexture_fill(GlLinkedTexture tex)
+{
+    GlRect rctsrc, rctdest;
+    GlRect dirty[GLSURFACE_DIRTY_NB];
+    unsigned int i;
+    unsigned int x, y;
+    
+    /*fill the parts*/
+    rctdest.x = 0;
+    rctdest.y = 0;
+    i = 0;
+    rctsrc.y = 0;
+    for (y = 0; y < tex->nbparty; y++)
+    {
+        rctsrc.x = 0;
+        for (x = 0; x < tex->nbpartx; x++)
+        {
+            rctsrc.w = rctdest.w = tex->parts[i].info.rct.w;
+            rctsrc.h = rctdest.h = tex->parts[i].info.rct.h;
+            GlSurface_copyRect(tex->link, tex->parts[i].surf, &rctsrc, &rctdest);
+            rctsrc.x += rctsrc.w;
+            i++;
+        }
+        rctsrc.y += rctsrc.h;
+    }
+    GlSurface_takeDirty(tex->link, dirty);
+    
+    /*reupload them*/
+    GlLinkedTexture_upload(tex);
+}
+
+/*----------------------------------------------------------------------------*/
+/*Copy a changed area of the linked surface into the parts and upload only the sub-rectangles*/
+static void
+GlLinkedTexture_uploadRect(GlLinkedTexture tex, GlRect* rect)
+{
+    GlRect rctsrc, rctdest;
+    GlSurface surf;
+    Gl2DSize w;
+    Uint16 i;
+
+    for (i = 0; i < tex->nbparts; i++)
+    {
+        rctsrc = *rect;
+        GlRect_clip(&rctsrc, &tex->parts[i].info.rct);
+        if ((rctsrc.w == 0) || (rctsrc.h == 0))
+        {
+            continue;
+        }
+        GlRect_MAKE(rctdest, rctsrc.x - tex->parts[i].info.rct.x, rctsrc.y - tex->parts[i].info.rct.y, rctsrc.w, rctsrc.h);
+
+        surf = tex->parts[i].surf;
+        GlSurface_copyRect(tex->link, surf, &rctsrc, &rctdest);
+        if (tex->parts[i].texid == 0)
+        {
+            continue;
+        }
+
+        w = GlSurface_getWidth(surf);
+        glBindTexture(GL_TEXTURE_2D, tex->parts[i].texid);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, w);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rctdest.x, rctdest.y, rctdest.w, rctdest.h, BYTEORDER, GL_UNSIGNED_BYTE, GlSurface_getPixels(surf) + rctdest.y * w + rctdest.x);
+        _uploaded += (Uint32)rctdest.w * (Uint32)rctdest.h * 4;
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    _placedtex = NULL;
+}
+
 /*----------------------------------------------------------------------------*/
 static void
 setMaterial(float* mat, float shiny, GlColorRGBA* cols)
@@ -491,6 +571,10 @@ shellCallback(ShellFunction* funct)
     {
         Var_setInt(funct->ret, PtrArray_SIZE(_staticarray));
     }
+    else if (funct->id == FUNC_TEXUPLOAD)
+    {
+        Var_setInt(funct->ret, _uploaded_last);
+    }
 }
 
 /*----------------------------------------------------------------------------*/
@@ -526,6 +610,8 @@ gltexturesInit()
 
     _nbtextures = 0;
     _placedtex = NULL;
+    _uploaded = 0;
+    _uploaded_last = 0;
 
     GlStaticTexture_NULL = MALLOC(sizeof(pv_GlStaticTexture));
     GlStaticTexture_NULL->name = String_new("");
@@ -540,6 +626,7 @@ gltexturesInit()
     FUNC_SETFILTER = coreDeclareShellFunction(MOD_ID, "setfilter", VAR_VOID, 1, VAR_INT);
     FUNC_NBTEX = coreDeclareShellFunction(MOD_ID, "nbtex", VAR_INT, 0);
     FUNC_NBSTATICTEX = coreDeclareShellFunction(MOD_ID, "nbstatictex", VAR_INT, 0);
+    FUNC_TEXUPLOAD = coreDeclareShellFunction(MOD_ID, "texupload", VAR_INT, 0);
 
     glGetIntegerv(GL_MAX_TEXTURE_SIZE, &i);
     shellPrintf(LEVEL_INFO, " -> maximal texture size: %d", i);
@@ -600,6 +687,14 @@ gltexturesGet(String name)
     }
 }
 
+/*----------------------------------------------------------------------------*/
+void
+gltexturesNewFrame(void)
+{
+    _uploaded_last = _uploaded;
+    _uploaded = 0;
+}
+
 /*----------------------------------------------------------------------------*/
 void
 gltexturesCheck(void)
@@ -695,6 +790,13 @@ GlStaticTexture_use(GlStaticTexture tex)
     }
 }
 
+/*----------------------------------------------------------------------------*/
+Uint32
+GlStaticTexture_getId(GlStaticTexture tex)
+{
+    return tex->texid;
+}
+
 /******************************************************************************
  *############################################################################*
  *#                         Linked textures functions                        #*
@@ -712,7 +814,7 @@ GlLinkedTexture_new(GlSurface surf, Uint16* nbparts)
     ret->curpart = 0;
     *nbparts = ret->nbparts;
     
-    GlLinkedTexture_updateLink(ret);  /*will fill the parts and upload them*/
+    GlLinkedTexture_fill(ret);
     PtrArray_append(_linkedarray, ret);
     return ret;
 }
@@ -744,7 +846,7 @@ GlLinkedTexture_linkToSurf(GlLinkedTexture tex, GlSurface surf)
     deleteParts(tex);
     tex->link = surf;
     createParts(tex);
-    GlLinkedTexture_updateLink(tex);  /*will fill the parts and upload them*/
+    GlLinkedTexture_fill(tex);
     return tex->nbparts;
 }
 
@@ -752,30 +854,13 @@ GlLinkedTexture_linkToSurf(GlLinkedTexture tex, GlSurface surf)
 void
 GlLinkedTexture_updateLink(GlLinkedTexture tex)
 {
-    GlRect rctsrc, rctdest;
-    unsigned int i;
-    unsigned int x, y;
-    
-    /*fill the parts*/
-    rctdest.x = 0;
-    rctdest.y = 0;
-    i = 0;
-    rctsrc.y = 0;
-    for (y = 0; y < tex->nbparty; y++)
+    GlRect dirty[GLSURFACE_DIRTY_NB];
+    Uint16 nb, i;
+
+    /*only the areas drawn since the last update*/
+    nb = GlSurface_takeDirty(tex->link, dirty);
+    for (i = 0; i < nb; i++)
     {
-        rctsrc.x = 0;
-        for (x = 0; x < tex->nbpartx; x++)
-        {
-            rctsrc.w = rctdest.w = tex->parts[i].info.rct.w;
-            rctsrc.h = rctdest.h = tex->parts[i].info.rct.h;
-            GlSurface_copyRect(tex->link, tex->parts[i].surf, &rctsrc, &rctdest);
-            rctsrc.x += rctsrc.w;
-            i++;
-        }
-        rctsrc.y += rctsrc.h;
+        GlLinkedTexture_uploadRect(tex, dirty + i);
     }
-
-    
-    /*reupload them*/
-    GlLinkedTexture_upload(tex);
 }
@@ -121,6 +121,13 @@ GlStaticTexture gltexturesGet(String name);
  */
 void gltexturesCheck(void);
 
+/*!
+ * \brief Start a new frame for the texture upload statistics.
+ *
+ * The bytes uploaded during the previous frame are given by the 'texupload' shell function.
+ */
+void gltexturesNewFrame(void);
+
 /*!
  * \brief Change the texture filter.
  *
@@ -140,6 +147,15 @@ void gltexturesSetFilter(GlTextureFilter filter);
  */
 void GlStaticTexture_use(GlStaticTexture tex);
 
+/*!
+ * \brief Get the OpenGL identifier of a static texture.
+ *
+ * Used to sort draws by texture.
+ * \param tex - The texture.
+ * \return The OpenGL texture name.
+ */
+Uint32 GlStaticTexture_getId(GlStaticTexture tex);
+
 /******************************************************************************
  *############################################################################*
  *#                         Linked textures functions                        #*
@@ -185,6 +201,7 @@ Uint16 GlLinkedTexture_linkToSurf(GlLinkedTexture tex, GlSurface surf);
  * \brief Update a link with the surface.
  *
  * Call this when the surface content has changed and need to be updated in OpenGL memory.
+ * Only the areas marked dirty on the surface since the last update are uploaded.
  * \param tex - The linked texture.
  */
 void GlLinkedTexture_updateLink(GlLinkedTexture tex);
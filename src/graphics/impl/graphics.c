@@ -38,6 +38,7 @@
 #include "graphics/impl/keyboard.h"
 #include "graphics/impl/glscreen.h"
 #include "graphics/impl/gltextures.h"
+#include "graphics/impl/glmeshpart.h"
 #include "core/core.h"
 #include "core/shell.h"
 #include "core/ptrarray.h"
@@ -65,7 +66,6 @@ struct pv_Gl3DGroup
 Uint32 global_frametime;
 Bool global_pause;
 Bool global_cammoved;
-Uint32 global_checkcount;
 
 /******************************************************************************
  *                               Static variables                             *
@@ -88,7 +88,7 @@ static PtrArray eventcollectors_add;
 static PtrArray eventcollectors_del;
 
 static Uint32 needsorting;
-static Gl2DObject needsorting_obj;
+static PtrArrayPos needsorting_pos;
 
 static Gl2DObject obj_holdmouse;
 static Gl2DObject obj_focus;
@@ -166,16 +166,16 @@ graphicsDel3DObject(Gl3DObject obj)
 
 /*----------------------------------------------------------------------------*/
 void
-graphicsAddParticle(Particle obj)
+graphicsAddParticleSystem(ParticleSystem system)
 {
-    PtrArray_append(particles_add, obj);
+    PtrArray_append(particles_add, system);
 }
 
 /*----------------------------------------------------------------------------*/
 void
-graphicsDelParticle(Particle obj)
+graphicsDelParticleSystem(ParticleSystem system)
 {
-    PtrArray_append(particles_del, obj);
+    PtrArray_append(particles_del, system);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -378,6 +378,25 @@ datasCallback(Var datas)
     gltexturesLoadSet(Var_getArrayElemByCName(datas, "textures"));
 }
 
+/*----------------------------------------------------------------------------*/
+static void
+sortDepth(PtrArray array, PtrKeyFunc keyfunc)
+{
+    if (needsorting == 1)
+    {
+        /*one object needs to be sorted again*/
+        PtrArray_sortOne(array, needsorting_pos);
+    }
+    else if (needsorting > 1)
+    {
+        /*depth order rarely changes much between two frames*/
+        if (PtrArray_sortNearly(array, 2 * PtrArray_SIZE(array)))
+        {
+            PtrArray_sortByKey(array, keyfunc);
+        }
+    }
+}
+
 /*----------------------------------------------------------------------------*/
 static void
 shellCallback(ShellFunction* func)
@@ -462,14 +481,13 @@ threadCallback(CoreID thread, CoreTime duration)
     PtrArray_clear(array3d_del);
     for (it = PtrArray_START(particles_add); it != PtrArray_STOP(particles_add); it++)
     {
-        PtrArray_append(particles, (Particle)(*it));
-        Particle_processEvent((Particle)(*it), &event_camerastate);
+        PtrArray_append(particles, (ParticleSystem)(*it));
     }
     PtrArray_clear(particles_add);
     for (it = PtrArray_START(particles_del); it != PtrArray_STOP(particles_del); it++)
     {
-        PtrArray_remove(particles, (Particle)(*it));
-        Particle_processEvent((Particle)(*it), &event_delete);
+        PtrArray_remove(particles, (ParticleSystem)(*it));
+        ParticleSystem_processEvent((ParticleSystem)(*it), &event_delete);
     }
     PtrArray_clear(particles_del);
     for (it = PtrArray_START(eventcollectors_add); it != PtrArray_STOP(eventcollectors_add); it++)
@@ -495,35 +513,33 @@ threadCallback(CoreID thread, CoreTime duration)
     }
     PtrArray_clear(eventcollectors_del);
 
+    gltexturesNewFrame();
     event.type = GLEVENT_DRAW;
     event.event.frameduration = duration;
     group = 0;
 
-    /*if (global_checkcount >= 50)
-        printf("50 objects rechecked.\n");
-    else
-        printf("%2d objects rechecked.\n", global_checkcount);*/
-
-    global_checkcount = 0;
-    
     /*draw 3d background*/
     openglStep3DBackground();
     cameraSetSceneBackground();
+    GlMeshPart_beginQueue();
     while ((group < nbgroups3d) && (groups3d[group]->mode == GL3DRENDER_BACKGROUND))
     {
         PtrArray_foreachWithData(groups3d[group]->array, (PtrFuncWithData)Gl3DObject_processEvent, &event);
         group++;
     }
+    GlMeshPart_flushQueue();
 
     /*draw plain 3d objects*/
     openglStep3DObjects();
     cameraSetSceneNormal();
     lightSetScene();
+    GlMeshPart_beginQueue();
     while ((group < nbgroups3d) && (groups3d[group]->mode == GL3DRENDER_NORMAL))
     {
         PtrArray_foreachWithData(groups3d[group]->array, (PtrFuncWithData)Gl3DObject_processEvent, &event);
         group++;
     }
+    GlMeshPart_flushQueue();
 
     /*draw blended 3d objects*/
     while ((group < nbgroups3d) && (groups3d[group]->mode == GL3DRENDER_BLENDED))
@@ -534,19 +550,12 @@ threadCallback(CoreID thread, CoreTime duration)
             if (Gl3DObject_processEvent((Gl3DObject)*it, &event))
             {
                 needsorting++;
-                needsorting_obj = *it;
+                needsorting_pos = it - PtrArray_START(groups3d[group]->array);
             }
         }
-        if (needsorting > 1)
+        if (graphicsIsGroupZSorted(groups3d[group]))
         {
-            /*all objects need to be sorted*/
-            PtrArray_sort(groups3d[group]->array);
-        }
-        else if (needsorting == 1)
-        {
-            /*one object needs to be sorted again*/
-            /*FIXME: use a PtrArray_sortOne*/
-            PtrArray_sort(groups3d[group]->array);
+            sortDepth(groups3d[group]->array, (PtrKeyFunc)Gl3DObject_depthKey);
         }
         group++;
     }
@@ -564,7 +573,7 @@ threadCallback(CoreID thread, CoreTime duration)
     
     /*draw particles*/
     openglStepParticles();
-    PtrArray_foreachWithData(particles, (PtrFuncWithData)Particle_processEvent, &event);
+    particlesDraw(particles, duration);
 
     /*draw 2d objects*/
     openglStep2D();
@@ -574,20 +583,10 @@ threadCallback(CoreID thread, CoreTime duration)
         if (Gl2DObject_processEvent((Gl2DObject)*it, &event))
         {
             needsorting++;
-            needsorting_obj = *it;
+            needsorting_pos = it - PtrArray_START(array2d);
         }
     }
-    if (needsorting > 1)
-    {
-        /*all objects need to be sorted*/
-        PtrArray_sort(array2d);
-    }
-    else if (needsorting == 1)
-    {
-        /*one object needs to be sorted again*/
-        /*FIXME: use a PtrArray_sortOne*/
-        PtrArray_sort(array2d);
-    }
+    sortDepth(array2d, (PtrKeyFunc)Gl2DObject_depthKey);
 
     /*throw draw event to the collectors*/
     graphicsProcessEvent(&event);
@@ -637,7 +636,7 @@ graphicsInit()
     array3d_del = PtrArray_new();
     array3d_add = PtrArray_new();
 
-    particles = PtrArray_newFull(100, 50, NULL, NULL);
+    particles = PtrArray_newFull(20, 20, NULL, (PtrCmpFunc)ParticleSystem_cmp);
     particles_del = PtrArray_new();
     particles_add = PtrArray_new();
 
@@ -670,6 +669,7 @@ graphicsInit()
     glscreenInit();
     keyboardInit();
     colorInit();
+    glsurfaceInit();
     openglInit();
     gltexturesInit();
     gltextInit();
@@ -731,6 +731,12 @@ graphicsUninit()
     PtrArray_del(eventcollectors_del);
     PtrArray_del(eventcollectors);
 
+    PtrArray_del(particles_add);
+    PtrArray_del(particles_del);
+    PtrArray_del(particles);
+    particlesUninit();
+    GlMeshPart_freeQueue();
+
     shellPrintf(LEVEL_INFO, "Graphical engine destroyed.");
 }
 
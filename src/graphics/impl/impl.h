@@ -36,6 +36,7 @@
 #include "graphics/impl/opengl.h"
 #include "graphics/particle.h"
 #include "core/types.h"
+#include "core/ptrarray.h"
 #include "graphics/gliterator.h"
 #include "SDL.h"
 
@@ -50,9 +51,9 @@ typedef struct
 {
     Bool drawn;
     Bool check;             /*need control points check because camera moved*/
-    Bool forcecheck;        /*force control points check*/
     GlRect rct;
     Gl3DCoord z;
+    const Float* color;     /*object color, used when the mesh is queued*/
 } GlMeshInfo;
 
 /******************************************************************************
@@ -64,7 +65,6 @@ extern Gl3DCoord global_camangh;
 extern Gl3DCoord global_camangv;
 extern Bool global_cammoved;    /*TRUE if the camera moved*/
 extern Bool global_forceblend;  /*defined in opengl.c*/
-extern Uint32 global_checkcount;  /*number of 3d objects with check==TRUE that have been treated in checked frame*/
 
 /******************************************************************************
  *############################################################################*
@@ -74,8 +74,11 @@ extern Uint32 global_checkcount;  /*number of 3d objects with check==TRUE that h
 OpenGLTexture gltexturesReserveTex(void);
 void gltexturesDeleteTex(OpenGLTexture tex);
 
+void glsurfaceInit(void);
 void GlSurface_initIterator(GlSurface surf, GlIterator* it);
 SDL_Surface* GlSurface_getSDLSurface(GlSurface surf);
+/*replace the bits of all pixels outside 'keep' by those of col*/
+void GlSurface_recolor(GlSurface surf, GlColor col, GlColor keep);
 
 void colorInit(void);
 
@@ -99,6 +102,8 @@ void cameraSetSceneNormal(void);
 void cameraSetSceneBackground(void);
 void cameraPushObject(Gl3DCoord x, Gl3DCoord y, Gl3DCoord z, Gl3DCoord angh, Gl3DCoord angv);
 void cameraPopObject(void);
+void cameraGetObjectMatrix(GLfloat* res, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z, Gl3DCoord angh, Gl3DCoord angv);
+Uint16 cameraProjectPoints(Gl3DCoord* sphere, Gl3DCoord* points, Uint16 nb, Gl3DCoord* out);
 void cameraCollectEvents(void);
 void cameraGetRealPos(Gl3DCoord* cx, Gl3DCoord* cy, Gl3DCoord* cz);
 
@@ -107,19 +112,24 @@ void graphicsAdd2DObject(Gl2DObject obj);
 void graphicsDel2DObject(Gl2DObject obj);
 void graphicsAdd3DObject(Gl3DObject obj);
 void graphicsDel3DObject(Gl3DObject obj);
-void graphicsAddParticle(Particle obj);
-void graphicsDelParticle(Particle obj);
+void graphicsAddParticleSystem(ParticleSystem system);
+void graphicsDelParticleSystem(ParticleSystem system);
 Bool graphicsIsGroupZSorted(Gl3DGroup group);
 
 void Gl2DObject_dropTextures(Gl2DObject obj);
 void Gl2DObject_uploadTextures(Gl2DObject obj);
 Bool Gl2DObject_processEvent(Gl2DObject obj, GlEvent* event);
 int Gl2DObject_cmp(Gl2DObject* obj1, Gl2DObject* obj2);
+Uint32 Gl2DObject_depthKey(Gl2DObject obj);
 
 Bool Gl3DObject_processEvent(Gl3DObject obj, GlEvent* event);
 int Gl3DObject_cmp(Gl3DObject* obj1, Gl3DObject* obj2);
+Uint32 Gl3DObject_depthKey(Gl3DObject obj);
 
-Bool Particle_processEvent(Particle obj, GlEvent* event);
+Bool ParticleSystem_processEvent(ParticleSystem system, GlEvent* event);
+int ParticleSystem_cmp(ParticleSystem* system1, ParticleSystem* system2);
+void particlesDraw(PtrArray systems, CoreTime duration);
+void particlesUninit(void);
 
 void GlMesh_draw(GlMesh mesh, GlMeshControl control, GlMeshInfo* info);
 void GlMesh_makeControl(GlMesh mesh, GlMeshControl* control_p);
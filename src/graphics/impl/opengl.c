@@ -40,6 +40,34 @@
 #include "tools/varvalidator.h"
 #include "tools/fonct.h"
 
+#include <stddef.h>
+#include <string.h>
+
+/******************************************************************************
+ *                                  Typedefs                                  *
+ ******************************************************************************/
+#ifndef APIENTRY
+    #define APIENTRY
+#endif
+
+/*GL_ARB_vertex_buffer_object entry points*/
+typedef void (APIENTRY *GenBuffersFunc)(GLsizei n, GLuint* buffers);
+typedef void (APIENTRY *DeleteBuffersFunc)(GLsizei n, const GLuint* buffers);
+typedef void (APIENTRY *BindBufferFunc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY *BufferDataFunc)(GLenum target, ptrdiff_t size, const GLvoid* data, GLenum usage);
+typedef GLboolean (APIENTRY *IsBufferFunc)(GLuint buffer);
+
+/*SDL_GL_GetProcAddress returns an object pointer, ISO C doesn't allow to cast it to a function pointer*/
+typedef union
+{
+    void* ptr;
+    GenBuffersFunc genbuffers;
+    DeleteBuffersFunc deletebuffers;
+    BindBufferFunc bindbuffer;
+    BufferDataFunc bufferdata;
+    IsBufferFunc isbuffer;
+} OpenGLProc;
+
 /******************************************************************************
  *                              Global variables                              *
  ******************************************************************************/
@@ -69,6 +97,7 @@ static CoreID FUNC_FOG;
 static CoreID FUNC_LIGHTING;
 static CoreID FUNC_TEXTURE;
 static CoreID FUNC_COUNT;
+static CoreID FUNC_BUFFERS;
 
 static Uint32 curcount;
 static Uint32 count;
@@ -79,6 +108,26 @@ static Sint16 vp_left;
 static Sint16 vp_top;
 static Sint16 vp_width;
 static Sint16 vp_height;
+static GLint vp_current[4];
+
+/*state cache (-1 when unknown)*/
+static int st_cull;
+static int st_blend;
+static GLint st_shade;
+static GLfloat st_color[4];
+static OpenGLBuffer st_arraybuffer;
+static OpenGLBuffer st_elementbuffer;
+
+/*buffer objects*/
+static Bool buffers_supported;
+static Bool buffers_enabled;
+static Uint32 buffers_gen;
+static OpenGLBuffer buffers_sentinel;   /*never deleted, vanishes with the context*/
+static GenBuffersFunc glGenBuffersARB_p;
+static DeleteBuffersFunc glDeleteBuffersARB_p;
+static BindBufferFunc glBindBufferARB_p;
+static BufferDataFunc glBufferDataARB_p;
+static IsBufferFunc glIsBufferARB_p;
 
 /******************************************************************************
  *############################################################################*
@@ -115,6 +164,98 @@ shellCallback(ShellFunction* func)
     {
         Var_setInt(func->ret, count);
     }
+    else if (func->id == FUNC_BUFFERS)
+    {
+        if (!buffers_supported)
+        {
+            shellPrint(LEVEL_ERROR, _("Buffer objects are not supported by the OpenGL implementation."));
+        }
+        else
+        {
+            buffers_enabled = (Var_getValueInt(func->params[0]) == 0) ? FALSE : TRUE;
+        }
+        Var_setVoid(func->ret);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*Check that an extension is in the OpenGL extensions string*/
+static Bool
+hasExtension(const char* name)
+{
+    const char* ext;
+    const char* p;
+    size_t len;
+
+    ext = (const char*)glGetString(GL_EXTENSIONS);
+    if (ext == NULL)
+    {
+        return FALSE;
+    }
+    len = strlen(name);
+    for (p = strstr(ext, name); p != NULL; p = strstr(p + len, name))
+    {
+        if (((p == ext) || (p[-1] == ' ')) && ((p[len] == ' ') || (p[len] == '\0')))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+loadBuffersExtension(void)
+{
+    OpenGLProc proc;
+
+    buffers_supported = FALSE;
+    if (hasExtension("GL_ARB_vertex_buffer_object"))
+    {
+        proc.ptr = SDL_GL_GetProcAddress("glGenBuffersARB");
+        glGenBuffersARB_p = proc.genbuffers;
+        proc.ptr = SDL_GL_GetProcAddress("glDeleteBuffersARB");
+        glDeleteBuffersARB_p = proc.deletebuffers;
+        proc.ptr = SDL_GL_GetProcAddress("glBindBufferARB");
+        glBindBufferARB_p = proc.bindbuffer;
+        proc.ptr = SDL_GL_GetProcAddress("glBufferDataARB");
+        glBufferDataARB_p = proc.bufferdata;
+        proc.ptr = SDL_GL_GetProcAddress("glIsBufferARB");
+        glIsBufferARB_p = proc.isbuffer;
+        buffers_supported = (glGenBuffersARB_p != NULL) && (glDeleteBuffersARB_p != NULL) && (glBindBufferARB_p != NULL) && (glBufferDataARB_p != NULL) && (glIsBufferARB_p != NULL);
+    }
+    buffers_enabled = buffers_supported;
+
+    /*a buffer created in a previous context doesn't exist in a new one*/
+    if ((buffers_sentinel != 0) && (!buffers_supported || !glIsBufferARB_p(buffers_sentinel)))
+    {
+        /*the buffer objects died with the previous context*/
+        buffers_gen++;
+        buffers_sentinel = 0;
+    }
+    if (buffers_supported && (buffers_sentinel == 0))
+    {
+        /*a name only becomes a buffer object once bound*/
+        glGenBuffersARB_p(1, &buffers_sentinel);
+        glBindBufferARB_p(GL_ARRAY_BUFFER_ARB, buffers_sentinel);
+        glBindBufferARB_p(GL_ARRAY_BUFFER_ARB, 0);
+    }
+    shellPrintf(LEVEL_INFO, " -> Buffer objects:  %s", buffers_supported ? "yes" : "no");
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+resetStateCache(void)
+{
+    st_cull = -1;
+    st_blend = -1;
+    st_shade = -1;
+    st_color[0] = -1.0f;
+    if (buffers_enabled)
+    {
+        openglBindBuffer(GL_ARRAY_BUFFER_ARB, 0);
+        openglBindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+    }
 }
 
 /*----------------------------------------------------------------------------*/
@@ -160,6 +301,9 @@ openglInit()
     vp_top = vp_left = 0;
     vp_width = vp_height = 10;
 
+    vp_current[0] = vp_current[1] = 0;
+    vp_current[2] = vp_current[3] = 10;
+
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     wireframe2d = FALSE;
     wireframe3d = FALSE;
@@ -184,6 +328,13 @@ openglInit()
     curcount = 0;
     count = 0;
 
+    buffers_gen = 0;
+    buffers_sentinel = 0;
+    st_arraybuffer = 0;
+    st_elementbuffer = 0;
+    loadBuffersExtension();
+    resetStateCache();
+
     fog = FALSE;
     fogdensity = 0.0;
     fogcolor[0] = 0.5;
@@ -198,6 +349,7 @@ openglInit()
     FUNC_LIGHTING = coreDeclareShellFunction(MOD_ID, "lighting", VAR_VOID, 2, VAR_INT, VAR_INT);
     FUNC_TEXTURE = coreDeclareShellFunction(MOD_ID, "texture", VAR_VOID, 2, VAR_INT, VAR_INT);
     FUNC_COUNT = coreDeclareShellFunction(MOD_ID, "count", VAR_INT, 0);
+    FUNC_BUFFERS = coreDeclareShellFunction(MOD_ID, "buffers", VAR_VOID, 1, VAR_INT);
 
     /*OpenGL info*/
     shellPrintf(LEVEL_INFO, " -> OpenGL version:  %s", (const char*)glGetString(GL_VERSION));
@@ -252,6 +404,12 @@ openglScreenSize(Uint16 width, Uint16 height)
 {
     screen_w = width;
     screen_h = height;
+
+    /*the OpenGL context may have been recreated*/
+    st_arraybuffer = 0;
+    st_elementbuffer = 0;
+    loadBuffersExtension();
+    resetStateCache();
     
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
     
@@ -273,9 +431,15 @@ openglStep3DBackground()
 {
     Sint16 w, h;
 
+    resetStateCache();
+
     w = (vp_wrel) ? screen_w + vp_width : vp_width;
     h = (vp_hrel) ? screen_h + vp_height : vp_height;
-    glViewport(vp_left, screen_h - h - vp_top, w, h);
+    vp_current[0] = vp_left;
+    vp_current[1] = screen_h - h - vp_top;
+    vp_current[2] = w;
+    vp_current[3] = h;
+    glViewport(vp_current[0], vp_current[1], vp_current[2], vp_current[3]);
     global_screenratio = (float)h / (float)w;
 
     glDisable(GL_LIGHTING);
@@ -306,10 +470,22 @@ openglStep3DBackground()
     }
 }
 
+/*----------------------------------------------------------------------------*/
+void
+openglGet3DViewport(GLint* viewport)
+{
+    viewport[0] = vp_current[0];
+    viewport[1] = vp_current[1];
+    viewport[2] = vp_current[2];
+    viewport[3] = vp_current[3];
+}
+
 /*----------------------------------------------------------------------------*/
 void
 openglStep3DObjects()
 {
+    resetStateCache();
+
     glDepthMask(GL_TRUE);           /*bacause background can set it to false, what cancels the clear effect*/
     glClear(GL_DEPTH_BUFFER_BIT);
     glEnable(GL_DEPTH_TEST);
@@ -333,6 +509,8 @@ openglStep3DObjects()
 void
 openglStep3DObjectsGhost()
 {
+    resetStateCache();
+
     global_forceblend = TRUE;
     glDepthMask(GL_FALSE);
     glDisable(GL_LIGHTING);
@@ -344,6 +522,8 @@ openglStep3DObjectsGhost()
 void
 openglStepParticles(void)
 {
+    resetStateCache();
+
     global_forceblend = FALSE;
     glEnable(GL_BLEND);
     glEnable(GL_FOG);
@@ -355,6 +535,8 @@ openglStepParticles(void)
 void
 openglStep2D()
 {
+    resetStateCache();
+
     glViewport(0, 0, screen_w, screen_h);
     global_screenratio = (float)screen_w / (float)screen_h;
 
@@ -394,6 +576,131 @@ openglStep2D()
     }
 }
 
+/******************************************************************************
+ *############################################################################*
+ *#                              State functions                             #*
+ *############################################################################*
+ ******************************************************************************/
+void
+openglSetCulling(Bool cull)
+{
+    if (st_cull != (int)cull)
+    {
+        if (cull)
+        {
+            glEnable(GL_CULL_FACE);
+        }
+        else
+        {
+            glDisable(GL_CULL_FACE);
+        }
+        st_cull = cull;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void
+openglSetBlending(Bool blend)
+{
+    if (st_blend != (int)blend)
+    {
+        if (blend)
+        {
+            glEnable(GL_BLEND);
+            glDepthMask(GL_FALSE);
+        }
+        else
+        {
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+        }
+        st_blend = blend;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void
+openglSetShadeModel(GLenum mode)
+{
+    if (st_shade != (GLint)mode)
+    {
+        glShadeModel(mode);
+        st_shade = mode;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void
+openglSetColor(const GLfloat* color)
+{
+    /*compare the bits, an exact match is what we are looking for*/
+    if (memcmp(st_color, color, sizeof(st_color)) != 0)
+    {
+        glColor4fv(color);
+        memcpy(st_color, color, sizeof(st_color));
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+openglHasBuffers()
+{
+    return buffers_enabled;
+}
+
+/*----------------------------------------------------------------------------*/
+Uint32
+openglBuffersGeneration()
+{
+    return buffers_gen;
+}
+
+/*----------------------------------------------------------------------------*/
+OpenGLBuffer
+openglCreateBuffer(GLenum target, const GLvoid* data, size_t size)
+{
+    OpenGLBuffer ret;
+
+    ASSERT(buffers_enabled, return 0);
+
+    ret = 0;
+    glGenBuffersARB_p(1, &ret);
+    openglBindBuffer(target, ret);
+    glBufferDataARB_p(target, (ptrdiff_t)size, data, GL_STATIC_DRAW_ARB);
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+openglDeleteBuffer(OpenGLBuffer buffer)
+{
+    ASSERT(buffers_supported, return);
+
+    if (st_arraybuffer == buffer)
+    {
+        st_arraybuffer = 0;
+    }
+    if (st_elementbuffer == buffer)
+    {
+        st_elementbuffer = 0;
+    }
+    glDeleteBuffersARB_p(1, &buffer);
+}
+
+/*----------------------------------------------------------------------------*/
+void
+openglBindBuffer(GLenum target, OpenGLBuffer buffer)
+{
+    OpenGLBuffer* cur;
+
+    cur = (target == GL_ELEMENT_ARRAY_BUFFER_ARB) ? &st_elementbuffer : &st_arraybuffer;
+    if (*cur != buffer)
+    {
+        glBindBufferARB_p(target, buffer);
+        *cur = buffer;
+    }
+}
+
 #ifdef DEBUG_OPENGL
 /*----------------------------------------------------------------------------*/
 void
@@ -57,6 +57,22 @@ extern float global_screenratio;
  ******************************************************************************/
 typedef GLuint OpenGLTexture;
 
+/*! \brief Buffer object identifier (0 is an invalid buffer). */
+typedef GLuint OpenGLBuffer;
+
+/******************************************************************************
+ *                                  Constants                                 *
+ ******************************************************************************/
+#ifndef GL_ARRAY_BUFFER_ARB
+    #define GL_ARRAY_BUFFER_ARB 0x8892
+#endif
+#ifndef GL_ELEMENT_ARRAY_BUFFER_ARB
+    #define GL_ELEMENT_ARRAY_BUFFER_ARB 0x8893
+#endif
+#ifndef GL_STATIC_DRAW_ARB
+    #define GL_STATIC_DRAW_ARB 0x88E4
+#endif
+
 /******************************************************************************
  *############################################################################*
  *#                             OpenGL functions                             #*
@@ -92,6 +108,14 @@ void openglScreenSize(Uint16 width, Uint16 height);
  */
 void openglStep3DBackground(void);
 
+/*!
+ * \brief Get the viewport used for 3D rendering.
+ *
+ * This is the viewport set by the last openglStep3DBackground call.
+ * \param viewport - Array of 4 values to receive x, y, width and height.
+ */
+void openglGet3DViewport(GLint* viewport);
+
 /*!
  * \brief Prepare for 3D objects rendering.
  */
@@ -112,6 +136,79 @@ void openglStepParticles(void);
  */
 void openglStep2D(void);
 
+/*!
+ * \brief Enable or disable face culling, skipping the call if already set.
+ *
+ * The state cache is reset by each openglStep* function.
+ * \param cull - TRUE to cull back faces.
+ */
+void openglSetCulling(Bool cull);
+
+/*!
+ * \brief Enable or disable blending (and depth writing), skipping the call if already set.
+ *
+ * Depth writing is disabled while blending.
+ * \param blend - TRUE to blend.
+ */
+void openglSetBlending(Bool blend);
+
+/*!
+ * \brief Set the shading model, skipping the call if already set.
+ *
+ * \param mode - GL_FLAT or GL_SMOOTH.
+ */
+void openglSetShadeModel(GLenum mode);
+
+/*!
+ * \brief Set the current color, skipping the call if already set.
+ *
+ * \param color - RGBA color.
+ */
+void openglSetColor(const GLfloat* color);
+
+/*!
+ * \brief Tell if buffer objects can be used to store vertex data.
+ *
+ * This is FALSE if the OpenGL implementation doesn't support them, or if
+ * they were disabled through the 'buffers' shell function.
+ * \return TRUE if buffer objects can be used.
+ */
+Bool openglHasBuffers(void);
+
+/*!
+ * \brief Get the buffer objects generation.
+ *
+ * The generation changes when the OpenGL context was recreated: buffer objects
+ * created before are gone, they must be forgotten (not deleted) and uploaded again.
+ * \return The current generation number.
+ */
+Uint32 openglBuffersGeneration(void);
+
+/*!
+ * \brief Create a buffer object and fill it with static data.
+ *
+ * \param target - GL_ARRAY_BUFFER_ARB or GL_ELEMENT_ARRAY_BUFFER_ARB.
+ * \param data - Data to upload.
+ * \param size - Data size in bytes.
+ * \return The buffer object, left bound to target.
+ */
+OpenGLBuffer openglCreateBuffer(GLenum target, const GLvoid* data, size_t size);
+
+/*!
+ * \brief Delete a buffer object.
+ *
+ * \param buffer - The buffer object.
+ */
+void openglDeleteBuffer(OpenGLBuffer buffer);
+
+/*!
+ * \brief Bind a buffer object, skipping the call if already bound.
+ *
+ * \param target - GL_ARRAY_BUFFER_ARB or GL_ELEMENT_ARRAY_BUFFER_ARB.
+ * \param buffer - The buffer object, 0 to go back to client memory.
+ */
+void openglBindBuffer(GLenum target, OpenGLBuffer buffer);
+
 #ifdef DEBUG_OPENGL
     void pv_openglResetCount();
     void pv_openglCount(unsigned int i);
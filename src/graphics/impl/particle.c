@@ -34,52 +34,332 @@
 #include "graphics/impl/impl.h"
 #include "tools/fonct.h"
 
+#include "SDL_mutex.h"
+
 /******************************************************************************
  *                                  Typedefs                                  *
  ******************************************************************************/
-struct pv_Particle
+typedef struct
+{
+    Gl3DCoord pos[3];
+    Gl3DCoord vel[3];
+    CoreTime life;              /*remaining lifetime, 0 for ever*/
+    Uint32 handle;              /*handle of the particle*/
+} ParticleData;
+
+/*Stable identifier of a particle, particles move in the pool when others expire*/
+typedef struct
+{
+    Uint32 pos;                 /*position of the particle in the pool*/
+    Uint16 gen;                 /*incremented when the particle dies, invalidates old ParticleIDs*/
+} ParticleHandle;
+
+struct pv_ParticleSystem
 {
     Bool visible;
     GlStaticTexture tex;
-    Gl3DCoord x;
-    Gl3DCoord y;
-    Gl3DCoord z;
     Gl3DCoord w;
     Gl3DCoord h;
+    Gl3DCoord acc[3];
+    Uint32 nb;
+    Uint32 capacity;
+    ParticleData* data;         /*pool of capacity particles, nb first are alive*/
+    ParticleHandle* handles;    /*capacity handles*/
+    Uint32* freehandles;        /*stack of the unused handles*/
+    Uint32 nbfree;
+    SDL_mutex* lock;            /*held by the graphics thread while it simulates and draws*/
 };
 
+/******************************************************************************
+ *                                   Macros                                   *
+ ******************************************************************************/
+/*interleaved vertex: 2 texture coordinates then 3 coordinates*/
+#define VERTEX_SIZE 5
+
+/*a ParticleID is a handle and its generation*/
+#define HANDLE_BITS 16
+#define HANDLE_MASK ((1 << HANDLE_BITS) - 1)
+#define MAKE_ID(_system_,_handle_) ((ParticleID)(_handle_) | ((ParticleID)(_system_)->handles[_handle_].gen << HANDLE_BITS))
+
+/******************************************************************************
+ *                              Static variables                              *
+ ******************************************************************************/
+/*shared vertex array, one quad per visible particle of a texture batch*/
+static GLfloat* _vertices = NULL;
+static Uint32 _vertices_quads = 0;
+
+/******************************************************************************
+ *############################################################################*
+ *#                             Private functions                            #*
+ *############################################################################*
+ ******************************************************************************/
+/*Give back the handle of a dead particle*/
+static void
+freeHandle(ParticleSystem system, Uint32 handle)
+{
+    system->handles[handle].gen++;
+    system->freehandles[system->nbfree++] = handle;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Find an alive particle from its ID, NULL if it expired*/
+static ParticleData*
+findParticle(ParticleSystem system, ParticleID particle)
+{
+    ParticleHandle* handle;
+    ParticleData* p;
+    
+    if ((particle & HANDLE_MASK) >= system->capacity)
+    {
+        return NULL;
+    }
+    handle = system->handles + (particle & HANDLE_MASK);
+    if ((handle->gen != (Uint16)(particle >> HANDLE_BITS)) || (handle->pos >= system->nb))
+    {
+        return NULL;
+    }
+    p = system->data + handle->pos;
+    return (p->handle == (particle & HANDLE_MASK)) ? p : NULL;
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+simulate(ParticleSystem system, CoreTime duration)
+{
+    ParticleData* p;
+    ParticleData* stop;
+    Gl3DCoord dt;
+    Gl3DCoord dv[3];
+
+    /*expire particles, the last one takes the place of a dead one*/
+    p = system->data;
+    stop = system->data + system->nb;
+    while (p != stop)
+    {
+        if (p->life == 0)
+        {
+            p++;
+        }
+        else if (p->life <= duration)
+        {
+            freeHandle(system, p->handle);
+            stop--;
+            if (p != stop)
+            {
+                *p = *stop;
+                system->handles[p->handle].pos = p - system->data;
+            }
+        }
+        else
+        {
+            p->life -= duration;
+            p++;
+        }
+    }
+    system->nb = stop - system->data;
+
+    /*move particles*/
+    dt = (Gl3DCoord)duration / 1000.0;
+    dv[0] = system->acc[0] * dt;
+    dv[1] = system->acc[1] * dt;
+    dv[2] = system->acc[2] * dt;
+    for (p = system->data; p != stop; p++)
+    {
+        p->vel[0] += dv[0];
+        p->vel[1] += dv[1];
+        p->vel[2] += dv[2];
+        p->pos[0] += p->vel[0] * dt;
+        p->pos[1] += p->vel[1] * dt;
+        p->pos[2] += p->vel[2] * dt;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+static GLfloat*
+expand(ParticleSystem system, GLfloat* v, Gl3DCoord* right, Gl3DCoord* up)
+{
+    ParticleData* p;
+    ParticleData* stop;
+    Gl3DCoord rx, ry, rz, ux, uy, uz;
+
+    rx = right[0] * system->w;
+    ry = right[1] * system->w;
+    rz = right[2] * system->w;
+    ux = up[0] * system->h;
+    uy = up[1] * system->h;
+    uz = up[2] * system->h;
+
+    stop = system->data + system->nb;
+    for (p = system->data; p != stop; p++)
+    {
+        v[0] = 0.0f;
+        v[1] = 1.0f;
+        v[2] = p->pos[0] - rx + ux;
+        v[3] = p->pos[1] - ry + uy;
+        v[4] = p->pos[2] - rz + uz;
+        v[5] = 1.0f;
+        v[6] = 1.0f;
+        v[7] = p->pos[0] + rx + ux;
+        v[8] = p->pos[1] + ry + uy;
+        v[9] = p->pos[2] + rz + uz;
+        v[10] = 1.0f;
+        v[11] = 0.0f;
+        v[12] = p->pos[0] + rx - ux;
+        v[13] = p->pos[1] + ry - uy;
+        v[14] = p->pos[2] + rz - uz;
+        v[15] = 0.0f;
+        v[16] = 0.0f;
+        v[17] = p->pos[0] - rx - ux;
+        v[18] = p->pos[1] - ry - uy;
+        v[19] = p->pos[2] - rz - uz;
+        v += 4 * VERTEX_SIZE;
+    }
+
+    return v;
+}
+
 /******************************************************************************
  *############################################################################*
  *#                            Internal functions                            #*
  *############################################################################*
  ******************************************************************************/
 Bool
-Particle_processEvent(Particle obj, GlEvent* event)
+ParticleSystem_processEvent(ParticleSystem system, GlEvent* event)
 {
-    if (event->type == GLEVENT_DRAW)
+    if (event->type == GLEVENT_DELETE)
     {
-        if (obj->visible)
+        SDL_DestroyMutex(system->lock);
+        FREE(system->freehandles);
+        FREE(system->handles);
+        FREE(system->data);
+        FREE(system);
+    }
+    return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+int
+ParticleSystem_cmp(ParticleSystem* system1, ParticleSystem* system2)
+{
+    if ((*system1)->tex < (*system2)->tex)
+    {
+        return -1;
+    }
+    else if ((*system1)->tex > (*system2)->tex)
+    {
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void
+particlesDraw(PtrArray systems, CoreTime duration)
+{
+    PtrArrayIterator it;
+    PtrArrayIterator run;
+    ParticleSystem system;
+    GlStaticTexture tex;
+    GLfloat* v;
+    Uint32 nb;
+    Gl3DCoord right[3];
+    Gl3DCoord up[3];
+    Gl3DCoord ca, sa, cb, sb;
+
+    /*modules may change the particles from their threads, they wait for the drawing*/
+    for (it = PtrArray_START(systems); it != PtrArray_STOP(systems); it++)
+    {
+        SDL_mutexP(((ParticleSystem)(*it))->lock);
+    }
+
+    /*simulate all particles at once*/
+    for (it = PtrArray_START(systems); it != PtrArray_STOP(systems); it++)
+    {
+        simulate((ParticleSystem)(*it), duration);
+    }
+
+    /*billboard axis, same as cameraPushObject(x, y, z, global_camangh, global_camangv - M_PI_2)*/
+    ca = cos(-global_camangh);
+    sa = sin(-global_camangh);
+    cb = cos(global_camangv - M_PI_2);
+    sb = sin(global_camangv - M_PI_2);
+    right[0] = ca * cb;
+    right[1] = sb;
+    right[2] = -sa * cb;
+    up[0] = sa;
+    up[1] = 0.0f;
+    up[2] = ca;
+
+    /*systems using the same texture are next to each other*/
+    if (PtrArray_sortNearly(systems, PtrArray_SIZE(systems)))
+    {
+        PtrArray_sort(systems);
+    }
+
+    glDisableClientState(GL_NORMAL_ARRAY);
+    it = PtrArray_START(systems);
+    while (it != PtrArray_STOP(systems))
+    {
+        /*count the particles of this texture*/
+        tex = ((ParticleSystem)(*it))->tex;
+        nb = 0;
+        for (run = it; (run != PtrArray_STOP(systems)) && (((ParticleSystem)(*run))->tex == tex); run++)
         {
-            GlStaticTexture_use(obj->tex);
-            cameraPushObject(obj->x, obj->y, obj->z, global_camangh, global_camangv - M_PI_2);
-            glBegin(GL_TRIANGLE_STRIP);
-                glTexCoord2d(0, 1); glVertex3f(-obj->w, 0.0f, obj->h);
-                glTexCoord2d(1, 1); glVertex3f(obj->w, 0.0f, obj->h);
-                glTexCoord2d(0, 0); glVertex3f(-obj->w, 0.0f, -obj->h);
-                glTexCoord2d(1, 0); glVertex3f(obj->w, 0.0f, -obj->h);
-            glEnd();
-            cameraPopObject();
+            system = (ParticleSystem)(*run);
+            if (system->visible)
+            {
+                nb += system->nb;
+            }
+        }
+
+        if (nb > 0)
+        {
+            if (nb > _vertices_quads)
+            {
+                _vertices_quads = MAX(nb, _vertices_quads * 2);
+                _vertices = REALLOC(_vertices, sizeof(GLfloat) * 4 * VERTEX_SIZE * _vertices_quads);
+            }
+
+            /*expand billboards*/
+            v = _vertices;
+            for (; it != run; it++)
+            {
+                system = (ParticleSystem)(*it);
+                if (system->visible)
+                {
+                    v = expand(system, v, right, up);
+                }
+            }
+
+            /*one draw call for the whole texture*/
+            GlStaticTexture_use(tex);
+            glTexCoordPointer(2, GL_FLOAT, sizeof(GLfloat) * VERTEX_SIZE, _vertices);
+            glVertexPointer(3, GL_FLOAT, sizeof(GLfloat) * VERTEX_SIZE, _vertices + 2);
+            glDrawArrays(GL_QUADS, 0, nb * 4);
         }
+        it = run;
     }
-    else if (event->type == GLEVENT_DELETE)
+    glEnableClientState(GL_NORMAL_ARRAY);
+
+    for (it = PtrArray_START(systems); it != PtrArray_STOP(systems); it++)
     {
-        FREE(obj);
+        SDL_mutexV(((ParticleSystem)(*it))->lock);
     }
-    else if (event->type == GLEVENT_CAMERA)
+}
+
+/*----------------------------------------------------------------------------*/
+void
+particlesUninit(void)
+{
+    if (_vertices != NULL)
     {
-        /*TODO*/
+        FREE(_vertices);
+        _vertices = NULL;
     }
-    return FALSE;
+    _vertices_quads = 0;
 }
 
 /******************************************************************************
@@ -87,60 +367,167 @@ Particle_processEvent(Particle obj, GlEvent* event)
  *#                             Public functions                             #*
  *############################################################################*
  ******************************************************************************/
-Particle
-Particle_new()
+ParticleSystem
+ParticleSystem_new(Uint32 capacity)
 {
-    Particle ret;
-    
-    ret = (Particle)MALLOC(sizeof(pv_Particle));
+    ParticleSystem ret;
+    Uint32 i;
+
+    /*the last handle would make PARTICLE_INVALID with the last generation*/
+    ASSERT(capacity <= HANDLE_MASK, capacity = HANDLE_MASK);
+
+    ret = (ParticleSystem)MALLOC(sizeof(pv_ParticleSystem));
     ret->visible = TRUE;
     ret->tex = GlStaticTexture_NULL;
-    ret->x = 0.0f;
-    ret->y = 0.0f;
-    ret->z = 0.0f;
     ret->w = 0.0f;
     ret->h = 0.0f;
-    
-    graphicsAddParticle(ret);
-    
+    ret->acc[0] = 0.0f;
+    ret->acc[1] = 0.0f;
+    ret->acc[2] = 0.0f;
+    ret->nb = 0;
+    ret->capacity = capacity;
+    ret->data = MALLOC(sizeof(ParticleData) * MAX(capacity, 1));
+    ret->handles = MALLOC(sizeof(ParticleHandle) * MAX(capacity, 1));
+    ret->freehandles = MALLOC(sizeof(Uint32) * MAX(capacity, 1));
+    for (i = 0; i < capacity; i++)
+    {
+        ret->handles[i].pos = 0;
+        ret->handles[i].gen = 0;
+        /*handles are given in increasing order*/
+        ret->freehandles[i] = capacity - 1 - i;
+    }
+    ret->nbfree = capacity;
+    ret->lock = SDL_CreateMutex();
+
+    graphicsAddParticleSystem(ret);
+
     return ret;
 }
 
 /*----------------------------------------------------------------------------*/
 void
-Particle_del(Particle particle)
+ParticleSystem_del(ParticleSystem system)
 {
-    graphicsDelParticle(particle);
-    FREE(particle);
+    /*freed by the graphics thread*/
+    graphicsDelParticleSystem(system);
 }
 
 /*----------------------------------------------------------------------------*/
 void
-Particle_show(Particle particle, Bool show)
+ParticleSystem_show(ParticleSystem system, Bool show)
 {
-    particle->visible = show;
+    SDL_mutexP(system->lock);
+    system->visible = show;
+    SDL_mutexV(system->lock);
 }
 
 /*----------------------------------------------------------------------------*/
 void
-Particle_setTex(Particle particle, String texname)
+ParticleSystem_setTex(ParticleSystem system, String texname)
 {
-    particle->tex = gltexturesGet(texname);
+    GlStaticTexture tex;
+
+    tex = gltexturesGet(texname);
+    SDL_mutexP(system->lock);
+    system->tex = tex;
+    SDL_mutexV(system->lock);
 }
 
 /*----------------------------------------------------------------------------*/
 void
-Particle_setSize(Particle particle, Gl3DCoord sizex, Gl3DCoord sizey)
+ParticleSystem_setSize(ParticleSystem system, Gl3DCoord sizex, Gl3DCoord sizey)
+{
+    SDL_mutexP(system->lock);
+    system->w = sizex / 2.0;
+    system->h = sizey / 2.0;
+    SDL_mutexV(system->lock);
+}
+
+/*----------------------------------------------------------------------------*/
+void
+ParticleSystem_setGravity(ParticleSystem system, Gl3DCoord ax, Gl3DCoord ay, Gl3DCoord az)
+{
+    SDL_mutexP(system->lock);
+    system->acc[0] = ax;
+    system->acc[1] = ay;
+    system->acc[2] = az;
+    SDL_mutexV(system->lock);
+}
+
+/*----------------------------------------------------------------------------*/
+void
+ParticleSystem_clear(ParticleSystem system)
+{
+    Uint32 i;
+
+    SDL_mutexP(system->lock);
+    for (i = 0; i < system->nb; i++)
+    {
+        freeHandle(system, system->data[i].handle);
+    }
+    system->nb = 0;
+    SDL_mutexV(system->lock);
+}
+
+/*----------------------------------------------------------------------------*/
+Uint32
+ParticleSystem_getCount(ParticleSystem system)
 {
-    particle->w = sizex / 2.0;
-    particle->h = sizey / 2.0;
+    Uint32 ret;
+
+    SDL_mutexP(system->lock);
+    ret = system->nb;
+    SDL_mutexV(system->lock);
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+ParticleID
+ParticleSystem_emit(ParticleSystem system, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z, Gl3DCoord vx, Gl3DCoord vy, Gl3DCoord vz, CoreTime life)
+{
+    ParticleData* p;
+    ParticleID ret;
+    Uint32 handle;
+
+    SDL_mutexP(system->lock);
+    if (system->nb >= system->capacity)
+    {
+        SDL_mutexV(system->lock);
+        return PARTICLE_INVALID;
+    }
+
+    handle = system->freehandles[--system->nbfree];
+    system->handles[handle].pos = system->nb;
+
+    p = system->data + system->nb;
+    p->pos[0] = x;
+    p->pos[1] = y;
+    p->pos[2] = z;
+    p->vel[0] = vx;
+    p->vel[1] = vy;
+    p->vel[2] = vz;
+    p->life = life;
+    p->handle = handle;
+    system->nb++;
+
+    ret = MAKE_ID(system, handle);
+    SDL_mutexV(system->lock);
+    return ret;
 }
 
 /*----------------------------------------------------------------------------*/
 void
-Particle_setPos(Particle particle, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z)
+ParticleSystem_setPos(ParticleSystem system, ParticleID particle, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z)
 {
-    particle->x = x;
-    particle->y = y;
-    particle->z = z;
+    ParticleData* p;
+
+    SDL_mutexP(system->lock);
+    p = findParticle(system, particle);
+    if (p != NULL)
+    {
+        p->pos[0] = x;
+        p->pos[1] = y;
+        p->pos[2] = z;
+    }
+    SDL_mutexV(system->lock);
 }
@@ -48,6 +48,18 @@ Uint32 GlColor_Bshift;
 Uint32 GlColor_Amask;
 Uint32 GlColor_Ashift;
 
+/******************************************************************************
+ *                             Static variables                               *
+ ******************************************************************************/
+static VarKey _key_r = VAR_KEY("r");
+static VarKey _key_g = VAR_KEY("g");
+static VarKey _key_b = VAR_KEY("b");
+static VarKey _key_a = VAR_KEY("a");
+static VarKey _key_x = VAR_KEY("x");
+static VarKey _key_y = VAR_KEY("y");
+static VarKey _key_w = VAR_KEY("w");
+static VarKey _key_h = VAR_KEY("h");
+
 /******************************************************************************
  *############################################################################*
  *#                             Internal functions                           #*
@@ -84,10 +96,10 @@ ColorRGBA_makeFromVar(GlColorRGBA* col, Var v)
     VarValidator_validate(valid, v);
     VarValidator_del(valid);
     
-    col->r = Var_getValueInt(Var_getArrayElemByCName(v, "r"));
-    col->g = Var_getValueInt(Var_getArrayElemByCName(v, "g"));
-    col->b = Var_getValueInt(Var_getArrayElemByCName(v, "b"));
-    col->a = Var_getValueInt(Var_getArrayElemByCName(v, "a"));
+    col->r = Var_getValueInt(Var_getArrayElemByKey(v, &_key_r));
+    col->g = Var_getValueInt(Var_getArrayElemByKey(v, &_key_g));
+    col->b = Var_getValueInt(Var_getArrayElemByKey(v, &_key_b));
+    col->a = Var_getValueInt(Var_getArrayElemByKey(v, &_key_a));
 }
 
 /*----------------------------------------------------------------------------*/
@@ -177,8 +189,8 @@ GlRect_makeFromVar(GlRect* rct, Var vrct)
     VarValidator_validate(valid, vrct);
     VarValidator_del(valid);
     
-    rct->x = (Gl2DCoord)Var_getValueInt(Var_getArrayElemByCName(vrct, "x"));
-    rct->y = (Gl2DCoord)Var_getValueInt(Var_getArrayElemByCName(vrct, "y"));
-    rct->w = (Gl2DSize)Var_getValueInt(Var_getArrayElemByCName(vrct, "w"));
-    rct->h = (Gl2DSize)Var_getValueInt(Var_getArrayElemByCName(vrct, "h"));
+    rct->x = (Gl2DCoord)Var_getValueInt(Var_getArrayElemByKey(vrct, &_key_x));
+    rct->y = (Gl2DCoord)Var_getValueInt(Var_getArrayElemByKey(vrct, &_key_y));
+    rct->w = (Gl2DSize)Var_getValueInt(Var_getArrayElemByKey(vrct, &_key_w));
+    rct->h = (Gl2DSize)Var_getValueInt(Var_getArrayElemByKey(vrct, &_key_h));
 }
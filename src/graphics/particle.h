@@ -28,7 +28,7 @@
 
 /*!
  * \file
- * \brief 3D particle objects.
+ * \brief 3D particle systems.
  */
 
 /******************************************************************************
@@ -42,14 +42,32 @@
  *                                  Typedefs                                  *
  ******************************************************************************/
 /*!
- * \brief Private structure of a particle.
+ * \brief Private structure of a particle system.
  */
-typedef struct pv_Particle pv_Particle;
+typedef struct pv_ParticleSystem pv_ParticleSystem;
 
 /*!
- * \brief Abstract type for a graphical particle.
+ * \brief Abstract type for a particle system.
+ *
+ * A particle system owns a fixed pool of billboarded particles sharing the same texture.
+ * Particles are simulated and drawn in bulk, systems using the same texture are drawn
+ * together. The functions can be called from any thread, they wait while the graphics
+ * thread simulates and draws the particles.
+ */
+typedef pv_ParticleSystem* ParticleSystem;
+
+/*!
+ * \brief Identifier of a particle inside its system.
+ *
+ * An identifier stays valid until its particle expires or the system is cleared,
+ * then the functions given it do nothing.
+ */
+typedef Uint32 ParticleID;
+
+/*!
+ * \brief Invalid particle index.
  */
-typedef pv_Particle* Particle;
+#define PARTICLE_INVALID ((ParticleID)-1)
 
 /******************************************************************************
  *############################################################################*
@@ -57,52 +75,95 @@ typedef pv_Particle* Particle;
  *############################################################################*
  ******************************************************************************/
 /*!
- * \brief Create a new particle.
+ * \brief Create a new particle system.
  *
- * \return The newly allocated particle.
+ * \param capacity - Maximal number of particles alive at the same time, up to 65535.
+ * \return The newly allocated particle system.
  */
-Particle Particle_new(void);
+ParticleSystem ParticleSystem_new(Uint32 capacity);
 
 /*!
- * \brief Delete a particle.
+ * \brief Delete a particle system and all its particles.
  *
- * \param particle - The particle.
+ * \param system - The particle system.
  */
-void Particle_del(Particle particle);
+void ParticleSystem_del(ParticleSystem system);
 
 /*!
- * \brief Set a particle visibility.
+ * \brief Set a particle system visibility.
  *
- * \param particle - The particle.
- * \param show - Show the particle or not.
+ * Hidden systems are still simulated.
+ * \param system - The particle system.
+ * \param show - Show the particles or not.
  */
-void Particle_show(Particle particle, Bool show);
+void ParticleSystem_show(ParticleSystem system, Bool show);
 
 /*!
- * \brief Set the texture of a particle
+ * \brief Set the texture of all particles of a system.
  *
- * \param particle - The particle.
+ * \param system - The particle system.
  * \param texname - Name of the texture to use.
  */
-void Particle_setTex(Particle particle, String texname);
+void ParticleSystem_setTex(ParticleSystem system, String texname);
+
+/*!
+ * \brief Set the size of all particles of a system.
+ *
+ * \param system - The particle system.
+ * \param sizex - X size of the particles.
+ * \param sizey - Y size of the particles.
+ */
+void ParticleSystem_setSize(ParticleSystem system, Gl3DCoord sizex, Gl3DCoord sizey);
+
+/*!
+ * \brief Set the constant acceleration applied to all particles of a system.
+ *
+ * \param system - The particle system.
+ * \param ax - X acceleration, in units per second per second.
+ * \param ay - Y acceleration.
+ * \param az - Z acceleration.
+ */
+void ParticleSystem_setGravity(ParticleSystem system, Gl3DCoord ax, Gl3DCoord ay, Gl3DCoord az);
+
+/*!
+ * \brief Remove all particles of a system.
+ *
+ * \param system - The particle system.
+ */
+void ParticleSystem_clear(ParticleSystem system);
+
+/*!
+ * \brief Get the number of particles alive in a system.
+ *
+ * \param system - The particle system.
+ * \return The number of particles.
+ */
+Uint32 ParticleSystem_getCount(ParticleSystem system);
 
 /*!
- * \brief Set the size of a particle
+ * \brief Emit a new particle.
  *
- * \param particle - The particle.
- * \param sizex - X size of the particle.
- * \param sizey - Y size of the particle.
+ * \param system - The particle system.
+ * \param x - Start X coordinate.
+ * \param y - Start Y coordinate.
+ * \param z - Start Z coordinate.
+ * \param vx - X velocity, in units per second.
+ * \param vy - Y velocity.
+ * \param vz - Z velocity.
+ * \param life - Lifetime of the particle in milliseconds, 0 for a particle that never expires.
+ * \return The particle identifier, PARTICLE_INVALID if the system is full.
  */
-void Particle_setSize(Particle particle, Gl3DCoord sizex, Gl3DCoord sizey);
+ParticleID ParticleSystem_emit(ParticleSystem system, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z, Gl3DCoord vx, Gl3DCoord vy, Gl3DCoord vz, CoreTime life);
 
 /*!
  * \brief Set the position of a particle.
  *
- * \param particle - The particle.
+ * \param system - The particle system.
+ * \param particle - The particle identifier.
  * \param x - New X coordinate.
  * \param y - New Y coordinate.
  * \param z - New Z coordinate.
  */
-void Particle_setPos(Particle particle, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z);
+void ParticleSystem_setPos(ParticleSystem system, ParticleID particle, Gl3DCoord x, Gl3DCoord y, Gl3DCoord z);
 
 #endif
@@ -433,7 +433,7 @@ menusUninit()
 void
 menusSet(Var v)
 {
-    int i;
+    VarArrayPos i;
     
     PtrArray_clear(_menutemplates);
     
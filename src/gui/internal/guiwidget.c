@@ -61,6 +61,8 @@ struct pv_GuiWidget
     GlRect rect;                    /*rectangle effectively occupied inside the parent surface (top level)*/
     Sint16 alt;                     /*altitude (top-level)*/
     Bool contentchanged;            /*TRUE if the content of drawsurf changed*/
+    Bool childchanged;              /*TRUE if a widget below this one has to be redrawn*/
+    Bool moved;                     /*TRUE if the rectangle changed since the last drawing*/
     GuiEventCallback upcallback;    /*callback called when an event is received from the parent*/
     GlEventCallback downcallback;   /*callback called when an event is received from a child*/
     unsigned int nbchildren;        /*number of children*/
@@ -112,62 +114,129 @@ correctChildrenParentSurf(GuiWidget widget, GlSurface parentsurf)
 }
 
 /*----------------------------------------------------------------------------*/
-static Bool
-GuiWidget_draw(GuiWidget widget, Bool parentchanged)
+/*tell the ancestors that something below them has to be redrawn*/
+static void
+propagateChange(GuiWidget widget)
+{
+    widget = widget->parent;
+    while ((widget != NULL) && (!widget->childchanged))
+    {
+        widget->childchanged = TRUE;
+        widget = widget->parent;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*put an area (absolute, inside the widget) of the drawing surface into the parent surface*/
+static void
+compose(GuiWidget widget, GlRect* area, Bool savebackground)
+{
+    GlRect local;
+    
+    local = *area;
+    local.x -= widget->rect.x;
+    local.y -= widget->rect.y;
+    
+    if (savebackground)
+    {
+        /*what lies below changed, keep it*/
+        GlSurface_copyRect(widget->parentsurf, widget->savesurf, area, &local);
+    }
+    else
+    {
+        /*restore what lies below*/
+        GlSurface_copyRect(widget->savesurf, widget->parentsurf, &local, area);
+    }
+    GlSurface_doBlit(widget->drawsurf, widget->parentsurf, &local, area);
+}
+
+/*----------------------------------------------------------------------------*/
+static Bool GuiWidget_draw(GuiWidget widget, GlRect* damage);
+
+/*----------------------------------------------------------------------------*/
+/*redraw the children over a damaged area of the parent surface*/
+static void
+drawChildren(GuiWidget widget, GlRect* damage)
 {
     unsigned int i;
-    Bool redraw;
     
-    if (parentchanged)
+    for (i = 0; i < widget->nbchildren; i++)
     {
-        if (widget->savesurf != NULL)
+        if (widget->children[i] != NULL)
         {
-            /*save the parent surface*/
-            GlSurface_copyRect(widget->parentsurf, widget->savesurf, &widget->rect, NULL);
-            
-            /*blit the drawing surface*/
-            GlSurface_doBlit(widget->drawsurf, widget->parentsurf, NULL, &widget->rect);
+            GuiWidget_draw(widget->children[i], damage);
         }
-        
-        /*pass to children*/
-        for (i = 0; i < widget->nbchildren; i++)
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*damage is the area of the parent surface that was redrawn below the widget, NULL if none*/
+static Bool
+GuiWidget_draw(GuiWidget widget, GlRect* damage)
+{
+    GlRect area;
+    GlRect dirty[GLSURFACE_DIRTY_NB];
+    Uint16 nb, j;
+    unsigned int i;
+    GuiWidget child;
+    Bool redraw = FALSE;
+    
+    if (damage != NULL)
+    {
+        area = *damage;
+        GlRect_clip(&area, &widget->rect);
+        if ((area.w != 0) && (area.h != 0))
         {
-            if (widget->children[i] != NULL)
+            if (widget->savesurf != NULL)
             {
-                GuiWidget_draw(widget->children[i], TRUE);
+                compose(widget, &area, TRUE);
             }
+            drawChildren(widget, &area);
+            redraw = TRUE;
         }
-        
+    }
+    
+    if (widget->moved)
+    {
+        /*the saved background is no longer valid, take everything again*/
+        if (widget->savesurf != NULL)
+        {
+            compose(widget, &widget->rect, TRUE);
+            GlSurface_takeDirty(widget->drawsurf, dirty);
+        }
+        drawChildren(widget, &widget->rect);
         redraw = TRUE;
     }
-    else
+    else if (widget->contentchanged && (widget->savesurf != NULL))
     {
-        redraw = FALSE;
-        
-        if (widget->contentchanged)
+        /*only the areas the holder drew into*/
+        nb = GlSurface_takeDirty(widget->drawsurf, dirty);
+        for (j = 0; j < nb; j++)
         {
-            ASSERT(widget->savesurf != NULL, return FALSE);
-            
-            /*restore the parent*/
-            GlSurface_copyRect(widget->savesurf, widget->parentsurf, NULL, &widget->rect);
-            
-            /*blit the new content*/
-            GlSurface_doBlit(widget->drawsurf, widget->parentsurf, NULL, &widget->rect);
-            
+            area = dirty[j];
+            area.x += widget->rect.x;
+            area.y += widget->rect.y;
+            compose(widget, &area, FALSE);
+            drawChildren(widget, &area);
             redraw = TRUE;
         }
-        
-        /*pass to children*/
+    }
+    
+    if (widget->childchanged)
+    {
         for (i = 0; i < widget->nbchildren; i++)
         {
-            if ((widget->children[i] != NULL) && (GuiWidget_draw(widget->children[i], widget->contentchanged)))
+            child = widget->children[i];
+            if ((child != NULL) && (child->contentchanged | child->childchanged | child->moved) && GuiWidget_draw(child, NULL))
             {
-                redraw = TRUE;  /*at least one child had to redraw itself*/
+                redraw = TRUE;
             }
         }
     }
     
     widget->contentchanged = FALSE;
+    widget->childchanged = FALSE;
+    widget->moved = FALSE;
     return redraw;
 }
 
@@ -178,6 +247,12 @@ GuiWidget_setRect(GuiWidget widget, GlRect rct)
 {
     Bool ret = FALSE;
     
+    if ((widget->parent != NULL) && ((rct.x != widget->rect.x) | (rct.y != widget->rect.y) | (rct.w != widget->rect.w) | (rct.h != widget->rect.h)))
+    {
+        widget->moved = TRUE;
+        propagateChange(widget);
+    }
+    
     if ((rct.w != widget->rect.w) | (rct.h != widget->rect.h))
     {
         if (widget->savesurf != NULL)       /*not parent and not container*/
@@ -219,6 +294,9 @@ static Bool
 GuiWidget_processEventDown(GuiWidget widget, GlEvent* event)
 {
     GlEvent ev, evf;
+    GlRect dirty[GLSURFACE_DIRTY_NB];
+    Uint16 nb, j;
+    GuiWidget child;
     unsigned int i;
     Sint16 posx, posy;
     Bool r;
@@ -272,19 +350,35 @@ GuiWidget_processEventDown(GuiWidget widget, GlEvent* event)
             return TRUE;
     
         case GLEVENT_DRAW:
-            r = FALSE;
+            if (!(widget->contentchanged | widget->childchanged))
+            {
+                /*nothing changed*/
+                break;
+            }
+            r = widget->contentchanged;
+            if (widget->contentchanged)
+            {
+                /*the Gl2DObject still needs these areas, only look at them*/
+                nb = GlSurface_getDirty(widget->drawsurf, dirty);
+                for (j = 0; j < nb; j++)
+                {
+                    drawChildren(widget, dirty + j);
+                }
+            }
             for (i = 0; i < widget->nbchildren; i++)
             {
-                if ((widget->children[i] != NULL) && GuiWidget_draw(widget->children[i], widget->contentchanged))
+                child = widget->children[i];
+                if ((child != NULL) && (child->contentchanged | child->childchanged | child->moved) && GuiWidget_draw(child, NULL))
                 {
                     r = TRUE;
                 }
             }
-            if (r | widget->contentchanged)
+            if (r)
             {
                 Gl2DObject_redraw(widget->globj);
             }
             widget->contentchanged = FALSE;
+            widget->childchanged = FALSE;
             break;
             
         case GLEVENT_MOUSE:
@@ -452,6 +546,8 @@ GuiWidget_new(GuiWidget parent, void* holder, const char* tooltip, Bool containe
         ret->tooltip = String_new(tooltip);
     }
     ret->contentchanged = FALSE;
+    ret->childchanged = FALSE;
+    ret->moved = FALSE;
     
     if (parent == NULL)
     {
@@ -738,6 +834,7 @@ void
 GuiWidget_redraw(GuiWidget widget)
 {
     widget->contentchanged = TRUE;
+    propagateChange(widget);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -188,6 +188,8 @@ void GuiWidget_throwEvent(GuiWidget widget, GuiEvent event);
  *
  * Only call this when the drawing surface has been modified.
  * This function only changes a state of the widget ; the real redrawing is performed on graphical frame drawing.
+ * Only the areas of the drawing surface that changed since the last frame are redrawn,
+ * use GlSurface_setDirty after modifying the surface without the GlSurface functions.
  * \param widget - The widget to redraw.
  */
 void GuiWidget_redraw(GuiWidget widget);
@@ -51,11 +51,13 @@ static WorldCoord map_w;
 static WorldCoord map_h;
 static MapPlot* map_plot;
 static GlSurface map_surf;
+static GlSurface map_base;  /*plots only, map_surf adds the camera cone over it*/
 static GuiLayout map_layout;
 static GlColor map_color[7];
 static GuiWidget _widget;
 static GlRect rct_src;      /*rectangle inside the whole map*/
 static GlRect rct_dest;     /*rectangle inside the gui surface*/
+static GlRect rct_cone;     /*area of the gui surface covered by the camera cone*/
 
 static Sint16 camposx;
 static Sint16 camposy;
@@ -137,32 +139,146 @@ precompRects()
 }
     
 /*----------------------------------------------------------------------------*/
+/*Plot an area of the visible map (relative to rct_src) into the plot layer*/
 static void
-worldmapRedraw()
+plotArea(WorldCoord x, WorldCoord y, WorldCoord w, WorldCoord h)
 {
-    WorldCoord x;
-    WorldCoord y;
-    float ang;
-    float dist;
+    WorldCoord i, j;
     
-    GlSurface_clear(map_surf, map_color[0]);
-    for (y = 0; y < rct_src.h; y++)
+    for (j = y; j < y + h; j++)
     {
-        for (x = 0; x < rct_src.w; x++)
+        for (i = x; i < x + w; i++)
         {
-            GlSurface_drawPixel(map_surf, rct_dest.x + x, rct_dest.y + y, getCol(map_plot[(rct_src.y + y) * map_w + (rct_src.x + x)]));
+            GlSurface_drawPixel(map_base, rct_dest.x + i, rct_dest.y + j, getCol(map_plot[(rct_src.y + j) * map_w + (rct_src.x + i)]));
         }
     }
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+drawCone()
+{
+    float ang;
+    float dist;
+    Gl2DCoord x0, y0, x1, y1, x2, y2;
+    int xmin, ymin, xmax, ymax;
     
     /*TODO: maybe store ang and dist*/
     ang = angle2d((float)(camlookx - camposx), (float)(camlooky - camposy));
     dist = dist2d((float)camlookx, (float)camlooky, (float)camposx, (float)camposy);
-    GlSurface_drawLineCut(map_surf, camposx - rct_src.x + rct_dest.x, camposy - rct_src.y + rct_dest.y, camposx + cos(ang + M_PI_4) * dist - rct_src.x + rct_dest.x, camposy + sin(ang + M_PI_4) * dist - rct_src.y + rct_dest.y, map_color[6]);
-    GlSurface_drawLineCut(map_surf, camposx - rct_src.x + rct_dest.x, camposy - rct_src.y + rct_dest.y, camposx + cos(ang - M_PI_4) * dist - rct_src.x + rct_dest.x, camposy + sin(ang - M_PI_4) * dist - rct_src.y + rct_dest.y, map_color[6]);
+    x0 = camposx - rct_src.x + rct_dest.x;
+    y0 = camposy - rct_src.y + rct_dest.y;
+    x1 = camposx + cos(ang + M_PI_4) * dist - rct_src.x + rct_dest.x;
+    y1 = camposy + sin(ang + M_PI_4) * dist - rct_src.y + rct_dest.y;
+    x2 = camposx + cos(ang - M_PI_4) * dist - rct_src.x + rct_dest.x;
+    y2 = camposy + sin(ang - M_PI_4) * dist - rct_src.y + rct_dest.y;
+    GlSurface_drawLineCut(map_surf, x0, y0, x1, y1, map_color[6]);
+    GlSurface_drawLineCut(map_surf, x0, y0, x2, y2, map_color[6]);
+    
+    /*remember where it is to erase it*/
+    xmin = MAX(MIN(x0, MIN(x1, x2)), 0);
+    ymin = MAX(MIN(y0, MIN(y1, y2)), 0);
+    xmax = MIN(MAX(x0, MAX(x1, x2)), GlSurface_getWidth(map_surf) - 1);
+    ymax = MIN(MAX(y0, MAX(y1, y2)), GlSurface_getHeight(map_surf) - 1);
+    if ((xmax < xmin) || (ymax < ymin))
+    {
+        GlRect_MAKE(rct_cone, 0, 0, 0, 0);
+    }
+    else
+    {
+        GlRect_MAKE(rct_cone, xmin, ymin, xmax - xmin + 1, ymax - ymin + 1);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+eraseCone()
+{
+    if ((rct_cone.w != 0) && (rct_cone.h != 0))
+    {
+        GlSurface_copyRect(map_base, map_surf, &rct_cone, &rct_cone);
+        GlRect_MAKE(rct_cone, 0, 0, 0, 0);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*Plot the whole visible map again, only needed when the plots or the size changed*/
+static void
+worldmapRedraw()
+{
+    GlSurface_clear(map_base, map_color[0]);
+    plotArea(0, 0, rct_src.w, rct_src.h);
+    GlSurface_copyRectSecure(map_base, map_surf, NULL, NULL);
+    drawCone();
     
     GuiWidget_redraw(_widget);
 }
 
+/*----------------------------------------------------------------------------*/
+/*Follow a move of rct_src, only the uncovered edges are plotted*/
+static void
+worldmapScroll(Sint16 dx, Sint16 dy)
+{
+    GlRect rct;
+    
+    eraseCone();
+    
+    rct.x = rct_dest.x + MAX(dx, 0);
+    rct.y = rct_dest.y + MAX(dy, 0);
+    rct.w = rct_src.w - ABS(dx);
+    rct.h = rct_src.h - ABS(dy);
+    GlSurface_movePart(map_base, rct, -dx, -dy);
+    
+    if (dx > 0)
+    {
+        plotArea(rct_src.w - dx, 0, dx, rct_src.h);
+    }
+    else if (dx < 0)
+    {
+        plotArea(0, 0, -dx, rct_src.h);
+    }
+    if (dy > 0)
+    {
+        plotArea(0, rct_src.h - dy, rct_src.w, dy);
+    }
+    else if (dy < 0)
+    {
+        plotArea(0, 0, rct_src.w, -dy);
+    }
+    
+    rct = rct_dest;
+    GlSurface_copyRect(map_base, map_surf, &rct, &rct);
+    drawCone();
+    
+    GuiWidget_redraw(_widget);
+}
+
+/*----------------------------------------------------------------------------*/
+/*Show the change of a plot*/
+static void
+updatePlot(WorldCoord x, WorldCoord y, MapPlot oldplot)
+{
+    GlColor col;
+    Gl2DCoord px, py;
+    
+    col = getCol(map_plot[y * map_w + x]);
+    if ((!isInRect(&rct_src, x, y)) || (col == getCol(oldplot)))
+    {
+        return;
+    }
+    
+    px = rct_dest.x + x - rct_src.x;
+    py = rct_dest.y + y - rct_src.y;
+    GlSurface_drawPixel(map_base, px, py, col);
+    GlSurface_drawPixel(map_surf, px, py, col);
+    if (isInRect(&rct_cone, px, py))
+    {
+        /*the cone may pass over it*/
+        drawCone();
+    }
+    GuiWidget_redraw(_widget);
+}
+
 /*----------------------------------------------------------------------------*/
 static Bool
 gleventCallback(GlExtID data, GlEvent* event)
@@ -175,7 +291,9 @@ gleventCallback(GlExtID data, GlEvent* event)
         camposy = (Sint16)event->event.camevent.newcam.posz;
         camlookx = (Sint16)event->event.camevent.newcam.lookx;
         camlooky = (Sint16)event->event.camevent.newcam.lookz;
-        worldmapRedraw();
+        eraseCone();
+        drawCone();
+        GuiWidget_redraw(_widget);
     }
     else if (event->type == GLEVENT_RESIZE)
     {
@@ -258,9 +376,10 @@ threadCallback(CoreID thread, CoreTime duration)
     if (movetime >= 50)
     {
         Sint16 mx, my;
-        Bool redraw;
+        Sint16 dx, dy;
         
-        redraw = FALSE;
+        dx = 0;
+        dy = 0;
         movetime -= 50;
         
         if (dontmove)
@@ -272,27 +391,25 @@ threadCallback(CoreID thread, CoreTime duration)
         my = rct_src.y + rct_src.h / 2;
         if ((mx < camlookx) && (rct_src.x + rct_src.w < map_w))
         {
-            rct_src.x++;
-            redraw = TRUE;
+            dx = 1;
         }
         if ((mx > camlookx) && (rct_src.x > 0))
         {
-            rct_src.x--;
-            redraw = TRUE;
+            dx = -1;
         }
         if ((my < camlooky) && (rct_src.y + rct_src.h < map_h))
         {
-            rct_src.y++;
-            redraw = TRUE;
+            dy = 1;
         }
         if ((my > camlooky) && (rct_src.y > 0))
         {
-            rct_src.y--;
-            redraw = TRUE;
+            dy = -1;
         }
-        if (redraw)
+        if ((dx != 0) || (dy != 0))
         {
-            worldmapRedraw();
+            rct_src.x += dx;
+            rct_src.y += dy;
+            worldmapScroll(dx, dy);
         }
     }
 }
@@ -310,6 +427,8 @@ worldmapInit()
     map_plot = MALLOC(sizeof(map_plot) * map_w * map_h);
     _widget = GuiWidget_new(NULL, NULL, _("World map (click to move the camera)"), FALSE, NULL, gleventCallback);
     map_surf = GuiWidget_getDrawingSurface(_widget);
+    map_base = GlSurface_newByCopy(map_surf);
+    GlRect_MAKE(rct_cone, 0, 0, 0, 0);
     map_layout.dock = 5;
     map_layout.xoffset = 0;
     map_layout.yoffset = 0;
@@ -336,7 +455,7 @@ worldmapInit()
     FUNC_REDRAW = coreDeclareShellFunction(MOD_ID, "redraw", VAR_VOID, 0);
     RESEXT_WORLDWIDTH = coreAddResourceWatcher(MOD_ID, "world_width");
     RESEXT_WORLDHEIGHT = coreAddResourceWatcher(MOD_ID, "world_height");
-    coreRequireThreadSlot(MOD_ID, coreGetThreadID(NULL));
+    coreRequireIndependentThreadSlot(MOD_ID, coreGetThreadID(NULL));
 }
 
 /*----------------------------------------------------------------------------*/
@@ -345,6 +464,7 @@ worldmapUninit()
 {
     FREE(map_plot);
     GuiWidget_del(_widget);
+    GlSurface_del(map_base);
     shellPrint(LEVEL_INFO, "Map unloaded.");
 }
 
@@ -379,6 +499,8 @@ worldmapSet(Var varset)
     GlRect_MAKE(rct, 0, 0, Var_getValueInt(Var_getArrayElemByCName(varset, "width")), Var_getValueInt(Var_getArrayElemByCName(varset, "height")));
     GuiWidget_topLevelSet(_widget, 0, rct);
     map_surf = GuiWidget_getDrawingSurface(_widget);
+    GlSurface_resize(map_base, GlSurface_getWidth(map_surf), GlSurface_getHeight(map_surf), SURFACE_UNDEFINED);
+    GlRect_MAKE(rct_cone, 0, 0, 0, 0);
     precompRects();
     
     GuiLayout_paramFromVar(&map_layout, Var_getArrayElemByCName(varset, "layout"));
@@ -424,28 +546,26 @@ worldmapClear()
 void
 worldmapSetPlot(WorldCoord x, WorldCoord y, MapPlot plot)
 {
+    MapPlot oldplot;
+    
     ASSERT(x < map_w, return);
     ASSERT(y < map_h, return);
     
+    oldplot = map_plot[y * map_w + x];
     map_plot[y * map_w + x] |= plot;
-    if (isInRect(&rct_src, x, y))
-    {
-        GlSurface_drawPixel(map_surf, rct_dest.x + x - rct_src.x, rct_dest.y + y - rct_src.y, getCol(map_plot[y * map_w + x]));
-        GuiWidget_redraw(_widget);
-    }
+    updatePlot(x, y, oldplot);
 }
 
 /*----------------------------------------------------------------------------*/
 void
 worldmapUnsetPlot(WorldCoord x, WorldCoord y, MapPlot plot)
 {
+    MapPlot oldplot;
+    
     ASSERT(x < map_w, return);
     ASSERT(y < map_h, return);
     
+    oldplot = map_plot[y * map_w + x];
     map_plot[y * map_w + x] &= (~plot);
-    if (isInRect(&rct_src, x, y))
-    {
-        GlSurface_drawPixel(map_surf, rct_dest.x + x, rct_dest.y + y, getCol(map_plot[(rct_src.y + y) * map_w + (rct_src.x + x)]));
-        GuiWidget_redraw(_widget);
-    }
+    updatePlot(x, y, oldplot);
 }
@@ -68,6 +68,7 @@ static Bool paused = FALSE;
 static CoreID MOD_ID = CORE_INVALID_ID;
 static CoreID FUNC_VERSION = CORE_INVALID_ID;
 static CoreID FUNC_VERSIONFULL = CORE_INVALID_ID;
+static CoreID FUNC_MEMPOOLS = CORE_INVALID_ID;
 
 static char* language = NULL;
 
@@ -91,6 +92,11 @@ shellCallback(ShellFunction* func)
         Var_setString(func->ret, s);
         String_del(s);
     }
+    else if (func->id == FUNC_MEMPOOLS)
+    {
+        memPrintPools();
+        Var_setVoid(func->ret);
+    }
 }
 
 /*----------------------------------------------------------------------------*/
@@ -125,6 +131,7 @@ kernelInit()
     MOD_ID = coreDeclareModule("kernel", coreCallback, NULL, shellCallback, NULL, NULL, NULL);
     FUNC_VERSION = coreDeclareShellFunction(MOD_ID, "version", VAR_STRING, 0);
     FUNC_VERSIONFULL = coreDeclareShellFunction(MOD_ID, "versionfull", VAR_STRING, 0);
+    FUNC_MEMPOOLS = coreDeclareShellFunction(MOD_ID, "mempools", VAR_VOID, 0);
 
     /*infos*/
     SDL_VERSION(&compile_version);
@@ -154,6 +161,9 @@ kernelInit()
     groundInit();
     envInit();
 
+    /*benchmarks and checks*/
+    testInit();
+
     inited = TRUE;
 
     /*Start the core main thread, that will return when the game is finished and ready to uninit.*/
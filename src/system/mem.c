@@ -32,6 +32,25 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include "SDL_thread.h"
+
+/******************************************************************************
+ *                                 Constants                                  *
+ ******************************************************************************/
+/*Approximative size of a pool slab, in bytes*/
+#define MEMPOOL_SLAB_SIZE 16384
+
+/*Minimal number of objects in a pool slab*/
+#define MEMPOOL_SLAB_MINOBJS 16
+
+/*Size of the slab header, keeping objects aligned*/
+#define MEMPOOL_SLAB_HEADER 16
+
+/*Number of objects moved at once between a thread cache and the shared part of a pool*/
+#define MEMPOOL_BATCH 32
+
+/*Maximal number of threads having their own pool caches*/
+#define MEM_THREADS_NB 16
 
 /******************************************************************************
  *                                  Typedefs                                  *
@@ -44,16 +63,279 @@ typedef struct
     unsigned int line;
     size_t size;
 } MemAllocated;
+#endif
+
+/*Link between free objects, or between slabs*/
+typedef struct pv_MemLink
+{
+    struct pv_MemLink* next;
+} MemLink;
+
+/*Free objects list and counters*/
+typedef struct
+{
+    MemLink* free;          /*free objects*/
+    Uint32 nbfree;          /*number of free objects*/
+    Uint32 nballoc;         /*number of allocations served*/
+    Uint32 nbfreed;         /*number of freeings received*/
+    size_t size;            /*pool objects size as last read by the owner thread, caches only*/
+} MemCache;
+
+typedef struct
+{
+    size_t size;            /*objects size, 0 until the first allocation*/
+    Uint32 perslab;         /*number of objects in a slab*/
+    MemLink* slabs;         /*slabs list, the link is at the start of each slab*/
+    Uint32 nbslabs;         /*number of slabs*/
+    MemCache shared;        /*shared part, protected by the lock*/
+    MemCache caches[MEM_THREADS_NB];    /*caches of the registered threads*/
+    SDL_mutex* lock;
+} MemPoolData;
 
 /******************************************************************************
  *                              Static variables                              *
  ******************************************************************************/
+#ifdef DEBUG_MEM
 static MemAllocated* debug_mem;
 static unsigned int debug_mem_len;
 static unsigned int debug_mem_alloclen;
 static SDL_mutex* debug_mutex;
 #endif
 
+static MemPoolData _pools[MEMPOOL_NB];
+static const char* _poolnames[MEMPOOL_NB] = {"String", "Var", "Gl3DObject", "GlMeshControl"};
+
+static Uint32 _threadids[MEM_THREADS_NB];   /*SDL identifiers of the registered threads*/
+static Uint8 _threadused[MEM_THREADS_NB];   /*1 if the slot is taken by a thread*/
+static SDL_mutex* _threads_lock;
+#ifdef HAVE_THREAD_LOCAL
+static THREAD_LOCAL int _threadslot = -1;  /*slot of the calling thread, set at registration*/
+#endif
+
+/******************************************************************************
+ *############################################################################*
+ *#                            Private functions                             #*
+ *############################################################################*
+ ******************************************************************************/
+/*Find the slot of a thread, -1 if not registered (_threads_lock must be held)*/
+static int
+findSlot(Uint32 id)
+{
+    int i;
+    
+    for (i = 0; i < MEM_THREADS_NB; i++)
+    {
+        if ((_threadused[i]) && (_threadids[i] == id))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/*----------------------------------------------------------------------------*/
+/*This function gives the pool cache slot of the calling thread, -1 if not registered*/
+static int
+currentSlot(void)
+{
+#ifdef HAVE_THREAD_LOCAL
+    return _threadslot;
+#else
+    int slot;
+    
+    SDL_mutexP(_threads_lock);
+    slot = findSlot(SDL_ThreadID());
+    SDL_mutexV(_threads_lock);
+    
+    return slot;
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+/*This function adds a slab to a pool, its objects go to the shared part (pool must be locked)*/
+static void
+newSlab(MemPoolData* pool, size_t size)
+{
+    MemLink* slab;
+    Uint8* obj;
+    Uint32 i;
+    
+    if (pool->size == 0)
+    {
+        /*first use, objects are kept aligned*/
+        pool->size = (size + 7) & ~(size_t)7;
+        if (pool->size < sizeof(MemLink))
+        {
+            pool->size = sizeof(MemLink);
+        }
+        pool->perslab = MAX((MEMPOOL_SLAB_SIZE - MEMPOOL_SLAB_HEADER) / pool->size, MEMPOOL_SLAB_MINOBJS);
+    }
+    
+    slab = malloc(MEMPOOL_SLAB_HEADER + pool->size * pool->perslab);
+    if (slab == NULL)
+    {
+        return;
+    }
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->nbslabs++;
+    
+    obj = (Uint8*)slab + MEMPOOL_SLAB_HEADER + pool->size * pool->perslab;
+    for (i = 0; i < pool->perslab; i++)
+    {
+        obj -= pool->size;
+        ((MemLink*)obj)->next = pool->shared.free;
+        pool->shared.free = (MemLink*)obj;
+    }
+    pool->shared.nbfree += pool->perslab;
+}
+
+/*----------------------------------------------------------------------------*/
+/*This function checks that objects of the given size fit in a pool, the pool objects
+size being set on first use (pool must be locked)*/
+static Bool
+checkSize(MemPoolData* pool, size_t size)
+{
+    if (pool->size == 0)
+    {
+        newSlab(pool, size);
+    }
+    return (size <= pool->size);
+}
+
+/*----------------------------------------------------------------------------*/
+/*This function moves at most nb free objects from a list to another*/
+static void
+moveFree(MemCache* src, MemCache* dest, Uint32 nb)
+{
+    MemLink* obj;
+    
+    while ((nb > 0) && (src->free != NULL))
+    {
+        obj = src->free;
+        src->free = obj->next;
+        obj->next = dest->free;
+        dest->free = obj;
+        src->nbfree--;
+        dest->nbfree++;
+        nb--;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+static int
+cmpSlabs(const void* s1, const void* s2)
+{
+    const Uint8* p1 = *(const Uint8* const*)s1;
+    const Uint8* p2 = *(const Uint8* const*)s2;
+    
+    return (p1 < p2) ? -1 : ((p1 > p2) ? 1 : 0);
+}
+
+/*----------------------------------------------------------------------------*/
+/*This function gives the position of the slab containing an object, in an array sorted by address*/
+static Uint32
+findSlab(Uint8** slabs, Uint32 nb, MemLink* obj)
+{
+    Uint32 min, max, mid;
+    
+    min = 0;
+    max = nb - 1;
+    while (min < max)
+    {
+        mid = max - (max - min) / 2;
+        if (slabs[mid] <= (Uint8*)obj)
+        {
+            min = mid;
+        }
+        else
+        {
+            max = mid - 1;
+        }
+    }
+    return min;
+}
+
+/*----------------------------------------------------------------------------*/
+/*This function frees the slabs of a pool that only contain free objects of the shared part (pool must be locked)*/
+static void
+trimPool(MemPoolData* pool)
+{
+    Uint8** slabs;
+    Uint32* counts;
+    MemLink* obj;
+    MemLink* next;
+    MemLink* slab;
+    Uint32 i, nb;
+    
+    nb = pool->nbslabs;
+    if (nb == 0)
+    {
+        return;
+    }
+    
+    /*slabs sorted by address*/
+    slabs = malloc(sizeof(Uint8*) * nb);
+    counts = malloc(sizeof(Uint32) * nb);
+    if ((slabs == NULL) || (counts == NULL))
+    {
+        /*nothing is lost, the slabs are just kept*/
+        free(slabs);
+        free(counts);
+        return;
+    }
+    i = 0;
+    for (slab = pool->slabs; slab != NULL; slab = slab->next)
+    {
+        counts[i] = 0;
+        slabs[i++] = (Uint8*)slab;
+    }
+    qsort(slabs, nb, sizeof(Uint8*), cmpSlabs);
+    
+    /*count free objects in each slab*/
+    for (obj = pool->shared.free; obj != NULL; obj = obj->next)
+    {
+        counts[findSlab(slabs, nb, obj)]++;
+    }
+    
+    /*forget free objects of the empty slabs*/
+    obj = pool->shared.free;
+    pool->shared.free = NULL;
+    pool->shared.nbfree = 0;
+    while (obj != NULL)
+    {
+        next = obj->next;
+        if (counts[findSlab(slabs, nb, obj)] != pool->perslab)
+        {
+            obj->next = pool->shared.free;
+            pool->shared.free = obj;
+            pool->shared.nbfree++;
+        }
+        obj = next;
+    }
+    
+    /*free the empty slabs, keep the others*/
+    pool->slabs = NULL;
+    pool->nbslabs = 0;
+    for (i = 0; i < nb; i++)
+    {
+        if (counts[i] == pool->perslab)
+        {
+            free(slabs[i]);
+        }
+        else
+        {
+            slab = (MemLink*)slabs[i];
+            slab->next = pool->slabs;
+            pool->slabs = slab;
+            pool->nbslabs++;
+        }
+    }
+    
+    free(slabs);
+    free(counts);
+}
+
 /******************************************************************************
  *############################################################################*
  *#                              Main functions                              #*
@@ -62,18 +344,34 @@ static SDL_mutex* debug_mutex;
 void
 memInit()
 {
+    int i;
+    
 #ifdef DEBUG_MEM
     debug_mem = malloc(sizeof(MemAllocated) * 50000);
     debug_mem_len = 0;
     debug_mem_alloclen = 50000;
     debug_mutex = SDL_CreateMutex();
 #endif
+
+    memset(_pools, 0, sizeof(_pools));
+    for (i = 0; i < MEMPOOL_NB; i++)
+    {
+        _pools[i].lock = SDL_CreateMutex();
+    }
+    
+    memset(_threadused, 0, sizeof(_threadused));
+    _threads_lock = SDL_CreateMutex();
+    
+    /*the main thread*/
+    memRegisterThread();
 }
 
 /*----------------------------------------------------------------------------*/
 void
 memUninit()
 {
+    MemLink* slab;
+    int p;
 #ifdef DEBUG_MEM
     unsigned int i;
     MemAllocated m;
@@ -89,6 +387,18 @@ memUninit()
     
     SDL_DestroyMutex(debug_mutex);
 #endif
+    
+    for (p = 0; p < MEMPOOL_NB; p++)
+    {
+        while (_pools[p].slabs != NULL)
+        {
+            slab = _pools[p].slabs;
+            _pools[p].slabs = slab->next;
+            free(slab);
+        }
+        SDL_DestroyMutex(_pools[p].lock);
+    }
+    SDL_DestroyMutex(_threads_lock);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -102,6 +412,231 @@ memNbAlloc()
 #endif
 }
 
+/*----------------------------------------------------------------------------*/
+void
+memRegisterThread()
+{
+    Uint32 id;
+    int i;
+    
+    id = SDL_ThreadID();
+    
+    SDL_mutexP(_threads_lock);
+    if (findSlot(id) < 0)
+    {
+        for (i = 0; i < MEM_THREADS_NB; i++)
+        {
+            if (!_threadused[i])
+            {
+                _threadids[i] = id;
+                _threadused[i] = 1;
+#ifdef HAVE_THREAD_LOCAL
+                _threadslot = i;
+#endif
+                break;
+            }
+        }
+    }
+    SDL_mutexV(_threads_lock);
+}
+
+/*----------------------------------------------------------------------------*/
+void
+memUnregisterThread()
+{
+    MemCache* cache;
+    int slot;
+    int p;
+    
+    slot = currentSlot();
+    if (slot < 0)
+    {
+        return;
+    }
+    
+    /*give the cached objects back to the shared parts*/
+    for (p = 0; p < MEMPOOL_NB; p++)
+    {
+        cache = _pools[p].caches + slot;
+        SDL_mutexP(_pools[p].lock);
+        moveFree(cache, &_pools[p].shared, cache->nbfree);
+        _pools[p].shared.nballoc += cache->nballoc;
+        _pools[p].shared.nbfreed += cache->nbfreed;
+        cache->nballoc = 0;
+        cache->nbfreed = 0;
+        SDL_mutexV(_pools[p].lock);
+    }
+    
+    SDL_mutexP(_threads_lock);
+    _threadused[slot] = 0;
+    SDL_mutexV(_threads_lock);
+#ifdef HAVE_THREAD_LOCAL
+    _threadslot = -1;
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+void
+memTrim()
+{
+    int p;
+    
+    for (p = 0; p < MEMPOOL_NB; p++)
+    {
+        SDL_mutexP(_pools[p].lock);
+        trimPool(_pools + p);
+        SDL_mutexV(_pools[p].lock);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void
+memPrintPools()
+{
+    MemPoolData* pool;
+    Uint32 nballoc, nbfreed, nbfree, nbslabs, perslab;
+    size_t size;
+    int p, i;
+    
+    shellPrint(LEVEL_INFO, "Pool           Size     Live   Cached      Allocations  Slabs    KBytes");
+    for (p = 0; p < MEMPOOL_NB; p++)
+    {
+        pool = _pools + p;
+        
+        /*thread caches are read without locking, this is only informative*/
+        SDL_mutexP(pool->lock);
+        nballoc = pool->shared.nballoc;
+        nbfreed = pool->shared.nbfreed;
+        nbfree = pool->shared.nbfree;
+        for (i = 0; i < MEM_THREADS_NB; i++)
+        {
+            nballoc += pool->caches[i].nballoc;
+            nbfreed += pool->caches[i].nbfreed;
+            nbfree += pool->caches[i].nbfree;
+        }
+        nbslabs = pool->nbslabs;
+        size = pool->size;
+        perslab = pool->perslab;
+        SDL_mutexV(pool->lock);
+        
+        shellPrintf(LEVEL_INFO, "%-14s %4u %8u %8u %16u %6u %9u", _poolnames[p], (unsigned int)size,
+                    nballoc - nbfreed, nbfree, nballoc, nbslabs,
+                    (unsigned int)((MEMPOOL_SLAB_HEADER + size * perslab) * nbslabs / 1024));
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+MemPointer
+pv_poolAlloc(MemPool poolid, size_t size)
+{
+    MemPoolData* pool;
+    MemCache* cache;
+    MemLink* obj;
+    Bool sizeok;
+    int slot;
+    
+    pool = _pools + poolid;
+    
+    slot = currentSlot();
+    if (slot >= 0)
+    {
+        /*registered thread, use its cache*/
+        cache = pool->caches + slot;
+        if ((cache->free == NULL) || (size > cache->size))
+        {
+            SDL_mutexP(pool->lock);
+            sizeok = checkSize(pool, size);
+            cache->size = pool->size;
+            if ((sizeok) && (cache->free == NULL))
+            {
+                if (pool->shared.free == NULL)
+                {
+                    newSlab(pool, size);
+                }
+                moveFree(&pool->shared, cache, MEMPOOL_BATCH);
+            }
+            SDL_mutexV(pool->lock);
+            if (!sizeok)
+            {
+                error("mem", "pv_poolAlloc", "Pool used with different object sizes.");
+            }
+            if (cache->free == NULL)
+            {
+                return NULL;
+            }
+        }
+        obj = cache->free;
+        cache->free = obj->next;
+        cache->nbfree--;
+        cache->nballoc++;
+        return (MemPointer)obj;
+    }
+    
+    SDL_mutexP(pool->lock);
+    sizeok = checkSize(pool, size);
+    obj = NULL;
+    if (sizeok)
+    {
+        if (pool->shared.free == NULL)
+        {
+            newSlab(pool, size);
+        }
+        obj = pool->shared.free;
+        if (obj != NULL)
+        {
+            pool->shared.free = obj->next;
+            pool->shared.nbfree--;
+            pool->shared.nballoc++;
+        }
+    }
+    SDL_mutexV(pool->lock);
+    if (!sizeok)
+    {
+        error("mem", "pv_poolAlloc", "Pool used with different object sizes.");
+    }
+    return (MemPointer)obj;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+pv_poolFree(MemPool poolid, MemPointer p)
+{
+    MemPoolData* pool;
+    MemCache* cache;
+    int slot;
+    
+    if (p == NULL)
+    {
+        return;
+    }
+    pool = _pools + poolid;
+    
+    slot = currentSlot();
+    if (slot >= 0)
+    {
+        /*registered thread, use its cache*/
+        cache = pool->caches + slot;
+        ((MemLink*)p)->next = cache->free;
+        cache->free = (MemLink*)p;
+        cache->nbfree++;
+        cache->nbfreed++;
+        if (cache->nbfree > 2 * MEMPOOL_BATCH)
+        {
+            SDL_mutexP(pool->lock);
+            moveFree(cache, &pool->shared, MEMPOOL_BATCH);
+            SDL_mutexV(pool->lock);
+        }
+        return;
+    }
+    
+    SDL_mutexP(pool->lock);
+    ((MemLink*)p)->next = pool->shared.free;
+    pool->shared.free = (MemLink*)p;
+    pool->shared.nbfree++;
+    pool->shared.nbfreed++;
+    SDL_mutexV(pool->lock);
+}
+
 /*----------------------------------------------------------------------------*/
 #ifdef DEBUG_MEM
 MemPointer
@@ -31,6 +31,10 @@
  * It can keep track of not freed allocated stuff and not allocated freeings.
  * If DEBUG_MEMPRINT is defined in a file, all memory management performed in this
  * file will be printed to stdout.
+ *
+ * Small objects allocated and freed at a high rate can be taken from pools instead (POOL_ALLOC and POOL_FREE).
+ * A pool carves objects of a single size from big slabs and keeps the freed ones for later allocations.
+ * Threads registered with memRegisterThread get their own small cache in each pool, that they use without locking.
  */
 
 #ifndef _SW_MEM_H_
@@ -57,9 +61,21 @@
 /*! \brief Common pointer type used for memory allocations and freeings. */
 typedef void* MemPointer;
 
+/*! \brief Object pools, one per type of pooled objects. */
+typedef enum
+{
+    MEMPOOL_STRING,         /*!< String objects. */
+    MEMPOOL_VAR,            /*!< Var objects. */
+    MEMPOOL_GL3DOBJECT,     /*!< Gl3DObject objects. */
+    MEMPOOL_GLMESHCONTROL,  /*!< GlMeshControl objects. */
+    MEMPOOL_NB
+} MemPool;
+
 #undef MALLOC
 #undef FREE
 #undef REALLOC
+#undef POOL_ALLOC
+#undef POOL_FREE
 #undef PV_DEBUG_MEMPRINT
 #undef debugALLOC
 #undef debugFREE
@@ -76,6 +92,8 @@ typedef void* MemPointer;
     #define REALLOC(_p_,_size_) pv_debugAlloc(realloc(pv_debugFree(_p_,__FILE__,__LINE__,PV_DEBUG_MEMPRINT),_size_),__FILE__,__LINE__,_size_,PV_DEBUG_MEMPRINT)
     #define debugALLOC(_p_,_size_) pv_debugAlloc((MemPointer)_p_,__FILE__,__LINE__,_size_,PV_DEBUG_MEMPRINT)
     #define debugFREE(_p_) pv_debugFree((MemPointer)_p_,__FILE__,__LINE__,PV_DEBUG_MEMPRINT)
+    #define POOL_ALLOC(_pool_,_size_) pv_debugAlloc(pv_poolAlloc(_pool_,_size_),__FILE__,__LINE__,_size_,PV_DEBUG_MEMPRINT)
+    #define POOL_FREE(_pool_,_p_) pv_poolFree(_pool_,pv_debugFree(_p_,__FILE__,__LINE__,PV_DEBUG_MEMPRINT))
 #else
     /*! \brief Use this macro instead of the standard malloc function */
     #define MALLOC malloc
@@ -87,6 +105,10 @@ typedef void* MemPointer;
     #define debugALLOC(_p_,_size_) _p_
     /*! \brief Debug function to trace memory deallocation, already called by sw_free */
     #define debugFREE(_p_) _p_
+    /*! \brief Allocate an object of the given size from a pool (a pool must always be used with the same size) */
+    #define POOL_ALLOC pv_poolAlloc
+    /*! \brief Give an object allocated by POOL_ALLOC back to its pool */
+    #define POOL_FREE pv_poolFree
 #endif
 
 #undef memCOPY
@@ -119,6 +141,48 @@ void memUninit(void);
  */
 Uint32 memNbAlloc(void);
 
+/*!
+ * \brief Give a pool cache to the calling thread.
+ *
+ * Allocations from the registered threads are served by their own cache, without locking.
+ * Other threads will use the shared part of the pools.
+ */
+void memRegisterThread(void);
+
+/*!
+ * \brief Give back the pool cache of the calling thread.
+ *
+ * Must be called by a registered thread before it terminates.
+ */
+void memUnregisterThread(void);
+
+/*!
+ * \brief Release the pool slabs that don't contain any allocated object anymore.
+ *
+ * Objects kept in thread caches are considered as allocated.
+ * Meant to be called after big deletions (new game, mod loading).
+ */
+void memTrim(void);
+
+/*!
+ * \brief Print pools statistics in the shell.
+ */
+void memPrintPools(void);
+
+/*!
+ * \brief Support function for POOL_ALLOC macro.
+ *
+ * Don't use this function directly, only use the macro POOL_ALLOC.
+ */
+MemPointer pv_poolAlloc(MemPool pool, size_t size);
+
+/*!
+ * \brief Support function for POOL_FREE macro.
+ *
+ * Don't use this function directly, only use the macro POOL_FREE.
+ */
+void pv_poolFree(MemPool pool, MemPointer p);
+
 
 /*----------------------------------------------------------------------------*/
 #ifdef DEBUG_MEM
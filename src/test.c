@@ -26,6 +26,369 @@
 /******************************************************************************
  *                                 Includes                                   *
  ******************************************************************************/
+#include "main.h"
+#include "test.h"
+
+#include "core/core.h"
+#include "core/string.h"
+#include "core/reader.h"
+#include "core/ptrarray.h"
+#include "tools/fonct.h"
+#include "tools/anim.h"
+#include "graphics/glsurface.h"
+#include "world/internal/flocking.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_SYS_STAT_H
+    #include <sys/types.h>
+    #include <sys/stat.h>
+    #include <dirent.h>
+    #define TEST_READSOURCES 1
+#endif
+
+/******************************************************************************
+ *                                 Constants                                  *
+ ******************************************************************************/
+/*Minimal duration of a benchmark, in milliseconds*/
+#define BENCH_DURATION 1000
+
+/*Number of elements of the PtrArray benchmark*/
+#define BENCH_PTRARRAY_NB 1000000
+
+/*Number of animation controls of the animation benchmark*/
+#define BENCH_ANIM_CONTROLS 10000
+
+/*Time between two keyframes and between two playback updates of the animation benchmark*/
+#define BENCH_ANIM_FRAMESTEP 40
+#define BENCH_ANIM_PLAYSTEP 16
+
+/******************************************************************************
+ *                             Static variables                               *
+ ******************************************************************************/
+static CoreID MOD_ID = CORE_INVALID_ID;
+static CoreID FUNC_BENCHREADER = CORE_INVALID_ID;
+static CoreID FUNC_BENCHPTRARRAY = CORE_INVALID_ID;
+static CoreID FUNC_CHECKSIMD = CORE_INVALID_ID;
+static CoreID FUNC_BENCHANIM = CORE_INVALID_ID;
+
+/******************************************************************************
+ *############################################################################*
+ *#                             Private functions                            #*
+ *############################################################################*
+ ******************************************************************************/
+#ifdef TEST_READSOURCES
+/*Read a file to the end, return the number of tokens*/
+static Uint32
+readTokens(const char* path)
+{
+    Reader reader;
+    Uint32 ret;
+    
+    ret = 0;
+    reader = Reader_newFromFile(path);
+    while (Reader_getCurrent(reader)->type != READER_END)
+    {
+        Reader_forward(reader);
+        ret++;
+    }
+    Reader_del(reader);
+    return ret;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Read all the data sources (files without extension) in a directory and its subdirectories.
+  Add the read files, bytes and tokens to *files, *bytes and *tokens.*/
+static void
+readSources(const char* dir, Uint32* files, double* bytes, Uint32* tokens)
+{
+    DIR* d;
+    struct dirent* entry;
+    struct stat info;
+    String path;
+    
+    d = opendir(dir);
+    if (d == NULL)
+    {
+        return;
+    }
+    path = String_new("");
+    while ((entry = readdir(d)) != NULL)
+    {
+        if ((entry->d_name[0] == '.') || (strchr(entry->d_name, '.') != NULL))
+        {
+            /*hidden files, pictures, sounds*/
+            continue;
+        }
+        String_printf(path, "%s/%s", dir, entry->d_name);
+        if (stat(String_get(path), &info) != 0)
+        {
+            continue;
+        }
+        if (S_ISDIR(info.st_mode))
+        {
+            readSources(String_get(path), files, bytes, tokens);
+        }
+        else
+        {
+            (*files)++;
+            *tokens += readTokens(String_get(path));
+            *bytes += (double)info.st_size;
+        }
+    }
+    String_del(path);
+    closedir(d);
+}
+#endif
+
+/*----------------------------------------------------------------------------*/
+/*Reader throughput on the data sources of the current mod*/
+static void
+benchReader(void)
+{
+#ifdef TEST_READSOURCES
+    String dir;
+    double bytes;
+    Uint32 files, tokens;
+    Uint32 passes;
+    Uint32 start, duration;
+    
+    dir = String_new(".");
+    coreFindData(dir);
+    
+    files = 0;
+    bytes = 0.0;
+    tokens = 0;
+    passes = 0;
+    start = getTicks();
+    do
+    {
+        readSources(String_get(dir), &files, &bytes, &tokens);
+        passes++;
+        duration = getTicks() - start;
+    } while ((duration < BENCH_DURATION) && (files != 0));
+    
+    if (files == 0)
+    {
+        shellPrintf(LEVEL_ERROR, "No data source found in '%s'.", String_get(dir));
+    }
+    else
+    {
+        duration = MAX(duration, 1);
+        shellPrintf(LEVEL_USER, "Reader: %u files, %.2f MB, %u tokens in %u passes over '%s', %.1f MB/s", (unsigned int)(files / passes), bytes / passes / 1e6, (unsigned int)(tokens / passes), (unsigned int)passes, String_get(dir), bytes / 1e3 / duration);
+    }
+    String_del(dir);
+#else
+    shellPrint(LEVEL_ERROR, "Reader benchmark not available, the data directory can't be browsed.");
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+/*Print the rate of a benchmark, in millions of operations per second*/
+static void
+benchPrint(const char* name, double ops, Uint32 duration)
+{
+    shellPrintf(LEVEL_USER, "%s: %.1f Mops/s", name, ops / 1e3 / MAX(duration, 1));
+}
+
+/*----------------------------------------------------------------------------*/
+/*PtrArray appends and removals on arrays of BENCH_PTRARRAY_NB elements*/
+static void
+benchPtrArray(void)
+{
+    PtrArray array;
+    Uint32 i, pos, rounds;
+    Uint32 start, tappend, treserved, tremove, tremovefast;
+    
+    tappend = treserved = tremove = tremovefast = 0;
+    rounds = 0;
+    while (tappend + treserved + tremove + tremovefast < BENCH_DURATION)
+    {
+        /*appends from an empty array, then removals from the end*/
+        array = PtrArray_new();
+        start = getTicks();
+        for (i = 0; i < BENCH_PTRARRAY_NB; i++)
+        {
+            PtrArray_append(array, (Ptr)array);
+        }
+        tappend += getTicks() - start;
+        start = getTicks();
+        for (i = BENCH_PTRARRAY_NB; i > 0; i--)
+        {
+            PtrArray_removePos(array, i - 1);
+        }
+        tremove += getTicks() - start;
+        
+        /*appends in a reserved array, then unordered removals anywhere*/
+        start = getTicks();
+        PtrArray_reserve(array, BENCH_PTRARRAY_NB);
+        for (i = 0; i < BENCH_PTRARRAY_NB; i++)
+        {
+            PtrArray_append(array, (Ptr)array);
+        }
+        treserved += getTicks() - start;
+        start = getTicks();
+        pos = 0;
+        for (i = BENCH_PTRARRAY_NB; i > 0; i--)
+        {
+            pos = (pos + 7919) % i;
+            PtrArray_removePosFast(array, pos);
+        }
+        tremovefast += getTicks() - start;
+        
+        PtrArray_del(array);
+        rounds++;
+    }
+    
+    shellPrintf(LEVEL_USER, "PtrArray, %d elements, %u rounds:", BENCH_PTRARRAY_NB, (unsigned int)rounds);
+    benchPrint(" append", (double)BENCH_PTRARRAY_NB * rounds, tappend);
+    benchPrint(" append after reserve", (double)BENCH_PTRARRAY_NB * rounds, treserved);
+    benchPrint(" remove from the end", (double)BENCH_PTRARRAY_NB * rounds, tremove);
+    benchPrint(" unordered remove anywhere", (double)BENCH_PTRARRAY_NB * rounds, tremovefast);
+}
+
+/*----------------------------------------------------------------------------*/
+/*AnimControl_update on BENCH_ANIM_CONTROLS controls linked to an animation of nbframes
+  frames with one integer and one float track, in looping playback then with random seeks*/
+static void
+benchAnimTracks(Uint16 nbframes)
+{
+    Anim anim;
+    AnimControl* controls;
+    Int* ivalues;
+    Float* fvalues;
+    CoreTime length, time;
+    Uint32 i, seed, updates;
+    Uint32 start, tplay, tseek;
+    double checksum;
+    
+    anim = Anim_new(NULL, 2);
+    for (i = 0; i < nbframes; i++)
+    {
+        Anim_addIntFrame(anim, i * BENCH_ANIM_FRAMESTEP, 0, (Int)((i * 37) % 101));
+        Anim_addFloatFrame(anim, i * BENCH_ANIM_FRAMESTEP, 1, (Float)((i * 53) % 97) * 0.5);
+    }
+    
+    controls = MALLOC(sizeof(AnimControl) * BENCH_ANIM_CONTROLS);
+    ivalues = MALLOC(sizeof(Int) * BENCH_ANIM_CONTROLS);
+    fvalues = MALLOC(sizeof(Float) * BENCH_ANIM_CONTROLS);
+    length = 0;
+    for (i = 0; i < BENCH_ANIM_CONTROLS; i++)
+    {
+        controls[i] = AnimControl_new(2);
+        AnimControl_setIntControl(controls[i], 0, ivalues + i);
+        AnimControl_setFloatControl(controls[i], 1, fvalues + i);
+        length = AnimControl_linkToAnim(controls[i], anim);
+    }
+    
+    /*looping playback, each control being shifted in the animation*/
+    updates = 0;
+    time = 0;
+    start = getTicks();
+    do
+    {
+        for (i = 0; i < BENCH_ANIM_CONTROLS; i++)
+        {
+            AnimControl_update(controls[i], (time + i * BENCH_ANIM_FRAMESTEP) % (length + 1));
+        }
+        updates += BENCH_ANIM_CONTROLS;
+        time += BENCH_ANIM_PLAYSTEP;
+        tplay = getTicks() - start;
+    } while (tplay < BENCH_DURATION);
+    shellPrintf(LEVEL_USER, " %u frames, looping playback: %.1f ns/update", (unsigned int)nbframes, (double)MAX(tplay, 1) * 1e6 / updates);
+    
+    /*random seeks*/
+    updates = 0;
+    seed = 1;
+    start = getTicks();
+    do
+    {
+        for (i = 0; i < BENCH_ANIM_CONTROLS; i++)
+        {
+            seed = seed * 1103515245U + 12345U;
+            AnimControl_update(controls[i], (seed >> 8) % (length + 1));
+        }
+        updates += BENCH_ANIM_CONTROLS;
+        tseek = getTicks() - start;
+    } while (tseek < BENCH_DURATION);
+    shellPrintf(LEVEL_USER, " %u frames, random seeks: %.1f ns/update", (unsigned int)nbframes, (double)MAX(tseek, 1) * 1e6 / updates);
+    
+    /*keep the updates from being optimized out*/
+    checksum = 0.0;
+    for (i = 0; i < BENCH_ANIM_CONTROLS; i++)
+    {
+        checksum += ivalues[i] + fvalues[i];
+        AnimControl_del(controls[i]);
+    }
+    shellPrintf(LEVEL_DEBUG, " checksum: %f", checksum);
+    
+    FREE(controls);
+    FREE(ivalues);
+    FREE(fvalues);
+    Anim_del(anim);
+}
+
+/*----------------------------------------------------------------------------*/
+/*Keyframe lookup on a long and on a short animation*/
+static void
+benchAnim(void)
+{
+    shellPrintf(LEVEL_USER, "AnimControl_update, %d controls:", BENCH_ANIM_CONTROLS);
+    benchAnimTracks(500);
+    benchAnimTracks(20);
+}
+
+/*----------------------------------------------------------------------------*/
+/*Compare the SIMD kernels of the engine with their scalar references, return the number of failed checks*/
+static Int
+checkSimd(void)
+{
+    Uint32 diff;
+    Int failed;
+    
+    failed = 0;
+    
+    diff = glsurfaceCheckKernels();
+    if (diff != 0)
+    {
+        shellPrintf(LEVEL_ERROR, "Surface kernels: %u pixels differ from the scalar ones", (unsigned int)diff);
+        failed++;
+    }
+    
+    if (!flockingCheckKernels())
+    {
+        failed++;
+    }
+    
+    shellPrintf((failed == 0) ? LEVEL_USER : LEVEL_ERROR, "SIMD kernels check: %s", (failed == 0) ? "passed" : "FAILED");
+    return failed;
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+shellCallback(ShellFunction* func)
+{
+    if (func->id == FUNC_BENCHREADER)
+    {
+        benchReader();
+        Var_setVoid(func->ret);
+    }
+    else if (func->id == FUNC_BENCHPTRARRAY)
+    {
+        benchPtrArray();
+        Var_setVoid(func->ret);
+    }
+    else if (func->id == FUNC_CHECKSIMD)
+    {
+        Var_setInt(func->ret, checkSimd());
+    }
+    else if (func->id == FUNC_BENCHANIM)
+    {
+        benchAnim();
+        Var_setVoid(func->ret);
+    }
+}
 
 /******************************************************************************
  *############################################################################*
@@ -33,6 +396,17 @@
  *############################################################################*
  ******************************************************************************/
 void
+testInit()
+{
+    MOD_ID = coreDeclareModule("test", NULL, NULL, shellCallback, NULL, NULL, NULL);
+    FUNC_BENCHREADER = coreDeclareShellFunction(MOD_ID, "benchreader", VAR_VOID, 0);
+    FUNC_BENCHPTRARRAY = coreDeclareShellFunction(MOD_ID, "benchptrarray", VAR_VOID, 0);
+    FUNC_CHECKSIMD = coreDeclareShellFunction(MOD_ID, "checksimd", VAR_INT, 0);
+    FUNC_BENCHANIM = coreDeclareShellFunction(MOD_ID, "benchanim", VAR_VOID, 0);
+}
+
+/*----------------------------------------------------------------------------*/
+void
 testFunction()
 {
     /*THIS FUNCTION SHOULD BE EMPTY ON RELEASES*/
@@ -28,6 +28,13 @@
  *#                             Public functions                             #*
  *############################################################################*
  ******************************************************************************/
+/*!
+ * \brief Declare the 'test' module.
+ *
+ * Its shell functions run the benchmarks and consistency checks of the engine.
+ */
+void testInit(void);
+
 /*!
  * \brief Function that performs some tests.
  *
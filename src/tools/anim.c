@@ -34,6 +34,12 @@
 #include "core/string.h"
 #include "core/var.h"
 
+/******************************************************************************
+ *                                 Constants                                  *
+ ******************************************************************************/
+/*Number of frames a track control may step forward before searching by dichotomy*/
+#define ANIM_CURSOR_STEPS 4
+
 /******************************************************************************
  *                                  Typedefs                                  *
  ******************************************************************************/
@@ -67,6 +73,7 @@ typedef struct
     Bool integer;       /*TRUE: integer track, FALSE: float track*/
     Track* link;        /*link, NULL if linking failed*/
     void* p;            /*value pointer, either (Int*) or (Float*), NULL if not set yet */
+    Uint16 cursor;      /*frame found at the last update*/
 } TrackControl;
 
 struct pv_AnimControl
@@ -120,6 +127,79 @@ AnimControl_debug(AnimControl control)
 }
 #endif
 
+/******************************************************************************
+ *############################################################################*
+ *#                            Private functions                             #*
+ *############################################################################*
+ ******************************************************************************/
+/*This function gives the last frame of a linked track strictly before the given
+time, the first frame being known to be before it.
+As time usually goes forward, it starts from the frame found at the last update,
+except on short tracks which are simply scanned from the start.*/
+static Uint16
+findFrame(TrackControl* tc, CoreTime time)
+{
+    Frame* frames;
+    Uint16 j, last, min, max, mid;
+    unsigned int steps;
+    
+    frames = tc->link->frames;
+    last = tc->link->nbframes - 1;
+    
+    if (tc->link->nbframes <= ANIM_CURSOR_STEPS * 2)
+    {
+        /*short track, a plain scan is cheaper than any bookkeeping*/
+        j = 0;
+        while ((j < last) && (frames[j + 1].time < time))
+        {
+            j++;
+        }
+        return j;
+    }
+    
+    j = tc->cursor;
+    
+    if ((j <= last) && (frames[j].time < time))
+    {
+        /*step forward from the last position*/
+        steps = 0;
+        while ((j < last) && (frames[j + 1].time < time) && (steps < ANIM_CURSOR_STEPS))
+        {
+            j++;
+            steps++;
+        }
+        if ((j == last) || (frames[j + 1].time >= time))
+        {
+            tc->cursor = j;
+            return j;
+        }
+        min = j;
+    }
+    else
+    {
+        /*looped or seeked back*/
+        min = 0;
+    }
+    
+    /*dichotomy*/
+    max = last;
+    while (min < max)
+    {
+        mid = max - (max - min) / 2;
+        if (frames[mid].time < time)
+        {
+            min = mid;
+        }
+        else
+        {
+            max = mid - 1;
+        }
+    }
+    
+    tc->cursor = min;
+    return min;
+}
+
 /******************************************************************************
  *############################################################################*
  *#                             Public functions                             #*
@@ -197,7 +277,7 @@ Anim_setTrackFromVar(Anim anim, AnimTrack track, Var v)
     }
     else
     {
-        for (i = 0; i < Var_getArraySize(v) - 1; i += 2)
+        for (i = 0; i + 1 < Var_getArraySize(v); i += 2)
         {
             ve = Var_getArrayElemByPos(v, i);
             if (Var_getType(ve) != VAR_INT)
@@ -433,6 +513,7 @@ AnimControl_linkToAnim(AnimControl control, Anim anim)
          && (control->tracks[i].p != NULL))
         {
             control->tracks[i].link = anim->tracks + i;
+            control->tracks[i].cursor = 0;
         }
         else
         {
@@ -478,12 +559,8 @@ AnimControl_update(AnimControl control, CoreTime time)
             else
             {
                 /*searching*/
-                j = 0;
-                while ((j < (link->nbframes - 1)) && ((frame + 1)->time < time))
-                {
-                    j++;
-                    frame++;
-                }
+                j = findFrame(control->tracks + i, time);
+                frame += j;
                 
                 if (j == link->nbframes - 1)
                 {
@@ -525,3 +602,102 @@ AnimControl_update(AnimControl control, CoreTime time)
         }
     }
 }
+
+/*----------------------------------------------------------------------------*/
+void
+Tween_init(Tween* tween)
+{
+    tween->running = FALSE;
+    tween->time = 0;
+    tween->duration = 1;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+Tween_setValue(Tween* tween, unsigned int n, Float start, Float end)
+{
+    ASSERT(n < TWEEN_MAXVALUES, return);
+    
+    tween->start[n] = start;
+    tween->end[n] = end;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+Tween_start(Tween* tween, CoreTime duration)
+{
+    ASSERT(duration != 0, duration = 1);
+    
+    tween->running = TRUE;
+    tween->time = 0;
+    tween->duration = duration;
+}
+
+/*----------------------------------------------------------------------------*/
+void
+Tween_stop(Tween* tween)
+{
+    tween->running = FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+Tween_isRunning(Tween* tween)
+{
+    return tween->running;
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+Tween_update(Tween* tween, CoreTime elapsed)
+{
+    if (!tween->running)
+    {
+        return FALSE;
+    }
+    
+    tween->time += elapsed;
+    if (tween->time >= tween->duration)
+    {
+        tween->running = FALSE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+Float
+Tween_getFloat(Tween* tween, unsigned int n)
+{
+    ASSERT(n < TWEEN_MAXVALUES, return 0.0);
+    
+    if (tween->time == 0)
+    {
+        return tween->start[n];
+    }
+    if (tween->time >= tween->duration)
+    {
+        return tween->end[n];
+    }
+    return tween->start[n] + (tween->end[n] - tween->start[n]) * (Float)tween->time / (Float)tween->duration;
+}
+
+/*----------------------------------------------------------------------------*/
+Int
+Tween_getInt(Tween* tween, unsigned int n)
+{
+    Int start;
+    
+    ASSERT(n < TWEEN_MAXVALUES, return 0);
+    
+    start = (Int)tween->start[n];
+    if (tween->time == 0)
+    {
+        return start;
+    }
+    if (tween->time >= tween->duration)
+    {
+        return (Int)tween->end[n];
+    }
+    return start + ((Int)tween->end[n] - start) * (Int)tween->time / (Int)tween->duration;
+}
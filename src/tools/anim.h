@@ -81,6 +81,27 @@ typedef enum
     ANIM_LINEAR         /*!< Linear interpolation. */
 } AnimInterpolation;
 
+/*!
+ * \brief Maximal number of values moved by a Tween.
+ */
+#define TWEEN_MAXVALUES 4
+
+/*!
+ * \brief Linear move of a few values from a start to an end in a given time.
+ *
+ * This is the lightweight equivalent of a two-frames Anim, meant to be stored directly inside the animated object,
+ * so that starting a transition doesn't allocate anything.
+ * Fields shouldn't be accessed directly, use the Tween functions.
+ */
+typedef struct
+{
+    Bool running;                   /*!< The tween is in progress. */
+    CoreTime time;                  /*!< Current time. */
+    CoreTime duration;              /*!< Total duration. */
+    Float start[TWEEN_MAXVALUES];   /*!< Values at the start. */
+    Float end[TWEEN_MAXVALUES];     /*!< Values at the end. */
+} Tween;
+
 /******************************************************************************
  *############################################################################*
  *#                              Anim functions                              #*
@@ -202,10 +223,87 @@ CoreTime AnimControl_linkToAnim(AnimControl control, Anim anim);
  * \brief Update controls with track values.
  *
  * This will fill variables pointed by \ref AnimControl_setIntControl and \ref AnimControl_setFloatControl with
- * track values.
+ * track values.<br>
+ * On long tracks, each track control remembers the frame found at the previous call, so updates with an increasing time
+ * are done in constant time; going back in time costs a dichotomic search.
  * \param control - The animation controller.
  * \param time - Track values will be picked at this time inside the animation.
  */
 void AnimControl_update(AnimControl control, CoreTime time);
 
+/******************************************************************************
+ *############################################################################*
+ *#                              Tween functions                             #*
+ *############################################################################*
+ ******************************************************************************/
+/*!
+ * \brief Initialize a tween, that will not be running.
+ *
+ * \param tween - The tween.
+ */
+void Tween_init(Tween* tween);
+
+/*!
+ * \brief Set the start and end of a value.
+ *
+ * \param tween - The tween.
+ * \param n - Value number, lower than TWEEN_MAXVALUES.
+ * \param start - Value at the start.
+ * \param end - Value at the end.
+ */
+void Tween_setValue(Tween* tween, unsigned int n, Float start, Float end);
+
+/*!
+ * \brief Start a tween.
+ *
+ * \param tween - The tween.
+ * \param duration - Duration of the move, must not be 0.
+ */
+void Tween_start(Tween* tween, CoreTime duration);
+
+/*!
+ * \brief Stop a tween, leaving values where they are.
+ *
+ * \param tween - The tween.
+ */
+void Tween_stop(Tween* tween);
+
+/*!
+ * \brief Check if a tween is in progress.
+ *
+ * \param tween - The tween.
+ * \return TRUE if the tween is running.
+ */
+Bool Tween_isRunning(Tween* tween);
+
+/*!
+ * \brief Make time pass for a running tween.
+ *
+ * The tween stops when its end is reached, values then stay at their end.
+ * \param tween - The tween.
+ * \param elapsed - Time elapsed since the last update.
+ * \return TRUE if the tween just ended.
+ */
+Bool Tween_update(Tween* tween, CoreTime elapsed);
+
+/*!
+ * \brief Get the current value of a float value.
+ *
+ * Values are interpolated exactly like a float Anim track.
+ * \param tween - The tween.
+ * \param n - Value number.
+ * \return Current value.
+ */
+Float Tween_getFloat(Tween* tween, unsigned int n);
+
+/*!
+ * \brief Get the current value of an integer value.
+ *
+ * Values are interpolated exactly like an integer Anim track.
+ * \param tween - The tween.
+ * \param n - Value number.
+ * \return Current value.
+ */
+Int Tween_getInt(Tween* tween, unsigned int n);
+
 #endif
@@ -37,24 +37,40 @@
 
 #include "core/core.h"
 
+/******************************************************************************
+ *                                 Constants                                  *
+ ******************************************************************************/
+/*Width and height of a chunk, in tiles*/
+#define CHUNK_SIZE 16
+
+/*Maximal number of meshes placed on a tile (self or four corners)*/
+#define TILE_MAXINSTANCES 4
+
 /******************************************************************************
  *                                 Typedefs                                   *
  ******************************************************************************/
+/*Group of CHUNK_SIZE*CHUNK_SIZE tiles drawn as a single merged mesh*/
 typedef struct
 {
-    Gl3DObject self;
-    Gl3DObject topleft;
-    Gl3DObject topright;
-    Gl3DObject bottomleft;
-    Gl3DObject bottomright;
-} GroundUnit;
+    Gl3DObject obj;     /*NULL if there is nothing to draw in this chunk*/
+    Bool dirty;         /*geometry needs to be rebuilt*/
+} GroundChunk;
 
 /******************************************************************************
  *                             Static variables                               *
  ******************************************************************************/
-static GroundUnit* _ground;
+static Bool* _ground;
+static Uint32* _sat;                /*summed-area table of the ground, (_sizex + 1) * (_sizey + 1)*/
+static GroundCoord _sat_dirtyrow;   /*first row that changed since the table was computed*/
 static GroundCoord _sizex;
 static GroundCoord _sizey;
+static GroundChunk* _chunks;
+static GroundCoord _chunksx;
+static GroundCoord _chunksy;
+static Bool _dirty;
+static GlMeshInstance* _instances;
+static GlEventCollector _collector;
+static GroundWatcher _watcher = NULL;
 static GlMesh _mesh_self;
 static GlMesh _mesh_side;
 static GlMesh _mesh_cornerint;
@@ -92,6 +108,19 @@ freeMeshes(void)
     }
 }
 
+/*----------------------------------------------------------------------------*/
+static void
+setAllDirty(void)
+{
+    long i;
+
+    for (i = 0; i < _chunksx * _chunksy; i++)
+    {
+        _chunks[i].dirty = TRUE;
+    }
+    _dirty = TRUE;
+}
+
 /*----------------------------------------------------------------------------*/
 static void
 datasCallback(Var datas)
@@ -113,233 +142,282 @@ datasCallback(Var datas)
     _mesh_side = GlMesh_new(Var_getArrayElemByCName(datas, "mesh_side"));
     _mesh_cornerint = GlMesh_new(Var_getArrayElemByCName(datas, "mesh_cornerint"));
     _mesh_cornerext = GlMesh_new(Var_getArrayElemByCName(datas, "mesh_cornerext"));
+
+    /*merged geometry must be built again with the new meshes*/
+    setAllDirty();
 }
 
 /*----------------------------------------------------------------------------*/
 static void
-adjustTile(GroundCoord x, GroundCoord y)
+placeMesh(GlMeshInstance* inst, GlMesh mesh, Gl3DCoord x, Gl3DCoord z, Gl3DCoord angh)
 {
-    unsigned int i;
+    inst->mesh = mesh;
+    inst->x = x;
+    inst->y = 0.0;
+    inst->z = z;
+    inst->angh = angh;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Fill the meshes needed by a tile (self or borders), return their number*/
+static unsigned int
+tileInstances(GroundCoord x, GroundCoord y, GlMeshInstance* inst)
+{
+    unsigned int i, n;
     Bool pleft, pright, ptop, pbottom, ptopleft, ptopright, pbottomleft, pbottomright;
     
-    ASSERT(x < _sizex, return);
-    ASSERT(y < _sizey, return);
+    ASSERT(x < _sizex, return 0);
+    ASSERT(y < _sizey, return 0);
     
     i = y * _sizex + x;
     
-    /*clear all corners*/
-    if (_ground[i].topleft != NULL)
-    {
-        Gl3DObject_del(_ground[i].topleft);
-        _ground[i].topleft = NULL;
-    }
-    if (_ground[i].topright != NULL)
-    {
-        Gl3DObject_del(_ground[i].topright);
-        _ground[i].topright = NULL;
-    }
-    if (_ground[i].bottomleft != NULL)
-    {
-        Gl3DObject_del(_ground[i].bottomleft);
-        _ground[i].bottomleft = NULL;
-    }
-    if (_ground[i].bottomright != NULL)
-    {
-        Gl3DObject_del(_ground[i].bottomright);
-        _ground[i].bottomright = NULL;
-    }
-    
-    if (_ground[i].self != NULL)
+    if (_ground[i])
     {
         /*this ground unit is full, no room for borders*/
-        return;
+        placeMesh(inst, _mesh_self, (Gl3DCoord)x, (Gl3DCoord)y, 0.0);
+        return 1;
     }
     
     /*check neighbours*/
-    if (x == 0)
-    {
-        pleft = FALSE;
-    }
-    else
-    {
-        pleft = (_ground[i - 1].self != NULL);
-    }
-    if (x == _sizex - 1)
-    {
-        pright = FALSE;
-    }
-    else
-    {
-        pright = (_ground[i + 1].self != NULL);
-    }
-    if (y == 0)
-    {
-        ptop = FALSE;
-    }
-    else
-    {
-        ptop = (_ground[i - _sizex].self != NULL);
-    }
-    if (y == _sizey - 1)
-    {
-        pbottom = FALSE;
-    }
-    else
-    {
-        pbottom = (_ground[i + _sizex].self != NULL);
-    }
-    if ((x == 0) || (y == 0))
-    {
-        ptopleft = FALSE;
-    }
-    else
-    {
-        ptopleft = (_ground[i - 1 - _sizex].self != NULL);
-    }
-    if ((x == _sizex - 1) || (y == 0))
-    {
-        ptopright = FALSE;
-    }
-    else
-    {
-        ptopright = (_ground[i + 1 - _sizex].self != NULL);
-    }
-    if ((x == 0) || (y == _sizey - 1))
-    {
-        pbottomleft = FALSE;
-    }
-    else
-    {
-        pbottomleft = (_ground[i - 1 + _sizex].self != NULL);
-    }
-    if ((x == _sizex - 1) || (y == _sizey - 1))
-    {
-        pbottomright = FALSE;
-    }
-    else
-    {
-        pbottomright = (_ground[i + 1 + _sizex].self != NULL);
-    }
+    pleft = (x != 0) && _ground[i - 1];
+    pright = (x != _sizex - 1) && _ground[i + 1];
+    ptop = (y != 0) && _ground[i - _sizex];
+    pbottom = (y != _sizey - 1) && _ground[i + _sizex];
+    ptopleft = (x != 0) && (y != 0) && _ground[i - 1 - _sizex];
+    ptopright = (x != _sizex - 1) && (y != 0) && _ground[i + 1 - _sizex];
+    pbottomleft = (x != 0) && (y != _sizey - 1) && _ground[i - 1 + _sizex];
+    pbottomright = (x != _sizex - 1) && (y != _sizey - 1) && _ground[i + 1 + _sizex];
     
+    n = 0;
+
     /*topleft quarter*/
     if (ptop && pleft)
     {
-        _ground[i].topleft = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].topleft, _mesh_cornerint);
-        Gl3DObject_setPos(_ground[i].topleft, (Gl3DCoord)x, 0.0, (Gl3DCoord)y, 0);
-        Gl3DObject_setAngle(_ground[i].topleft, 0.0, 0.0, 0);
+        placeMesh(inst + n++, _mesh_cornerint, (Gl3DCoord)x, (Gl3DCoord)y, 0.0);
     }
     else if (ptop)
     {
-        _ground[i].topleft = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].topleft, _mesh_side);
-        Gl3DObject_setPos(_ground[i].topleft, (Gl3DCoord)x, 0.0, (Gl3DCoord)y, 0);
-        Gl3DObject_setAngle(_ground[i].topleft, 0.0, 0.0, 0);
+        placeMesh(inst + n++, _mesh_side, (Gl3DCoord)x, (Gl3DCoord)y, 0.0);
     }
     else if (pleft)
     {
-        _ground[i].topleft = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].topleft, _mesh_side);
-        Gl3DObject_setPos(_ground[i].topleft, (Gl3DCoord)x, 0.0, (Gl3DCoord)y + 0.5, 0);
-        Gl3DObject_setAngle(_ground[i].topleft, -M_PI_2, 0.0, 0);
+        placeMesh(inst + n++, _mesh_side, (Gl3DCoord)x, (Gl3DCoord)y + 0.5, -M_PI_2);
     }
     else if (ptopleft)
     {
-        _ground[i].topleft = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].topleft, _mesh_cornerext);
-        Gl3DObject_setPos(_ground[i].topleft, (Gl3DCoord)x, 0.0, (Gl3DCoord)y, 0);
-        Gl3DObject_setAngle(_ground[i].topleft, 0.0, 0.0, 0);
+        placeMesh(inst + n++, _mesh_cornerext, (Gl3DCoord)x, (Gl3DCoord)y, 0.0);
     }
     
     /*topright quarter*/
     if (ptop && pright)
     {
-        _ground[i].topright = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].topright, _mesh_cornerint);
-        Gl3DObject_setPos(_ground[i].topright, (Gl3DCoord)x + 1.0, 0.0, (Gl3DCoord)y, 0);
-        Gl3DObject_setAngle(_ground[i].topright, M_PI_2, 0.0, 0);
+        placeMesh(inst + n++, _mesh_cornerint, (Gl3DCoord)x + 1.0, (Gl3DCoord)y, M_PI_2);
     }
     else if (ptop)
     {
-        _ground[i].topright = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].topright, _mesh_side);
-        Gl3DObject_setPos(_ground[i].topright, (Gl3DCoord)x + 0.5, 0.0, (Gl3DCoord)y, 0);
-        Gl3DObject_setAngle(_ground[i].topright, 0.0, 0.0, 0);
+        placeMesh(inst + n++, _mesh_side, (Gl3DCoord)x + 0.5, (Gl3DCoord)y, 0.0);
     }
     else if (pright)
     {
-        _ground[i].topright = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].topright, _mesh_side);
-        Gl3DObject_setPos(_ground[i].topright, (Gl3DCoord)x + 1.0, 0.0, (Gl3DCoord)y, 0);
-        Gl3DObject_setAngle(_ground[i].topright, M_PI_2, 0.0, 0);
+        placeMesh(inst + n++, _mesh_side, (Gl3DCoord)x + 1.0, (Gl3DCoord)y, M_PI_2);
     }
     else if (ptopright)
     {
-        _ground[i].topright = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].topright, _mesh_cornerext);
-        Gl3DObject_setPos(_ground[i].topright, (Gl3DCoord)x + 1.0, 0.0, (Gl3DCoord)y, 0);
-        Gl3DObject_setAngle(_ground[i].topright, M_PI_2, 0.0, 0);
+        placeMesh(inst + n++, _mesh_cornerext, (Gl3DCoord)x + 1.0, (Gl3DCoord)y, M_PI_2);
     }
     
     /*bottomleft quarter*/
     if (pbottom && pleft)
     {
-        _ground[i].bottomleft = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].bottomleft, _mesh_cornerint);
-        Gl3DObject_setPos(_ground[i].bottomleft, (Gl3DCoord)x, 0.0, (Gl3DCoord)y + 1.0, 0);
-        Gl3DObject_setAngle(_ground[i].bottomleft, -M_PI_2, 0.0, 0);
+        placeMesh(inst + n++, _mesh_cornerint, (Gl3DCoord)x, (Gl3DCoord)y + 1.0, -M_PI_2);
     }
     else if (pbottom)
     {
-        _ground[i].bottomleft = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].bottomleft, _mesh_side);
-        Gl3DObject_setPos(_ground[i].bottomleft, (Gl3DCoord)x + 0.5, 0.0, (Gl3DCoord)y + 1.0, 0);
-        Gl3DObject_setAngle(_ground[i].bottomleft, M_PI, 0.0, 0);
+        placeMesh(inst + n++, _mesh_side, (Gl3DCoord)x + 0.5, (Gl3DCoord)y + 1.0, M_PI);
     }
     else if (pleft)
     {
-        _ground[i].bottomleft = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].bottomleft, _mesh_side);
-        Gl3DObject_setPos(_ground[i].bottomleft, (Gl3DCoord)x, 0.0, (Gl3DCoord)y + 1.0, 0);
-        Gl3DObject_setAngle(_ground[i].bottomleft, -M_PI_2, 0.0, 0);
+        placeMesh(inst + n++, _mesh_side, (Gl3DCoord)x, (Gl3DCoord)y + 1.0, -M_PI_2);
     }
     else if (pbottomleft)
     {
-        _ground[i].bottomleft = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].bottomleft, _mesh_cornerext);
-        Gl3DObject_setPos(_ground[i].bottomleft, (Gl3DCoord)x, 0.0, (Gl3DCoord)y + 1.0, 0);
-        Gl3DObject_setAngle(_ground[i].bottomleft, -M_PI_2, 0.0, 0);
+        placeMesh(inst + n++, _mesh_cornerext, (Gl3DCoord)x, (Gl3DCoord)y + 1.0, -M_PI_2);
     }
     
     /*bottomright quarter*/
     if (pbottom && pright)
     {
-        _ground[i].bottomright = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].bottomright, _mesh_cornerint);
-        Gl3DObject_setPos(_ground[i].bottomright, (Gl3DCoord)x + 1.0, 0.0, (Gl3DCoord)y + 1.0, 0);
-        Gl3DObject_setAngle(_ground[i].bottomright, -M_PI, 0.0, 0);
+        placeMesh(inst + n++, _mesh_cornerint, (Gl3DCoord)x + 1.0, (Gl3DCoord)y + 1.0, -M_PI);
     }
     else if (pbottom)
     {
-        _ground[i].bottomright = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].bottomright, _mesh_side);
-        Gl3DObject_setPos(_ground[i].bottomright, (Gl3DCoord)x + 1.0, 0.0, (Gl3DCoord)y + 1.0, 0);
-        Gl3DObject_setAngle(_ground[i].bottomright, M_PI, 0.0, 0);
+        placeMesh(inst + n++, _mesh_side, (Gl3DCoord)x + 1.0, (Gl3DCoord)y + 1.0, M_PI);
     }
     else if (pright)
     {
-        _ground[i].bottomright = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].bottomright, _mesh_side);
-        Gl3DObject_setPos(_ground[i].bottomright, (Gl3DCoord)x + 1.0, 0.0, (Gl3DCoord)y + 0.5, 0);
-        Gl3DObject_setAngle(_ground[i].bottomright, M_PI_2, 0.0, 0);
+        placeMesh(inst + n++, _mesh_side, (Gl3DCoord)x + 1.0, (Gl3DCoord)y + 0.5, M_PI_2);
     }
     else if (pbottomright)
     {
-        _ground[i].bottomright = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].bottomright, _mesh_cornerext);
-        Gl3DObject_setPos(_ground[i].bottomright, (Gl3DCoord)x + 1.0, 0.0, (Gl3DCoord)y + 1.0, 0);
-        Gl3DObject_setAngle(_ground[i].bottomright, -M_PI, 0.0, 0);
+        placeMesh(inst + n++, _mesh_cornerext, (Gl3DCoord)x + 1.0, (Gl3DCoord)y + 1.0, -M_PI);
+    }
+
+    return n;
+}
+
+/*----------------------------------------------------------------------------*/
+static Bool
+chunkCallback(GlExtID extid, GlEvent* event)
+{
+    if (event->type == GLEVENT_DELETE)
+    {
+        /*the merged mesh belongs to the chunk object*/
+        GlMesh_del((GlMesh)extid);
+    }
+    return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+rebuildChunk(GroundChunk* chunk, GroundCoord cx, GroundCoord cy)
+{
+    GroundCoord x, y, xmax, ymax;
+    Uint32 n;
+    GlMesh mesh;
+
+    if (chunk->obj != NULL)
+    {
+        Gl3DObject_del(chunk->obj);
+        chunk->obj = NULL;
+    }
+
+    n = 0;
+    xmax = MIN((cx + 1) * CHUNK_SIZE, _sizex);
+    ymax = MIN((cy + 1) * CHUNK_SIZE, _sizey);
+    for (y = cy * CHUNK_SIZE; y < ymax; y++)
+    {
+        for (x = cx * CHUNK_SIZE; x < xmax; x++)
+        {
+            n += tileInstances(x, y, _instances + n);
+        }
+    }
+
+    if (n != 0)
+    {
+        mesh = GlMesh_newMerged(_instances, n);
+        chunk->obj = Gl3DObject_new((GlExtID)mesh, global_groupnormal, chunkCallback);
+        Gl3DObject_setMesh(chunk->obj, mesh);
+    }
+    chunk->dirty = FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+static Bool
+drawCallback(GlExtID extid, GlEvent* event)
+{
+    GroundCoord cx, cy;
+
+    (void)extid;
+    (void)event;
+
+    /*rebuild modified chunks once per frame*/
+    if (_dirty && (_mesh_self != NULL))
+    {
+        for (cy = 0; cy < _chunksy; cy++)
+        {
+            for (cx = 0; cx < _chunksx; cx++)
+            {
+                if (_chunks[cy * _chunksx + cx].dirty)
+                {
+                    rebuildChunk(_chunks + cy * _chunksx + cx, cx, cy);
+                }
+            }
+        }
+        _dirty = FALSE;
+    }
+    return FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Mark the chunk containing a tile as dirty, the tile can be out of the map*/
+static void
+setTileDirty(int x, int y)
+{
+    if ((x < 0) || (y < 0) || (x >= _sizex) || (y >= _sizey))
+    {
+        return;
+    }
+    _chunks[(y / CHUNK_SIZE) * _chunksx + x / CHUNK_SIZE].dirty = TRUE;
+    _dirty = TRUE;
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+allocGround(void)
+{
+    long i;
+
+    _chunksx = (_sizex + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    _chunksy = (_sizey + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    _ground = MALLOC(sizeof(Bool) * _sizex * _sizey);
+    _sat = MALLOC(sizeof(Uint32) * (_sizex + 1) * (_sizey + 1));
+    for (i = 0; i < (_sizex + 1) * (_sizey + 1); i++)
+    {
+        _sat[i] = 0;
+    }
+    _sat_dirtyrow = _sizey;
+    _chunks = MALLOC(sizeof(GroundChunk) * _chunksx * _chunksy);
+    for (i = 0; i < _sizex * _sizey; i++)
+    {
+        _ground[i] = FALSE;
+    }
+    for (i = 0; i < _chunksx * _chunksy; i++)
+    {
+        _chunks[i].obj = NULL;
+        _chunks[i].dirty = FALSE;
+    }
+    _dirty = FALSE;
+}
+
+/*----------------------------------------------------------------------------*/
+/*bring the summed-area table up to date, from the first changed row*/
+static void
+updateSat(void)
+{
+    Uint32* row;
+    Uint32 run;
+    GroundCoord x, y;
+    
+    for (y = _sat_dirtyrow; y < _sizey; y++)
+    {
+        row = _sat + (y + 1) * (_sizex + 1);
+        run = 0;
+        for (x = 0; x < _sizex; x++)
+        {
+            run += (_ground[y * _sizex + x] ? 1 : 0);
+            row[x + 1] = row[x + 1 - (_sizex + 1)] + run;
+        }
     }
+    _sat_dirtyrow = _sizey;
+}
+
+/*----------------------------------------------------------------------------*/
+/*count the ground tiles in a rectangle, the table must be up to date*/
+static Uint32
+countSat(int x, int y, int w, int h)
+{
+    int x2, y2;
+    
+    x2 = MIN(x + w, (int)_sizex);
+    y2 = MIN(y + h, (int)_sizey);
+    x = MAX(x, 0);
+    y = MAX(y, 0);
+    if ((x >= x2) || (y >= y2))
+    {
+        return 0;
+    }
+    return _sat[y2 * (_sizex + 1) + x2] - _sat[y * (_sizex + 1) + x2]
+         - _sat[y2 * (_sizex + 1) + x] + _sat[y * (_sizex + 1) + x];
 }
 
 /******************************************************************************
@@ -350,34 +428,30 @@ adjustTile(GroundCoord x, GroundCoord y)
 void
 groundInit()
 {
-    long i;
-    
     _sizex = 10;
     _sizey = 10;
-    _ground = MALLOC(sizeof(GroundUnit) * _sizex * _sizey);
+    allocGround();
+    _instances = MALLOC(sizeof(GlMeshInstance) * CHUNK_SIZE * CHUNK_SIZE * TILE_MAXINSTANCES);
     _mesh_self = NULL;
     _mesh_side = NULL;
     _mesh_cornerint = NULL;
     _mesh_cornerext = NULL;
-    for (i = 0; i < _sizex * _sizey; i++)
-    {
-        _ground[i].self = NULL;
-        _ground[i].topleft = NULL;
-        _ground[i].topright = NULL;
-        _ground[i].bottomleft = NULL;
-        _ground[i].bottomright = NULL;
-    }
     
     MOD_ID = coreDeclareModule("ground", NULL, datasCallback, NULL, NULL, NULL, NULL);
+    _collector = graphicsAddEventCollector(GLEVENT_DRAW, drawCallback);
 }
 
 /*----------------------------------------------------------------------------*/
 void
 groundUninit()
 {
+    graphicsDelEventCollector(_collector);
     groundClear();
     freeMeshes();
     FREE(_ground);
+    FREE(_sat);
+    FREE(_chunks);
+    FREE(_instances);
     shellPrint(LEVEL_INFO, "Ground module unloaded.");
 }
 
@@ -385,20 +459,13 @@ groundUninit()
 void
 groundWorldSizeChanged(GroundCoord nbx, GroundCoord nby)
 {
-    long i;
-    
     groundClear();
+    FREE(_ground);
+    FREE(_sat);
+    FREE(_chunks);
     _sizex = nbx;
     _sizey = nby;
-    _ground = REALLOC(_ground, sizeof(GroundUnit) * _sizex * _sizey);
-    for (i = 0; i < _sizex * _sizey; i++)
-    {
-        _ground[i].self = NULL;
-        _ground[i].topleft = NULL;
-        _ground[i].topright = NULL;
-        _ground[i].bottomleft = NULL;
-        _ground[i].bottomright = NULL;
-    }
+    allocGround();
 }
 
 /*----------------------------------------------------------------------------*/
@@ -410,31 +477,22 @@ groundClear()
     /*TODO: unset map plots*/
     for (i = 0; i < _sizex * _sizey; i++)
     {
-        if (_ground[i].self != NULL)
-        {
-            Gl3DObject_del(_ground[i].self);
-            _ground[i].self = NULL;
-        }
-        if (_ground[i].topleft != NULL)
-        {
-            Gl3DObject_del(_ground[i].topleft);
-            _ground[i].topleft = NULL;
-        }
-        if (_ground[i].topright != NULL)
-        {
-            Gl3DObject_del(_ground[i].topright);
-            _ground[i].topright = NULL;
-        }
-        if (_ground[i].bottomleft != NULL)
-        {
-            Gl3DObject_del(_ground[i].bottomleft);
-            _ground[i].bottomleft = NULL;
-        }
-        if (_ground[i].bottomright != NULL)
+        _ground[i] = FALSE;
+    }
+    _sat_dirtyrow = 0;
+    for (i = 0; i < _chunksx * _chunksy; i++)
+    {
+        if (_chunks[i].obj != NULL)
         {
-            Gl3DObject_del(_ground[i].bottomright);
-            _ground[i].bottomright = NULL;
+            Gl3DObject_del(_chunks[i].obj);
+            _chunks[i].obj = NULL;
         }
+        _chunks[i].dirty = FALSE;
+    }
+    
+    if (_watcher != NULL)
+    {
+        _watcher(0, 0, _sizex, _sizey);
     }
 }
 
@@ -442,8 +500,7 @@ groundClear()
 Bool
 groundAddPlayerArea(Uint16 minw, Uint16 minh, GroundCoord* rx, GroundCoord* ry)
 {
-    Uint8 areatested = 0x00;
-    Uint8 areachosen = 0;
+    int areachosen, first, i;
     GlRect rct;
     int x, y;
     int added, total, loop;
@@ -461,48 +518,37 @@ groundAddPlayerArea(Uint16 minw, Uint16 minh, GroundCoord* rx, GroundCoord* ry)
         return TRUE;
     }
     
-    /*choose an area*/
-    rct.x = 0;
-    rct.y = 0;
-    do
+    /*choose a free area, with a margin around the minimal area, in a random quarter*/
+    updateSat();
+    first = rnd(0, 4);
+    for (i = 0; i < 4; i++)
+    {
+        areachosen = (first + i) % 4;
+        rct.x = ((areachosen & 1) == 0) ? 0 : _sizex - rct.w;
+        rct.y = ((areachosen & 2) == 0) ? 0 : _sizey - rct.h;
+        if (countSat(rct.x + (rct.w - minw) / 2 - 1, rct.y + (rct.h - minh) / 2 - 1, minw + 2, minh + 2) == 0)
+        {
+            break;
+        }
+    }
+    if (i == 4)
     {
-        areachosen = rnd(1, 4);
-        if (((0x01 << (areachosen - 1)) & areatested) == 0x00)
+        /*all quarters are taken, look for room anywhere*/
+        if (groundFindFreeArea(minw + 2, minh + 2, TRUE, rx, ry))
         {
-            switch (areachosen)
-            {
-                case 1:
-                    rct.x = 0;
-                    rct.y = 0;
-                    break;
-                case 2:
-                    rct.x = _sizex - rct.w;
-                    rct.y = 0;
-                    break;
-                case 3:
-                    rct.x = 0;
-                    rct.y = _sizey - rct.h;
-                    break;
-                case 4:
-                    rct.x = _sizex - rct.w;
-                    rct.y = _sizey - rct.h;
-                    break;
-                default:
-                    /*should not happen*/
-                    ;
-            }
-            if (groundGetState(rct.x + rct.w / 2, rct.y + rct.h / 2))
-            {
-                /*this area is already taken*/
-                areachosen = 0;
-                areatested &= (0x01 << (areachosen - 1));
-                if (areatested == 0xFF)
-                {
-                    return TRUE;
-                }
-            }
+            shellPrint(LEVEL_ERROR, "Unable to create player area; no room left.");
+            return TRUE;
         }
-    } while (areachosen == 0);
+        rct.x = MAX(0, MIN((int)*rx + 1 + minw / 2 - rct.w / 2, (int)(_sizex - rct.w)));
+        rct.y = MAX(0, MIN((int)*ry + 1 + minh / 2 - rct.h / 2, (int)(_sizey - rct.h)));
+        *rx = *rx + 1;
+        *ry = *ry + 1;
+    }
+    else
+    {
+        *rx = rct.x + (rct.w - minw) / 2;
+        *ry = rct.y + (rct.h - minh) / 2;
+    }
    
     /*create a virtual growing area*/
     buf = MALLOC(sizeof(Bool) * rct.w * rct.h);
@@ -516,8 +562,6 @@ groundAddPlayerArea(Uint16 minw, Uint16 minh, GroundCoord* rx, GroundCoord* ry)
     
     /*place the minimal area*/
     total = 0;
-    *rx = rct.x + (rct.w - minw) / 2;
-    *ry = rct.y + (rct.h - minh) / 2;
     for (x = *rx; x < *rx + minw; x++)
     {
         for (y = *ry; y < *ry + minh; y++)
@@ -534,6 +578,7 @@ groundAddPlayerArea(Uint16 minw, Uint16 minh, GroundCoord* rx, GroundCoord* ry)
     {
         loop++;
         added = 0;
+        updateSat();
         /*seed propagation*/
         for (x = rct.x; x < rct.x + rct.w; x++)
         {
@@ -542,20 +587,11 @@ groundAddPlayerArea(Uint16 minw, Uint16 minh, GroundCoord* rx, GroundCoord* ry)
                 if (! buf[(y - rct.y) * rct.w + (x - rct.x)])
                 {
                     int f;
-                    int dx, dy;
                     
-                    f = 0;
-                    
-                    for (dx = -1; dx <= 1; dx++)
-                    {
-                        for (dy = -1; dy <= 1; dy++)
-                        {
-                            if (((dx != 0) | (dy != 0)) && groundGetState(x + dx, y + dy))
-                            {
-                                f += (((dx == 0) | (dy == 0)) ? 2 : 1);    /*diagonal or not*/
-                            }
-                        }
-                    }
+                    /*neighbours weigh 2, or 1 if diagonal: the 3x3 square plus the
+                      3x1 and 1x3 lines around the tile, without it*/
+                    f = countSat(x - 1, y - 1, 3, 3) + countSat(x - 1, y, 3, 1) + countSat(x, y - 1, 1, 3)
+                      - 3 * countSat(x, y, 1, 1);
                     
                     /*maximal f is 12*/
                     if (rnd(0, total) < f)
@@ -590,6 +626,7 @@ void
 groundSetState(GroundCoord x, GroundCoord y, Bool ground)
 {
     unsigned int i;
+    int dx, dy;
     
     if ((x >= _sizex) || (y >= _sizey))
     {
@@ -597,71 +634,38 @@ groundSetState(GroundCoord x, GroundCoord y, Bool ground)
     }
     i = y * _sizex + x;
     
-    if (ground)
-    {
-        if (_ground[i].self != NULL)
-        {
-            return;
-        }
-        
-        /*set the tile itself*/
-        _ground[i].self = Gl3DObject_new(NULL, global_groupnormal, NULL);
-        Gl3DObject_setMesh(_ground[i].self, _mesh_self);
-        Gl3DObject_setPos(_ground[i].self, (Gl3DCoord)x, 0.0, (Gl3DCoord)y, 0);
-        
-        /*change map plot*/
-        worldmapSetPlot(x, y, MapPlot_GROUND);
-    }
-    else
-    {
-        /*delete the tile*/
-        if (_ground[i].self != NULL)
-        {
-            Gl3DObject_del(_ground[i].self);
-            _ground[i].self = NULL;
-        
-            /*change map plot*/
-            worldmapUnsetPlot(x, y, MapPlot_GROUND);
-        }
-        else
-        {
-            return;
-        }
-    }
-    
-    /*correct the tile and its neighbours*/
-    adjustTile(x, y);
-    if (x > 0)
-    {
-        adjustTile(x - 1, y);
-    }
-    if (x < _sizex - 1)
+    if (_ground[i] == ground)
     {
-        adjustTile(x + 1, y);
-    }
-    if (y > 0)
-    {
-        adjustTile(x, y - 1);
+        return;
     }
-    if (y < _sizey - 1)
+    _ground[i] = ground;
+    if (y < _sat_dirtyrow)
     {
-        adjustTile(x, y + 1);
+        _sat_dirtyrow = y;
     }
-    if ((x > 0) && (y > 0))
+
+    /*change map plot*/
+    if (ground)
     {
-        adjustTile(x - 1, y - 1);
+        worldmapSetPlot(x, y, MapPlot_GROUND);
     }
-    if ((x < _sizex - 1) && (y > 0))
+    else
     {
-        adjustTile(x + 1, y - 1);
+        worldmapUnsetPlot(x, y, MapPlot_GROUND);
     }
-    if ((x > 0) && (y < _sizey - 1))
+    
+    /*the tile and its neighbours' borders need to be rebuilt*/
+    for (dx = -1; dx <= 1; dx++)
     {
-        adjustTile(x - 1, y + 1);
+        for (dy = -1; dy <= 1; dy++)
+        {
+            setTileDirty((int)x + dx, (int)y + dy);
+        }
     }
-    if ((x < _sizex - 1) && (y < _sizey - 1))
+    
+    if (_watcher != NULL)
     {
-        adjustTile(x + 1, y + 1);
+        _watcher(x, y, 1, 1);
     }
 }
 
@@ -677,5 +681,50 @@ groundGetState(GroundCoord x, GroundCoord y)
     }
     i = y * _sizex + x;
     
-    return (_ground[i].self != NULL);
+    return _ground[i];
+}
+
+/*----------------------------------------------------------------------------*/
+void
+groundSetWatcher(GroundWatcher watcher)
+{
+    _watcher = watcher;
+}
+
+/*----------------------------------------------------------------------------*/
+Uint32
+groundCountArea(GroundCoord x, GroundCoord y, GroundCoord w, GroundCoord h)
+{
+    updateSat();
+    return countSat(x, y, w, h);
+}
+
+/*----------------------------------------------------------------------------*/
+Bool
+groundFindFreeArea(GroundCoord w, GroundCoord h, Bool randomized, GroundCoord* rx, GroundCoord* ry)
+{
+    Uint32 nbx, nby, nb, start, i, pos;
+    
+    if ((w > _sizex) || (h > _sizey))
+    {
+        return TRUE;
+    }
+    
+    /*every candidate position is checked in constant time*/
+    updateSat();
+    nbx = _sizex - w + 1;
+    nby = _sizey - h + 1;
+    nb = nbx * nby;
+    start = randomized ? (Uint32)rnd(0, nb) : 0;
+    for (i = 0; i < nb; i++)
+    {
+        pos = (start + i) % nb;
+        if (countSat(pos % nbx, pos / nbx, w, h) == 0)
+        {
+            *rx = pos % nbx;
+            *ry = pos / nbx;
+            return FALSE;
+        }
+    }
+    return TRUE;
 }
@@ -37,6 +37,16 @@
  ******************************************************************************/
 typedef WorldCoord GroundCoord;
 
+/*!
+ * \brief Function called when the ground state changes in an area.
+ *
+ * \param x - X position of the area.
+ * \param y - Y position of the area.
+ * \param w - Width of the area.
+ * \param h - Height of the area.
+ */
+typedef void (*GroundWatcher)(GroundCoord x, GroundCoord y, GroundCoord w, GroundCoord h);
+
 /******************************************************************************
  *############################################################################*
  *#                              World functions                             #*
@@ -98,4 +108,35 @@ void groundSetState(GroundCoord x, GroundCoord y, Bool state);
  */
 Bool groundGetState(GroundCoord x, GroundCoord y);
 
+/*!
+ * \brief Count the ground tiles in a rectangle.
+ *
+ * The parts of the rectangle outside the limits are ignored.
+ * \param x - X position of the rectangle.
+ * \param y - Y position of the rectangle.
+ * \param w - Width of the rectangle.
+ * \param h - Height of the rectangle.
+ * \return Number of tiles with ground.
+ */
+Uint32 groundCountArea(GroundCoord x, GroundCoord y, GroundCoord w, GroundCoord h);
+
+/*!
+ * \brief Find a rectangle without ground.
+ *
+ * \param w - Width of the rectangle.
+ * \param h - Height of the rectangle.
+ * \param randomized - TRUE to start the search at a random position.
+ * \param x - Returned X position of the rectangle.
+ * \param y - Returned Y position of the rectangle.
+ * \return TRUE if no such rectangle was found.
+ */
+Bool groundFindFreeArea(GroundCoord w, GroundCoord h, Bool randomized, GroundCoord* x, GroundCoord* y);
+
+/*!
+ * \brief Set the function to call when the ground state changes.
+ *
+ * \param watcher - The function, NULL to unset it.
+ */
+void groundSetWatcher(GroundWatcher watcher);
+
 #endif
@@ -39,18 +39,16 @@
 #include "graphics/types.h"
 #include "tools/fonct.h"
 
+#include "SDL_cpuinfo.h"
+#include <math.h>
+#ifdef HAVE_TARGET_SSE2
+    #include <emmintrin.h>
+    #define FLOCK_SSE2 1
+#endif
+
 /******************************************************************************
  *                                  Typedefs                                  *
  ******************************************************************************/
-/*! \brief Boid (single element of a flocking system) */
-typedef struct
-{
-    Gl3DObject obj;
-    Gl3DCoord dx;
-    Gl3DCoord dy;
-    Gl3DCoord dz;
-} Boid;
-
 struct pv_BoidGroup
 {
     int xrel:1;         /*!< Specifies if xmin and xmax field are relative to world's xmin and xmax */
@@ -67,7 +65,57 @@ struct pv_BoidGroup
     Gl3DCoord zmul;     /*!< Z multiplier */
     GlMesh mesh;        /*!< Mesh for an entity of this group */
     Uint32 nbboids;     /*!< Number of boids in this group */
-    Boid* boids;        /*!< Vector of boids */
+    
+    /*boids state, one vector per field, all in the data block*/
+    Gl3DObject* objs;   /*!< Render objects */
+    Gl3DCoord* data;    /*!< Block of BOID_NBFIELDS vectors */
+    Gl3DCoord* x;       /*!< X positions */
+    Gl3DCoord* y;       /*!< Y positions */
+    Gl3DCoord* z;       /*!< Z positions */
+    Gl3DCoord* dx;      /*!< X velocities */
+    Gl3DCoord* dy;      /*!< Y velocities */
+    Gl3DCoord* dz;      /*!< Z velocities */
+    Gl3DCoord* angh;    /*!< Horizontal angles, pushed to render objects */
+    Gl3DCoord* angv;    /*!< Vertical angles, pushed to render objects */
+    Gl3DCoord* mx;      /*!< Sum of neighbours X positions */
+    Gl3DCoord* my;      /*!< Sum of neighbours Y positions */
+    Gl3DCoord* mz;      /*!< Sum of neighbours Z positions */
+    Gl3DCoord* mdx;     /*!< Sum of neighbours X velocities */
+    Gl3DCoord* mdy;     /*!< Sum of neighbours Y velocities */
+    Gl3DCoord* mdz;     /*!< Sum of neighbours Z velocities */
+    Gl3DCoord* n;       /*!< Number of neighbours */
+    
+    /*neighbourhood grid*/
+    Uint32 cellsx;      /*!< Number of grid cells on X axis */
+    Uint32 cellsy;      /*!< Number of grid cells on Y axis */
+    Uint32 cellsz;      /*!< Number of grid cells on Z axis */
+    Uint32* cellstart;  /*!< Index in cellboids of the first boid of each cell (one more cell for the end) */
+    Uint32* cellboids;  /*!< Boids indexes, sorted by cell */
+    Uint32* boidcell;   /*!< Cell of each boid */
+};
+
+/*! \brief Function applying the flocking rules to a group, from neighbourhood sums */
+typedef void (*BoidKernel) (BoidGroup group, Gl3DCoord* data, Gl3DCoord f);
+
+/*Vectors of the boids data block*/
+enum
+{
+    BOID_X,
+    BOID_Y,
+    BOID_Z,
+    BOID_DX,
+    BOID_DY,
+    BOID_DZ,
+    BOID_ANGH,
+    BOID_ANGV,
+    BOID_MX,
+    BOID_MY,
+    BOID_MZ,
+    BOID_MDX,
+    BOID_MDY,
+    BOID_MDZ,
+    BOID_N,
+    BOID_NBFIELDS
 };
 
 /******************************************************************************
@@ -75,14 +123,26 @@ struct pv_BoidGroup
  ******************************************************************************/
 static PtrArray _groups;
 
+static BoidKernel _kernel;
+
 static WorldCoord world_w;
 static WorldCoord world_h;
 
 static CoreID MOD_ID = CORE_INVALID_ID;
 static volatile CoreID THREAD_ID = CORE_INVALID_ID;
+static CoreID FUNC_SIMD = CORE_INVALID_ID;
 
 #define THREAD_TIMER 30
 
+/*Size of a boid neighbourhood, also used as grid cell size*/
+#define FLOCK_RANGE 5.0
+
+/*Number of boids of the group generated to check the SIMD kernel (not a multiple of 4)*/
+#define FLOCK_CHECK_BOIDS 1003
+
+/*Largest difference allowed between the SIMD kernel and the scalar one after a step (rounding only)*/
+#define FLOCK_CHECK_TOLERANCE 1e-5
+
 /******************************************************************************
  *############################################################################*
  *#                            Private functions                             #*
@@ -97,9 +157,13 @@ BoidGroup_del(BoidGroup group)
     {
         for (i = 0; i < group->nbboids; i++)
         {
-            Gl3DObject_del((group->boids)[i].obj);
+            Gl3DObject_del(group->objs[i]);
         }
-        FREE(group->boids);
+        FREE(group->objs);
+        FREE(group->data);
+        FREE(group->cellstart);
+        FREE(group->cellboids);
+        FREE(group->boidcell);
     }
     if (group->mesh != NULL)
     {
@@ -107,151 +171,517 @@ BoidGroup_del(BoidGroup group)
     }
     FREE(group);
 }
+
 /*----------------------------------------------------------------------------*/
+/*Allocate the boids state and the grid of a group, its nbboids must be set*/
 static void
-applyFlock(Boid* boid, BoidGroup group, Uint32 pos, Gl3DCoord f)
+BoidGroup_allocData(BoidGroup group)
 {
-    Gl3DCoord ndx, ndy, ndz;
-    Gl3DCoord mx, my, mz;
-    Gl3DCoord mdx, mdy, mdz;
-    Gl3DCoord ox, oy, oz;
-    Uint32 i, n;
-    Boid* b;
-    Gl3DCoord fa;
-    Bool avoid = FALSE;
+    /*all boid fields share a single block*/
+    group->data = MALLOC(sizeof(Gl3DCoord) * group->nbboids * BOID_NBFIELDS);
+    group->x = group->data + BOID_X * group->nbboids;
+    group->y = group->data + BOID_Y * group->nbboids;
+    group->z = group->data + BOID_Z * group->nbboids;
+    group->dx = group->data + BOID_DX * group->nbboids;
+    group->dy = group->data + BOID_DY * group->nbboids;
+    group->dz = group->data + BOID_DZ * group->nbboids;
+    group->angh = group->data + BOID_ANGH * group->nbboids;
+    group->angv = group->data + BOID_ANGV * group->nbboids;
+    group->mx = group->data + BOID_MX * group->nbboids;
+    group->my = group->data + BOID_MY * group->nbboids;
+    group->mz = group->data + BOID_MZ * group->nbboids;
+    group->mdx = group->data + BOID_MDX * group->nbboids;
+    group->mdy = group->data + BOID_MDY * group->nbboids;
+    group->mdz = group->data + BOID_MDZ * group->nbboids;
+    group->n = group->data + BOID_N * group->nbboids;
     
-    Gl3DObject_getPos(boid->obj, &ox, &oy, &oz);
+    group->cellstart = NULL;
+    group->cellboids = MALLOC(sizeof(Uint32) * group->nbboids);
+    group->boidcell = MALLOC(sizeof(Uint32) * group->nbboids);
+}
+
+/*----------------------------------------------------------------------------*/
+static Uint32
+gridSize(Gl3DCoord min, Gl3DCoord max)
+{
+    if (max <= min)
+    {
+        return 1;
+    }
+    return (Uint32)((max - min) / FLOCK_RANGE) + 1;
+}
+
+/*----------------------------------------------------------------------------*/
+static Uint32
+gridCoord(Gl3DCoord v, Gl3DCoord min, Uint32 size)
+{
+    /*boids out of the limits are kept in border cells*/
+    if (v <= min)
+    {
+        return 0;
+    }
+    v = (v - min) / FLOCK_RANGE;
+    if (v >= (Gl3DCoord)(size - 1))
+    {
+        return size - 1;
+    }
+    return (Uint32)v;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Adapt the grid to the group limits*/
+static void
+BoidGroup_resizeGrid(BoidGroup group)
+{
+    group->cellsx = gridSize(group->xmin, group->xmax);
+    group->cellsy = gridSize(group->ymin, group->ymax);
+    group->cellsz = gridSize(group->zmin, group->zmax);
     
-    /*avoidance*/
-    if (ox < group->xmin + 1.0)
+    if (group->cellstart == NULL)
     {
-        boid->dx += (group->xmin + 1.0 - ox) * 0.01;
-        avoid = TRUE;
+        group->cellstart = MALLOC(sizeof(Uint32) * (group->cellsx * group->cellsy * group->cellsz + 1));
     }
-    if (ox > group->xmax - 1.0)
+    else
     {
-        boid->dx += (group->xmax - 1.0 - ox) * 0.01;
-        avoid = TRUE;
+        group->cellstart = REALLOC(group->cellstart, sizeof(Uint32) * (group->cellsx * group->cellsy * group->cellsz + 1));
     }
-    if (oy < group->ymin + 1.0)
+}
+
+/*----------------------------------------------------------------------------*/
+/*Sort the boids by grid cell (counting sort)*/
+static void
+BoidGroup_buildGrid(BoidGroup group)
+{
+    Uint32 i, c, nbcells;
+    Uint32* start;
+    
+    nbcells = group->cellsx * group->cellsy * group->cellsz;
+    start = group->cellstart;
+    
+    for (c = 0; c <= nbcells; c++)
     {
-        boid->dy += (group->ymin + 1.0 - oy) * 0.01;
-        avoid = TRUE;
+        start[c] = 0;
     }
-    if (oy > group->ymax - 1.0)
+    for (i = 0; i < group->nbboids; i++)
     {
-        boid->dy += (group->ymax - 1.0 - oy) * 0.01;
-        avoid = TRUE;
+        c = (gridCoord(group->z[i], group->zmin, group->cellsz) * group->cellsy
+          + gridCoord(group->y[i], group->ymin, group->cellsy)) * group->cellsx
+          + gridCoord(group->x[i], group->xmin, group->cellsx);
+        group->boidcell[i] = c;
+        start[c + 1]++;
     }
-    if (oz < group->zmin + 1.0)
+    for (c = 0; c < nbcells; c++)
     {
-        boid->dz += (group->zmin + 1.0 - oz) * 0.01;
-        avoid = TRUE;
+        start[c + 1] += start[c];
     }
-    if (oz > group->zmax - 1.0)
+    /*start[c] is now used as an insertion cursor, it will end at the start of the next cell*/
+    for (i = 0; i < group->nbboids; i++)
     {
-        boid->dz += (group->zmax - 1.0 - oz) * 0.01;
-        avoid = TRUE;
+        group->cellboids[start[group->boidcell[i]]++] = i;
     }
-    if (avoid)
+    for (c = nbcells; c > 0; c--)
     {
-        Gl3DObject_setPos(boid->obj, ox + boid->dx * f, oy + boid->dy * f, oz + boid->dz * f, 0);
-        return;
+        start[c] = start[c - 1];
     }
+    start[0] = 0;
+}
 
-    /*make sum of neighborhood factors*/
-    mx = 0.0;
-    my = 0.0;
-    mz = 0.0;
-    mdx = 0.0;
-    mdy = 0.0;
-    mdz = 0.0;
-    n = 0;
-    for (i = 0; i < group->nbboids; i++)
+/*----------------------------------------------------------------------------*/
+/*Sum the positions and velocities of each boid neighbours*/
+static void
+BoidGroup_gather(BoidGroup group)
+{
+    Gl3DCoord mx, my, mz;
+    Gl3DCoord mdx, mdy, mdz;
+    Gl3DCoord ox, oy, oz;
+    Uint32 pos, i, n, k, kend;
+    Uint32 cx, cy, cz;
+    Uint32 gx, gy, gz, gxmax, gymax, gzmax;
+    
+    for (pos = 0; pos < group->nbboids; pos++)
     {
-        if (i != pos)
+        ox = group->x[pos];
+        oy = group->y[pos];
+        oz = group->z[pos];
+        
+        mx = 0.0;
+        my = 0.0;
+        mz = 0.0;
+        mdx = 0.0;
+        mdy = 0.0;
+        mdz = 0.0;
+        n = 0;
+    
+        /*only the 27 grid cells around the boid can contain neighbours*/
+        cx = group->boidcell[pos] % group->cellsx;
+        cy = (group->boidcell[pos] / group->cellsx) % group->cellsy;
+        cz = group->boidcell[pos] / (group->cellsx * group->cellsy);
+        gxmax = MIN(cx + 1, group->cellsx - 1);
+        gymax = MIN(cy + 1, group->cellsy - 1);
+        gzmax = MIN(cz + 1, group->cellsz - 1);
+        for (gz = (cz == 0) ? 0 : cz - 1; gz <= gzmax; gz++)
         {
-            b = (group->boids) + i;
-            if ((fabs(ox - Gl3DObject_getX(b->obj)) < 5.0)
-             && (fabs(oy - Gl3DObject_getY(b->obj)) < 5.0)
-             && (fabs(oz - Gl3DObject_getZ(b->obj)) < 5.0))
+            for (gy = (cy == 0) ? 0 : cy - 1; gy <= gymax; gy++)
             {
-                /*b is in the neighborhood*/
-                mx += Gl3DObject_getX(b->obj);
-                my += Gl3DObject_getY(b->obj);
-                mz += Gl3DObject_getZ(b->obj);
-                mdx += b->dx;
-                mdy += b->dy;
-                mdz += b->dz;
-                n++;
+                for (gx = (cx == 0) ? 0 : cx - 1; gx <= gxmax; gx++)
+                {
+                    k = group->cellstart[(gz * group->cellsy + gy) * group->cellsx + gx];
+                    kend = group->cellstart[(gz * group->cellsy + gy) * group->cellsx + gx + 1];
+                    for (; k < kend; k++)
+                    {
+                        i = group->cellboids[k];
+                        if ((i != pos)
+                         && (fabs(ox - group->x[i]) < FLOCK_RANGE)
+                         && (fabs(oy - group->y[i]) < FLOCK_RANGE)
+                         && (fabs(oz - group->z[i]) < FLOCK_RANGE))
+                        {
+                            /*i is in the neighborhood*/
+                            mx += group->x[i];
+                            my += group->y[i];
+                            mz += group->z[i];
+                            mdx += group->dx[i];
+                            mdy += group->dy[i];
+                            mdz += group->dz[i];
+                            n++;
+                        }
+                    }
+                }
             }
         }
+        
+        group->mx[pos] = mx;
+        group->my[pos] = my;
+        group->mz[pos] = mz;
+        group->mdx[pos] = mdx;
+        group->mdy[pos] = mdy;
+        group->mdz[pos] = mdz;
+        group->n[pos] = (Gl3DCoord)n;
     }
-    if (n != 0)
+}
+
+/*----------------------------------------------------------------------------*/
+/*Reference kernel, applies the rules from the boid 'start'*/
+static void
+applyFlockScalar(BoidGroup group, Gl3DCoord* data, Uint32 start, Gl3DCoord f)
+{
+    Gl3DCoord ndx, ndy, ndz;
+    Gl3DCoord mx, my, mz;
+    Gl3DCoord mdx, mdy, mdz;
+    Gl3DCoord ox, oy, oz;
+    Gl3DCoord *x, *y, *z, *dx, *dy, *dz;
+    Gl3DCoord fa;
+    Uint32 nb, pos, n;
+    Bool avoid;
+    
+    nb = group->nbboids;
+    x = data + BOID_X * nb;
+    y = data + BOID_Y * nb;
+    z = data + BOID_Z * nb;
+    dx = data + BOID_DX * nb;
+    dy = data + BOID_DY * nb;
+    dz = data + BOID_DZ * nb;
+    
+    for (pos = start; pos < nb; pos++)
     {
-        mx /= (Gl3DCoord)n;
-        my /= (Gl3DCoord)n;
-        mz /= (Gl3DCoord)n;
-        mdx /= (Gl3DCoord)n;
-        mdy /= (Gl3DCoord)n;
-        mdz /= (Gl3DCoord)n;
-        
-        fa = 1.0;
+        ox = x[pos];
+        oy = y[pos];
+        oz = z[pos];
         
-        ndx = boid->dx;
-        ndy = boid->dy;
-        ndz = boid->dz;
-        /*fa += dist3d(0.0, 0.0, 0.0, boid->dx, boid->dy, boid->dz);*/
-
-        /*cohesion*/
-        mx -= ox;
-        my -= oy;
-        mz -= oz;
-        ndx += 0.001 * mx;
-        ndy += 0.001 * my;
-        ndz += 0.001 * mz;
-        fa += dist3d(0.0, 0.0, 0.0, 0.001 * mx, 0.001 * my, 0.001 * mz);
+        /*avoidance*/
+        avoid = FALSE;
+        if (ox < group->xmin + 1.0)
+        {
+            dx[pos] += (group->xmin + 1.0 - ox) * 0.01;
+            avoid = TRUE;
+        }
+        if (ox > group->xmax - 1.0)
+        {
+            dx[pos] += (group->xmax - 1.0 - ox) * 0.01;
+            avoid = TRUE;
+        }
+        if (oy < group->ymin + 1.0)
+        {
+            dy[pos] += (group->ymin + 1.0 - oy) * 0.01;
+            avoid = TRUE;
+        }
+        if (oy > group->ymax - 1.0)
+        {
+            dy[pos] += (group->ymax - 1.0 - oy) * 0.01;
+            avoid = TRUE;
+        }
+        if (oz < group->zmin + 1.0)
+        {
+            dz[pos] += (group->zmin + 1.0 - oz) * 0.01;
+            avoid = TRUE;
+        }
+        if (oz > group->zmax - 1.0)
+        {
+            dz[pos] += (group->zmax - 1.0 - oz) * 0.01;
+            avoid = TRUE;
+        }
         
-        /*alignement*/
-        ndx += mdx;
-        ndy += mdy;
-        ndz += mdz;
-        fa += dist3d(0.0, 0.0, 0.0, mdx, mdy, mdz);
+        n = (Uint32)data[BOID_N * nb + pos];
+        if ((!avoid) && (n != 0))
+        {
+            mx = data[BOID_MX * nb + pos] / (Gl3DCoord)n;
+            my = data[BOID_MY * nb + pos] / (Gl3DCoord)n;
+            mz = data[BOID_MZ * nb + pos] / (Gl3DCoord)n;
+            mdx = data[BOID_MDX * nb + pos] / (Gl3DCoord)n;
+            mdy = data[BOID_MDY * nb + pos] / (Gl3DCoord)n;
+            mdz = data[BOID_MDZ * nb + pos] / (Gl3DCoord)n;
+            
+            fa = 1.0;
+            
+            ndx = dx[pos];
+            ndy = dy[pos];
+            ndz = dz[pos];
+            
+            /*cohesion*/
+            mx -= ox;
+            my -= oy;
+            mz -= oz;
+            ndx += 0.001 * mx;
+            ndy += 0.001 * my;
+            ndz += 0.001 * mz;
+            fa += dist3d(0.0, 0.0, 0.0, 0.001 * mx, 0.001 * my, 0.001 * mz);
+            
+            /*alignement*/
+            ndx += mdx;
+            ndy += mdy;
+            ndz += mdz;
+            fa += dist3d(0.0, 0.0, 0.0, mdx, mdy, mdz);
+            
+            /*multiplier*/
+            ndx *= group->xmul;
+            ndy *= group->ymul;
+            ndz *= group->zmul;
+            
+            /*normalize new direction*/
+            ndx /= fa;
+            ndy /= fa;
+            ndz /= fa;
+            ndx = MIN(ndx, 0.1);
+            ndx = MAX(ndx, -0.1);
+            ndy = MIN(ndy, 0.1);
+            ndy = MAX(ndy, -0.1);
+            ndz = MIN(ndz, 0.1);
+            ndz = MAX(ndz, -0.1);
         
-        /*multiplier*/
-        ndx *= group->xmul;
-        ndy *= group->ymul;
-        ndz *= group->zmul;
+            /*steer towards this direction*/
+            dx[pos] += (ndx - dx[pos]) * group->response;
+            dy[pos] += (ndy - dy[pos]) * group->response;
+            dz[pos] += (ndz - dz[pos]) * group->response;
+        }
         
-        /*normalize new direction*/
-        ndx /= fa;
-        ndy /= fa;
-        ndz /= fa;
-        ndx = MIN(ndx, 0.1);
-        ndx = MAX(ndx, -0.1);
-        ndy = MIN(ndy, 0.1);
-        ndy = MAX(ndy, -0.1);
-        ndz = MIN(ndz, 0.1);
-        ndz = MAX(ndz, -0.1);
+        x[pos] = ox + dx[pos] * f;
+        y[pos] = oy + dy[pos] * f;
+        z[pos] = oz + dz[pos] * f;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+static void
+kernelScalar(BoidGroup group, Gl3DCoord* data, Gl3DCoord f)
+{
+    applyFlockScalar(group, data, 0, f);
+}
+
+#ifdef FLOCK_SSE2
+/*----------------------------------------------------------------------------*/
+/*Same rules as applyFlockScalar, on four boids at once, branches are replaced by masks*/
+static TARGET_SSE2 void
+kernelSSE2(BoidGroup group, Gl3DCoord* data, Gl3DCoord f)
+{
+    Gl3DCoord *x, *y, *z, *dx, *dy, *dz;
+    Uint32 nb, pos;
+    __m128 zero, one, cavoid, ccohes, cmax, cmin, vf, resp;
+    __m128 xmin, xmax, ymin, ymax, zmin, zmax, xmul, ymul, zmul;
+    __m128 ox, oy, oz, vdx, vdy, vdz;
+    __m128 lo, hi, avoid, flock, inv, fa;
+    __m128 mx, my, mz, mdx, mdy, mdz, ndx, ndy, ndz;
+    
+    nb = group->nbboids;
+    x = data + BOID_X * nb;
+    y = data + BOID_Y * nb;
+    z = data + BOID_Z * nb;
+    dx = data + BOID_DX * nb;
+    dy = data + BOID_DY * nb;
+    dz = data + BOID_DZ * nb;
     
+    zero = _mm_setzero_ps();
+    one = _mm_set1_ps(1.0f);
+    cavoid = _mm_set1_ps(0.01f);
+    ccohes = _mm_set1_ps(0.001f);
+    cmax = _mm_set1_ps(0.1f);
+    cmin = _mm_set1_ps(-0.1f);
+    vf = _mm_set1_ps(f);
+    resp = _mm_set1_ps(group->response);
+    xmin = _mm_set1_ps(group->xmin + 1.0f);
+    xmax = _mm_set1_ps(group->xmax - 1.0f);
+    ymin = _mm_set1_ps(group->ymin + 1.0f);
+    ymax = _mm_set1_ps(group->ymax - 1.0f);
+    zmin = _mm_set1_ps(group->zmin + 1.0f);
+    zmax = _mm_set1_ps(group->zmax - 1.0f);
+    xmul = _mm_set1_ps(group->xmul);
+    ymul = _mm_set1_ps(group->ymul);
+    zmul = _mm_set1_ps(group->zmul);
+    
+    for (pos = 0; pos + 4 <= nb; pos += 4)
+    {
+        ox = _mm_loadu_ps(x + pos);
+        oy = _mm_loadu_ps(y + pos);
+        oz = _mm_loadu_ps(z + pos);
+        vdx = _mm_loadu_ps(dx + pos);
+        vdy = _mm_loadu_ps(dy + pos);
+        vdz = _mm_loadu_ps(dz + pos);
+        
+        /*avoidance, the pushes are null for boids inside the limits*/
+        lo = _mm_sub_ps(xmin, ox);
+        hi = _mm_sub_ps(xmax, ox);
+        avoid = _mm_or_ps(_mm_cmpgt_ps(lo, zero), _mm_cmplt_ps(hi, zero));
+        vdx = _mm_add_ps(vdx, _mm_mul_ps(_mm_add_ps(_mm_max_ps(lo, zero), _mm_min_ps(hi, zero)), cavoid));
+        lo = _mm_sub_ps(ymin, oy);
+        hi = _mm_sub_ps(ymax, oy);
+        avoid = _mm_or_ps(avoid, _mm_or_ps(_mm_cmpgt_ps(lo, zero), _mm_cmplt_ps(hi, zero)));
+        vdy = _mm_add_ps(vdy, _mm_mul_ps(_mm_add_ps(_mm_max_ps(lo, zero), _mm_min_ps(hi, zero)), cavoid));
+        lo = _mm_sub_ps(zmin, oz);
+        hi = _mm_sub_ps(zmax, oz);
+        avoid = _mm_or_ps(avoid, _mm_or_ps(_mm_cmpgt_ps(lo, zero), _mm_cmplt_ps(hi, zero)));
+        vdz = _mm_add_ps(vdz, _mm_mul_ps(_mm_add_ps(_mm_max_ps(lo, zero), _mm_min_ps(hi, zero)), cavoid));
+        
+        /*boids following the flocking rules*/
+        inv = _mm_loadu_ps(data + BOID_N * nb + pos);
+        flock = _mm_andnot_ps(avoid, _mm_cmpgt_ps(inv, zero));
+        inv = _mm_div_ps(one, _mm_max_ps(inv, one));
+        
+        mx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(data + BOID_MX * nb + pos), inv), ox), ccohes);
+        my = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(data + BOID_MY * nb + pos), inv), oy), ccohes);
+        mz = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(data + BOID_MZ * nb + pos), inv), oz), ccohes);
+        mdx = _mm_mul_ps(_mm_loadu_ps(data + BOID_MDX * nb + pos), inv);
+        mdy = _mm_mul_ps(_mm_loadu_ps(data + BOID_MDY * nb + pos), inv);
+        mdz = _mm_mul_ps(_mm_loadu_ps(data + BOID_MDZ * nb + pos), inv);
+        
+        /*cohesion and alignement*/
+        fa = _mm_add_ps(one, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(mx, mx), _mm_mul_ps(my, my)), _mm_mul_ps(mz, mz))));
+        fa = _mm_add_ps(fa, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(mdx, mdx), _mm_mul_ps(mdy, mdy)), _mm_mul_ps(mdz, mdz))));
+        
+        /*multiplier and normalization*/
+        ndx = _mm_div_ps(_mm_mul_ps(_mm_add_ps(_mm_add_ps(vdx, mx), mdx), xmul), fa);
+        ndy = _mm_div_ps(_mm_mul_ps(_mm_add_ps(_mm_add_ps(vdy, my), mdy), ymul), fa);
+        ndz = _mm_div_ps(_mm_mul_ps(_mm_add_ps(_mm_add_ps(vdz, mz), mdz), zmul), fa);
+        ndx = _mm_max_ps(_mm_min_ps(ndx, cmax), cmin);
+        ndy = _mm_max_ps(_mm_min_ps(ndy, cmax), cmin);
+        ndz = _mm_max_ps(_mm_min_ps(ndz, cmax), cmin);
+        
         /*steer towards this direction*/
-        boid->dx += (ndx - boid->dx) * group->response;
-        boid->dy += (ndy - boid->dy) * group->response;
-        boid->dz += (ndz - boid->dz) * group->response;
+        ndx = _mm_add_ps(vdx, _mm_mul_ps(_mm_sub_ps(ndx, vdx), resp));
+        ndy = _mm_add_ps(vdy, _mm_mul_ps(_mm_sub_ps(ndy, vdy), resp));
+        ndz = _mm_add_ps(vdz, _mm_mul_ps(_mm_sub_ps(ndz, vdz), resp));
+        vdx = _mm_or_ps(_mm_and_ps(flock, ndx), _mm_andnot_ps(flock, vdx));
+        vdy = _mm_or_ps(_mm_and_ps(flock, ndy), _mm_andnot_ps(flock, vdy));
+        vdz = _mm_or_ps(_mm_and_ps(flock, ndz), _mm_andnot_ps(flock, vdz));
+        
+        _mm_storeu_ps(dx + pos, vdx);
+        _mm_storeu_ps(dy + pos, vdy);
+        _mm_storeu_ps(dz + pos, vdz);
+        _mm_storeu_ps(x + pos, _mm_add_ps(ox, _mm_mul_ps(vdx, vf)));
+        _mm_storeu_ps(y + pos, _mm_add_ps(oy, _mm_mul_ps(vdy, vf)));
+        _mm_storeu_ps(z + pos, _mm_add_ps(oz, _mm_mul_ps(vdz, vf)));
+    }
+    
+    /*remaining boids*/
+    applyFlockScalar(group, data, pos, f);
+}
+#endif
+
+#ifdef FLOCK_SSE2
+/*----------------------------------------------------------------------------*/
+/*Pseudo-random value between min and max, the same on every run*/
+static Gl3DCoord
+checkRandom(Uint32* seed, Gl3DCoord min, Gl3DCoord max)
+{
+    *seed = *seed * 1103515245U + 12345U;
+    return min + (max - min) * (Gl3DCoord)((*seed >> 8) & 0xFFFF) / 65535.0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*Run a kernel against the reference one on a generated group, give the largest
+difference of positions and velocities*/
+static Gl3DCoord
+checkKernel(BoidKernel kernel)
+{
+    pv_BoidGroup group;
+    Gl3DCoord* ref;
+    Gl3DCoord* test;
+    Gl3DCoord diff;
+    Uint32 i, seed, size;
+    
+    group.xmin = -10.0;
+    group.xmax = 10.0;
+    group.ymin = 4.0;
+    group.ymax = 20.0;
+    group.zmin = -10.0;
+    group.zmax = 10.0;
+    group.xmul = 1.0;
+    group.ymul = 0.5;
+    group.zmul = 1.0;
+    group.response = 0.1;
+    group.nbboids = FLOCK_CHECK_BOIDS;
+    BoidGroup_allocData(&group);
+    BoidGroup_resizeGrid(&group);
+    
+    /*some boids are out of the limits, to check the avoidance too*/
+    seed = 1;
+    for (i = 0; i < group.nbboids; i++)
+    {
+        group.x[i] = checkRandom(&seed, group.xmin - 2.0, group.xmax + 2.0);
+        group.y[i] = checkRandom(&seed, group.ymin - 2.0, group.ymax + 2.0);
+        group.z[i] = checkRandom(&seed, group.zmin - 2.0, group.zmax + 2.0);
+        group.dx[i] = checkRandom(&seed, -0.1, 0.1);
+        group.dy[i] = checkRandom(&seed, -0.1, 0.1);
+        group.dz[i] = checkRandom(&seed, -0.1, 0.1);
+    }
+    BoidGroup_buildGrid(&group);
+    BoidGroup_gather(&group);
+    
+    size = sizeof(Gl3DCoord) * group.nbboids * BOID_NBFIELDS;
+    ref = MALLOC(size);
+    test = MALLOC(size);
+    memCOPY(ref, group.data, size);
+    memCOPY(test, group.data, size);
+    
+    kernelScalar(&group, ref, 1.0);
+    kernel(&group, test, 1.0);
+    
+    /*compare positions and velocities*/
+    diff = 0.0;
+    for (i = BOID_X * group.nbboids; i < BOID_ANGH * group.nbboids; i++)
+    {
+        diff = MAX(diff, fabs(ref[i] - test[i]));
     }
     
-    Gl3DObject_setPos(boid->obj, ox + boid->dx * f, oy + boid->dy * f, oz + boid->dz * f, 0);
+    FREE(ref);
+    FREE(test);
+    FREE(group.data);
+    FREE(group.cellstart);
+    FREE(group.cellboids);
+    FREE(group.boidcell);
+    return diff;
 }
+#endif
 
 /*----------------------------------------------------------------------------*/
 static void
-boidRandom(Boid* boid, BoidGroup group)
+boidRandom(BoidGroup group, Uint32 pos)
 {
     /*TODO: better random*/
-    Gl3DObject_setPos(boid->obj, (Gl3DCoord)rnd(group->xmin, group->xmax - group->xmin), (Gl3DCoord)rnd(group->ymin, group->ymax - group->ymin), (Gl3DCoord)rnd(group->zmin, group->zmax - group->zmin), 0);
-    boid->dx = (Gl3DCoord)(rnd(0, 100) - 50) / 500.0;
-    boid->dy = (Gl3DCoord)(rnd(0, 100) - 50) / 500.0;
-    boid->dz = (Gl3DCoord)(rnd(0, 100) - 50) / 500.0;
+    group->x[pos] = (Gl3DCoord)rnd(group->xmin, group->xmax - group->xmin);
+    group->y[pos] = (Gl3DCoord)rnd(group->ymin, group->ymax - group->ymin);
+    group->z[pos] = (Gl3DCoord)rnd(group->zmin, group->zmax - group->zmin);
+    group->dx[pos] = (Gl3DCoord)(rnd(0, 100) - 50) / 500.0;
+    group->dy[pos] = (Gl3DCoord)(rnd(0, 100) - 50) / 500.0;
+    group->dz[pos] = (Gl3DCoord)(rnd(0, 100) - 50) / 500.0;
+    angle3d(group->dx[pos], group->dy[pos], group->dz[pos], group->angh + pos, group->angv + pos);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -261,9 +691,7 @@ threadCallback(CoreID thread, CoreTime steptime)
     PtrArrayIterator i;
     BoidGroup group;
     Uint32 j;
-    Boid* boid;
     Gl3DCoord f;
-    Gl3DCoord ah, av;
     
     ASSERT(thread == THREAD_ID, return);
     (void)thread;
@@ -274,13 +702,20 @@ threadCallback(CoreID thread, CoreTime steptime)
     for (i = PtrArray_START(_groups); i != PtrArray_STOP(_groups); i++)
     {
         group = (BoidGroup)*i;
+        if (group->nbboids == 0)
+        {
+            continue;
+        }
+        
+        /*neighbours are looked up from the positions at the beginning of the step*/
+        BoidGroup_buildGrid(group);
+        BoidGroup_gather(group);
+        _kernel(group, group->data, f);
         for (j = 0; j < group->nbboids; j++)
         {
-            boid = group->boids + j;
-            applyFlock(boid, group, j, f);
-            angle3d(boid->dx, boid->dy, boid->dz, &ah, &av);
-            Gl3DObject_setAngle(boid->obj, ah, av, 0);
+            angle3d(group->dx[j], group->dy[j], group->dz[j], group->angh + j, group->angv + j);
         }
+        Gl3DObject_placeArray(group->objs, group->nbboids, group->x, group->y, group->z, group->angh, group->angv);
     }
 }
 
@@ -298,6 +733,23 @@ coreCallback(CoreEvent event)
     }
 }
 
+/*----------------------------------------------------------------------------*/
+static void
+shellCallback(ShellFunction* func)
+{
+    if (func->id == FUNC_SIMD)
+    {
+        _kernel = kernelScalar;
+#ifdef FLOCK_SSE2
+        if ((Var_getValueInt(func->params[0]) != 0) && SDL_HasSSE2())
+        {
+            _kernel = kernelSSE2;
+        }
+#endif
+        Var_setVoid(func->ret);
+    }
+}
+
 /******************************************************************************
  *############################################################################*
  *#                             Public functions                             #*
@@ -311,11 +763,50 @@ flockingInit()
     world_w = 10;
     world_h = 10;
     
-    MOD_ID = coreDeclareModule("flocking", coreCallback, NULL, NULL, NULL, NULL, threadCallback);
+    /*choose the flocking kernel*/
+    _kernel = kernelScalar;
+#ifdef FLOCK_SSE2
+    if (SDL_HasSSE2())
+    {
+        if (flockingCheckKernels())
+        {
+            _kernel = kernelSSE2;
+        }
+        else
+        {
+            shellPrint(LEVEL_ERROR, "SSE2 flocking kernel not used.");
+        }
+    }
+#endif
+    shellPrintf(LEVEL_INFO, " -> flocking kernel: %s", (_kernel == kernelScalar) ? "scalar" : "SSE2");
+
+    MOD_ID = coreDeclareModule("flocking", coreCallback, NULL, shellCallback, NULL, NULL, threadCallback);
+    FUNC_SIMD = coreDeclareShellFunction(MOD_ID, "simd", VAR_VOID, 1, VAR_INT);
     coreCreateThread(MOD_ID, "flocks", FALSE, &THREAD_ID);
     coreSetThreadTimer(MOD_ID, THREAD_ID, THREAD_TIMER);
 }
 
+/*----------------------------------------------------------------------------*/
+Bool
+flockingCheckKernels()
+{
+#ifdef FLOCK_SSE2
+    Gl3DCoord diff;
+    
+    if (SDL_HasSSE2())
+    {
+        diff = checkKernel(kernelSSE2);
+        if (diff > FLOCK_CHECK_TOLERANCE)
+        {
+            shellPrintf(LEVEL_ERROR, "SSE2 flocking kernel differs from the scalar one by %g on %d boids.", diff, FLOCK_CHECK_BOIDS);
+            return FALSE;
+        }
+        shellPrintf(LEVEL_DEBUG, "SSE2 flocking kernel maximal difference on %d boids: %g", FLOCK_CHECK_BOIDS, diff);
+    }
+#endif
+    return TRUE;
+}
+
 /*----------------------------------------------------------------------------*/
 void
 flockingUninit()
@@ -339,7 +830,6 @@ flockingAddGroup(Var params)
     VarValidator valid;
     BoidGroup ret;
     Uint32 i;
-    Boid* b;
     
     valid = VarValidator_new();
     VarValidator_declareIntVar(valid, "number", 0);
@@ -368,7 +858,9 @@ flockingAddGroup(Var params)
 
     if (ret->nbboids > 0)
     {
-        ret->boids = MALLOC(sizeof(Boid) * ret->nbboids);
+        ret->objs = MALLOC(sizeof(Gl3DObject) * ret->nbboids);
+        
+        BoidGroup_allocData(ret);
         
         /*group parameters*/
         ret->mesh = GlMesh_new(Var_getArrayElemByCName(params, "mesh"));
@@ -395,15 +887,17 @@ flockingAddGroup(Var params)
             ret->zmax += (Gl3DCoord)world_h;
         }
         
+        BoidGroup_resizeGrid(ret);
+        
         /*generate boids*/
         for (i = 0; i < ret->nbboids; i++)
         {
-            b = ret->boids + i;
-            b->obj = Gl3DObject_new(NULL, global_groupnormal, NULL);
-            Gl3DObject_setMesh(b->obj, ret->mesh);
-            Gl3DObject_setAnim(b->obj, Var_getValueString(Var_getArrayElemByCName(params, "anim")), rnd(0, 1000), 0);
-            boidRandom(b, ret);
+            ret->objs[i] = Gl3DObject_new(NULL, global_groupnormal, NULL);
+            Gl3DObject_setMesh(ret->objs[i], ret->mesh);
+            Gl3DObject_setAnim(ret->objs[i], Var_getValueString(Var_getArrayElemByCName(params, "anim")), rnd(0, 1000), 0);
+            boidRandom(ret, i);
         }
+        Gl3DObject_placeArray(ret->objs, ret->nbboids, ret->x, ret->y, ret->z, ret->angh, ret->angv);
     }
     
     PtrArray_append(_groups, ret);
@@ -438,9 +932,14 @@ flockingWorldSizeChanged(WorldCoord w, WorldCoord h)
         {
             group->zmax = group->zmax - (Gl3DCoord)world_h + (Gl3DCoord)h;
         }
-        for (j = 0; j < group->nbboids; j++)
+        if (group->nbboids > 0)
         {
-            boidRandom(group->boids + j, group);
+            BoidGroup_resizeGrid(group);
+            for (j = 0; j < group->nbboids; j++)
+            {
+                boidRandom(group, j);
+            }
+            Gl3DObject_placeArray(group->objs, group->nbboids, group->x, group->y, group->z, group->angh, group->angv);
         }
     }
 
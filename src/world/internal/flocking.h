@@ -30,7 +30,6 @@
  * \file
  * \brief Flocking implementation.
  *
- * \todo Optimize algorithms (don't use Gl3DObject_get... for position).
  * \todo Use its own 3d group.
  * \todo Maybe use Gl3DObject animation for position when it's done.
  */
@@ -66,6 +65,15 @@ void flockingInit(void);
  */
 void flockingUninit(void);
 
+/*!
+ * \brief Check the SIMD flocking kernel against the scalar one.
+ *
+ * Both are run on the same generated group, a difference above the tolerance is reported as an error.
+ * This is done by flockingInit, that keeps the scalar kernel if the check fails.
+ * \return FALSE if the SIMD kernel is available but differs from the scalar one.
+ */
+Bool flockingCheckKernels(void);
+
 /*!
  * \brief Delete all boid groups.
  * This must be called by the MAIN thread.
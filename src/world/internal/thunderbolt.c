@@ -291,7 +291,7 @@ thunderboltInit()
     sndsample = SoundSample_NULL;
 
     MOD_ID = coreDeclareModule("thunder", coreCallback, NULL, NULL, NULL, NULL, threadCallback);
-    coreRequireThreadSlot(MOD_ID, coreGetThreadID(NULL));
+    coreRequireIndependentThreadSlot(MOD_ID, coreGetThreadID(NULL));
 }
 
 /*----------------------------------------------------------------------------*/